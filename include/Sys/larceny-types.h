@@ -131,9 +131,24 @@ typedef struct nursery_info nursery_info_t;
 typedef struct gc_param gc_param_t;
 typedef struct old_param old_param_t;
 
+/* gc_workers_t.h */
+typedef struct gc_workers gc_workers_t;
+
+/* pretenure_t.h */
+typedef struct pretenure pretenure_t;
+
+/* mark_thread_t.h */
+typedef struct mark_thread mark_thread_t;
+
+/* summ_thread_t.h */
+typedef struct summ_thread summ_thread_t;
+
 /* los_t.h */
 typedef struct los los_t;
 
+/* sched_t.h */
+typedef struct sched sched_t;
+
 /* Types for compatibility functions defined in util.c */
 #if !defined(HAVE_HRTIME_T)
 typedef int hrtime_t;
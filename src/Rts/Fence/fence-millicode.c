@@ -155,7 +155,7 @@ void EXPORT mc_alloc( word *globals )
     globals[ G_RESULT ] =
       (word)gc_allocate( the_gc( globals ), nwords*sizeof( word ), 0, 0 );
   }
-#if !GCLIB_LARGE_TABLE
+#if !GCLIB_LARGE_TABLE && !GCLIB_SPARSE_TABLE
   assert2( globals[ G_RESULT ] >= (word)gclib_pagebase );
 #endif
 #endif
@@ -672,8 +672,13 @@ void EXPORT mc_partial_barrier( word *globals )
   lhs = globals[ G_RESULT ];
   rhs = globals[ G_SECOND ];
 
-  gl = genv[pageof(lhs)];       /* gl: generation # of lhs */
-  gr = genv[pageof(rhs)];       /* gr: generation # of rhs */
+  if (globals[ G_CARDTBL ] != 0) {  /* Card marking */
+    wb_mark_card( globals, lhs );
+    return;
+  }
+
+  gl = genv_of(genv, lhs);      /* gl: generation # of lhs */
+  gr = genv_of(genv, rhs);      /* gr: generation # of rhs */
   if (gl == gr) return;
   if (globals[ G_FILTER_REMSET_GEN_ORDER ] && gl <= gr) return;  
   if (globals[ G_FILTER_REMSET_RHS_NUM ] == gr) return;
@@ -26,6 +26,7 @@
 #include "assert.h"
 #include "young_heap_t.h"       /* For yh_make_room() */
 #include "seqbuf_t.h"           /* For SSB_ENQUEUE */
+#include "pretenure_t.h"        /* For pretenure_allocate() */
 #include <setjmp.h>
 #include <stdlib.h>
 #include <string.h>
@@ -119,6 +120,14 @@ void EXPORT mc_alloc( word *globals )
   assert2(((word)elim & 7) == 0);
 
   nwords = roundup_walign( nwords );
+  if (globals[ G_PRETENURE ]) {
+    p = pretenure_allocate( the_gc( globals )->pretenure, globals,
+                            nwords*sizeof( word ) );
+    if (p != 0) {
+      globals[ G_RESULT ] = (word)p;
+      return;
+    }
+  }
   p = etop;
   etop += nwords;
   if (etop <= elim) {
@@ -129,7 +138,10 @@ void EXPORT mc_alloc( word *globals )
     globals[ G_RESULT ] =
       (word)gc_allocate( the_gc( globals ), nwords*sizeof( word ), 0, 0 );
   }
-#if !GCLIB_LARGE_TABLE
+  if (globals[ G_PRETENURE ])
+    pretenure_sample( the_gc( globals )->pretenure,
+                      (word*)globals[ G_RESULT ] );
+#if !GCLIB_LARGE_TABLE && !GCLIB_SPARSE_TABLE
   assert2( globals[ G_RESULT ] >= (word)gclib_pagebase );
 #endif
 #endif
@@ -575,8 +587,13 @@ void EXPORT mc_partial_barrier( word *globals )
   lhs = globals[ G_RESULT ];
   rhs = globals[ G_SECOND ];
 
-  gl = genv[pageof(lhs)];       /* gl: generation # of lhs */
-  gr = genv[pageof(rhs)];       /* gr: generation # of rhs */
+  if (globals[ G_CARDTBL ] != 0) {  /* Card marking */
+    wb_mark_card( globals, lhs );
+    return;
+  }
+
+  gl = genv_of(genv, lhs);      /* gl: generation # of lhs */
+  gr = genv_of(genv, rhs);      /* gr: generation # of rhs */
   if (gl == gr) return;
   if (globals[ G_FILTER_REMSET_GEN_ORDER ] && gl <= gr) return;  
   if (globals[ G_FILTER_REMSET_RHS_NUM ] == gr) return;
@@ -22,6 +22,11 @@
 %define OPTIMIZE_MILLICODE 1
 %define OPTIMIZE_BARRIER 1
 %define SSB_ENQUEUE_OFFSET_AS_FIXNUM 1
+
+;;; Card marking; these must agree with Rts/Sys/barrier.h.
+
+%define CARD_SHIFT 9
+%define CARD_DIRTY 1
 	
 ;;; Assertion checking is turned on:
 
@@ -215,6 +220,8 @@ PUBLIC i386_alloc_bv
 	MCg	mc_alloc_bv
 PUBLIC i386_alloc
 %ifdef OPTIMIZE_MILLICODE
+	cmp	dword [GLOBALS+G_PRETENURE], 0	; Allocation is profiled
+	jne	L1				;   if pretenuring is on
 	mov	TEMP, [GLOBALS+G_ETOP]
 	add	RESULT, 7
 	and	RESULT, 0xfffffff8
@@ -234,6 +241,8 @@ L1:	xor	TEMP, TEMP
 	;; On entry, esp is off by 4
 PUBLIC i386_alloci
 %ifdef OPTIMIZE_MILLICODE
+	cmp	dword [GLOBALS+G_PRETENURE], 0	; Allocation is profiled
+	jne	L3				;   if pretenuring is on
 	mov	[GLOBALS+G_SECOND], SECOND
 	mov	[GLOBALS+G_REGALIAS_ECX], ecx
 	mov	[GLOBALS+G_REGALIAS_EDI], edi
@@ -260,6 +269,7 @@ PUBLIC i386_alloci
 L2:	mov	SECOND, [GLOBALS+G_SECOND]
 	mov	ecx, [GLOBALS+G_REGALIAS_ECX]
 	mov	edi, [GLOBALS+G_REGALIAS_EDI]
+L3:
 %endif ; OPTIMIZE_MILLICODE
 	MC2g	mc_alloci
 	
@@ -334,10 +344,22 @@ PUBLIC i386_partial_barrier
 %if OPTIMIZE_MILLICODE && OPTIMIZE_BARRIER
   %ifdef GCLIB_LARGE_TABLE
     %error Optimized write barrier does not work with "GCLIB_LARGE_TABLE" yet
+  %endif
+  %ifdef GCLIB_SPARSE_TABLE
+    %error Optimized write barrier does not work with "GCLIB_SPARSE_TABLE" yet
   %endif
 	cmp	dword [GLOBALS+G_GENV], 0	; Barrier is enabled
-	jne	Lpb1				;   if generation map not 0
+	jne	Lpb0				;   if generation map not 0
 	ret					; Otherwise return to scheme
+Lpb0:	mov	TEMP, [GLOBALS+G_CARDTBL]	; Card marking is on
+	test	TEMP, TEMP			;   if card table not 0
+	jz	Lpb1				; Otherwise log in SSB
+	mov	[GLOBALS+G_WBDEST], RESULT	; Save lhs
+	shr	RESULT, CARD_SHIFT		; Card of lhs
+	mov	byte [TEMP+RESULT], CARD_DIRTY	; Mark it
+	mov	RESULT, [GLOBALS+G_WBDEST]	; Restore lhs
+	xor	TEMP, TEMP			; Clear card table ptr
+	ret					;   and return to Scheme
 Lpb1:	mov	[GLOBALS+G_WBDEST], RESULT	; Save state and
 	mov	[GLOBALS+G_WBVALUE], SECOND	;   free up some
 	mov	[GLOBALS+G_REG1], REG1		;     working registers
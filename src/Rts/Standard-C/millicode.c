@@ -291,9 +291,15 @@ void twobit_integrity_check( word *globals, const char *name )
      */
 }
 
+#if GCLIB_SPARSE_TABLE
+# define valid_pointer( x )  (!(attr_of( x ) & MB_FOREIGN))
+#else
+# define valid_pointer( x )  ((caddr_t)(x) >= gclib_pagebase)
+#endif
+
 static int valid_datum( word x )
 {
-  return (isptr( x ) && (caddr_t)x >= gclib_pagebase) ||
+  return (isptr( x ) && valid_pointer( x )) ||
          is_fixnum( x ) || 
          is_char( x ) ||
          x == UNSPECIFIED_CONST ||
@@ -377,7 +383,7 @@ void EXPORT mc_alloc( word *globals )
     globals[ G_RESULT ] =
       (word)gc_allocate( the_gc( globals ), nwords*sizeof( word ), 0, 0 );
   }
-#if !GCLIB_LARGE_TABLE
+#if !GCLIB_LARGE_TABLE && !GCLIB_SPARSE_TABLE
   assert2( globals[ G_RESULT ] >= (word)gclib_pagebase );
 #endif
 #endif
@@ -801,8 +807,13 @@ void EXPORT mc_partial_barrier( word *globals )
   lhs = globals[ G_RESULT ];
   rhs = globals[ G_SECOND ];
 
-  gl = genv[pageof(lhs)];       /* gl: generation # of lhs */
-  gr = genv[pageof(rhs)];       /* gr: generation # of rhs */
+  if (globals[ G_CARDTBL ] != 0) {  /* Card marking */
+    wb_mark_card( globals, lhs );
+    return;
+  }
+
+  gl = genv_of(genv, lhs);      /* gl: generation # of lhs */
+  gr = genv_of(genv, rhs);      /* gr: generation # of rhs */
   if (gl <= gr) return;  
   
   ssbtopv = (word**)globals[ G_SSBTOPV ];
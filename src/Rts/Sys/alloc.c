@@ -45,6 +45,16 @@
  * by never changing the value of gclib_desc_g, the page number computation
  * can be sped up.  This also improves the normal write barrier slightly.
  *
+ * If the preprocessor macro GCLIB_SPARSE_TABLE is not 0, then the two
+ * tables are split into leaves of GCLIB_LEAF_PAGES word entries, found
+ * through the directories gclib_dir_g and gclib_dir_b, which cover the
+ * whole address space (2^48 bytes with 64-bit words).  The leaves for
+ * a range are allocated when memory in the range is first allocated;
+ * every other directory entry points to one shared leaf that says the
+ * pages are foreign.  Nothing ever slides or grows, so a lookup is two
+ * loads wherever the heap lies, and a heap of tens of gigabytes needs
+ * a leaf pair per gigabyte.
+ *
  * Client should  use the gen_of() and attr_of() macros to access the tables.
  *
  * The value of GCLIB_LARGE_OBJECT is selected in Sys/config.h.
@@ -82,11 +92,26 @@
 
 /* Public globals */
 
+#if GCLIB_SPARSE_TABLE
+gclib_desc_t **gclib_dir_g;	/* leaves of generation owners */
+gclib_desc_t **gclib_dir_b;	/* leaves of attribute bits */
+#else
 gclib_desc_t *gclib_desc_g;	/* generation owner */
 #if !GCLIB_LARGE_TABLE
 gclib_desc_t *gclib_desc_b;	/* attribute bits */
 caddr_t      gclib_pagebase;	/* address of lowest known word */
 #endif
+#endif
+
+/* Table entries by page number */
+
+#if GCLIB_SPARSE_TABLE
+# define desc_g( pg )  gclib_desc( gclib_dir_g, pg )
+# define desc_b( pg )  gclib_desc( gclib_dir_b, pg )
+#else
+# define desc_g( pg )  gclib_desc_g[pg]
+# define desc_b( pg )  gclib_desc_b[pg]
+#endif
 
 /* Private globals */
 
@@ -121,7 +146,11 @@ static struct {
 } data;
 
 static byte *gclib_alloc( unsigned bytes );
-#if !GCLIB_LARGE_TABLE
+#if GCLIB_SPARSE_TABLE
+static gclib_desc_t *foreign_leaf_g;	/* shared by unallocated ranges */
+static gclib_desc_t *foreign_leaf_b;
+static void allocate_leaves( byte *ptr, byte *top );
+#elif !GCLIB_LARGE_TABLE
 static void allocation_below_membot( byte *ptr, int bytes );
 static void allocation_above_memtop( byte *ptr, int bytes );
 static void grow_table( byte *new_bot, byte *new_top );
@@ -137,6 +166,28 @@ gclib_init( void )
 {
   int i;
 
+#if GCLIB_SPARSE_TABLE
+  data.descriptor_slots = 0;	/* Counts the leaves instead */
+  foreign_leaf_g = 
+    (gclib_desc_t*)must_malloc( sizeof(gclib_desc_t) * GCLIB_LEAF_PAGES );
+  foreign_leaf_b = 
+    (gclib_desc_t*)must_malloc( sizeof(gclib_desc_t) * GCLIB_LEAF_PAGES );
+  for ( i = 0 ; i < GCLIB_LEAF_PAGES ; i++ ) {
+    foreign_leaf_g[i] = FOREIGN_PAGE;
+    foreign_leaf_b[i] = MB_FOREIGN;
+  }
+  gclib_dir_g = 
+    (gclib_desc_t**)must_malloc( sizeof(gclib_desc_t*) * GCLIB_DIR_ENTRIES );
+  gclib_dir_b = 
+    (gclib_desc_t**)must_malloc( sizeof(gclib_desc_t*) * GCLIB_DIR_ENTRIES );
+  for ( i = 0 ; i < GCLIB_DIR_ENTRIES ; i++ ) {
+    gclib_dir_g[i] = foreign_leaf_g;
+    gclib_dir_b[i] = foreign_leaf_b;
+  }
+  data.rts_bytes += 
+    2*sizeof(gclib_desc_t)*GCLIB_LEAF_PAGES + 
+    2*sizeof(gclib_desc_t*)*GCLIB_DIR_ENTRIES;
+#else
 #if GCLIB_LARGE_TABLE
   data.descriptor_slots = 4096*(1024*1024 / PAGESIZE);/* Slots to handle 4GB */
 #else
@@ -158,11 +209,12 @@ gclib_init( void )
     gclib_desc_b[i] = MB_FOREIGN;
 #endif
   }
+#endif /* GCLIB_SPARSE_TABLE */
 
   /* Leave these explicitly uninitialized until first allocation. */
   data.memtop = data.membot = 0;
   data.heapbot = data.heaplim = 0;
-#if !GCLIB_LARGE_TABLE
+#if !GCLIB_LARGE_TABLE && !GCLIB_SPARSE_TABLE
   gclib_pagebase = 0;
 #endif
 }
@@ -181,6 +233,21 @@ void gclib_memory_range( caddr_t *lowest, caddr_t *highest )
 #endif
 }
 
+void gclib_table_range( caddr_t *lowest, unsigned *pages )
+{
+#if GCLIB_SPARSE_TABLE
+  *lowest = (caddr_t)data.membot;
+  *pages = (data.memtop - data.membot) / PAGESIZE;
+#else
+#if GCLIB_LARGE_TABLE
+  *lowest = 0;
+#else
+  *lowest = gclib_pagebase;
+#endif
+  *pages = data.descriptor_slots;
+#endif
+}
+
 void gclib_set_heap_limit( int bytes )
 {
   data.heap_bytes_limit = bytes;
@@ -189,7 +256,7 @@ void gclib_set_heap_limit( int bytes )
 void *gclib_alloc_heap( int bytes, int gen_no )
 {
   byte *ptr;
-  int i;
+  word i;
 
   bytes = roundup_page( bytes );
 
@@ -203,11 +270,15 @@ void *gclib_alloc_heap( int bytes, int gen_no )
   ptr = gclib_alloc( bytes );
 
   for ( i = pageof( ptr ) ; i < pageof( ptr+bytes ) ; i++ ) {
-    gclib_desc_g[i] = gen_no;
+    desc_g( i ) = gen_no;
 #if !GCLIB_LARGE_TABLE
-    gclib_desc_b[i] = MB_ALLOCATED | MB_HEAP_MEMORY;
+    desc_b( i ) = MB_ALLOCATED | MB_HEAP_MEMORY;
 #endif
   }
+#if !defined(PETIT_LARCENY)
+  /* New code vectors are allocated in the heap like any bytevector. */
+  gclib_set_protection( ptr, bytes, GCLIB_PROT_MIXED );
+#endif
   data.heap_bytes += bytes;
   data.max_heap_bytes = umax( data.max_heap_bytes, data.heap_bytes );
 
@@ -224,17 +295,17 @@ void *gclib_alloc_heap( int bytes, int gen_no )
 void *gclib_alloc_rts( int bytes, unsigned attribute )
 {
   byte *ptr;
-  int i;
+  word i;
 
   bytes = roundup_page( bytes );
   ptr = gclib_alloc( bytes );
 
   for ( i = pageof( ptr ) ; i < pageof( ptr+bytes ) ; i++ ) {
 #if GCLIB_LARGE_TABLE
-    gclib_desc_g[i] = (MB_MASK & attribute) | RTS_OWNED_PAGE;
+    desc_g( i ) = (MB_MASK & attribute) | RTS_OWNED_PAGE;
 #else
-    gclib_desc_g[i] = RTS_OWNED_PAGE;
-    gclib_desc_b[i] = MB_ALLOCATED | MB_RTS_MEMORY | attribute;
+    desc_g( i ) = RTS_OWNED_PAGE;
+    desc_b( i ) = MB_ALLOCATED | MB_RTS_MEMORY | attribute;
 #endif
   }
   if (attribute & MB_REMSET) {
@@ -297,7 +368,14 @@ static byte *gclib_alloc( unsigned bytes )
   ptr = alloc_aligned( bytes );
   top = ptr+bytes;
 
-#if GCLIB_LARGE_TABLE
+#if GCLIB_SPARSE_TABLE
+  allocate_leaves( ptr, top );
+  if (data.membot == 0 || ptr < data.membot || top > data.memtop) {
+    if (data.membot == 0 || ptr < data.membot) data.membot = ptr;
+    if (data.memtop == 0 || top > data.memtop) data.memtop = top;
+    wb_re_setup( (byte*)0, (unsigned*)gclib_dir_g );
+  }
+#elif GCLIB_LARGE_TABLE
   if (data.membot == 0 || ptr < data.membot) data.membot = ptr;
   if (data.memtop == 0 || top > data.memtop) data.memtop = top;
 #else
@@ -317,7 +395,39 @@ static byte *gclib_alloc( unsigned bytes )
   return ptr;
 }
 
-#if !GCLIB_LARGE_TABLE
+#if GCLIB_SPARSE_TABLE
+/* Give every directory entry that covers [ptr,top) leaves of its own. */
+static void allocate_leaves( byte *ptr, byte *top )
+{
+  word d, i;
+  gclib_desc_t *leaf_g, *leaf_b;
+
+  assert( pageof( top-1 ) >> GCLIB_LEAF_SHIFT < GCLIB_DIR_ENTRIES );
+
+  for ( d = pageof( ptr ) >> GCLIB_LEAF_SHIFT ; 
+        d <= pageof( top-1 ) >> GCLIB_LEAF_SHIFT ; 
+        d++ ) {
+    if (gclib_dir_g[d] != foreign_leaf_g)
+      continue;
+    leaf_g = 
+      (gclib_desc_t*)must_malloc( sizeof(gclib_desc_t) * GCLIB_LEAF_PAGES );
+    leaf_b = 
+      (gclib_desc_t*)must_malloc( sizeof(gclib_desc_t) * GCLIB_LEAF_PAGES );
+    for ( i = 0 ; i < GCLIB_LEAF_PAGES ; i++ ) {
+      leaf_g[i] = FOREIGN_PAGE;
+      leaf_b[i] = MB_FOREIGN;
+    }
+    gclib_dir_g[d] = leaf_g;
+    gclib_dir_b[d] = leaf_b;
+    data.descriptor_slots += GCLIB_LEAF_PAGES;
+    data.rts_bytes += 2*sizeof(gclib_desc_t)*GCLIB_LEAF_PAGES;
+    annoyingmsg( "Low-level allocator: page table leaf %lu allocated.",
+                 (unsigned long)d );
+  }
+}
+#endif
+
+#if !GCLIB_LARGE_TABLE && !GCLIB_SPARSE_TABLE
 static void allocation_below_membot( byte *ptr, int bytes )
 {
   int i;
@@ -436,7 +546,7 @@ static void grow_table( byte *new_bot, byte *new_top )
 void gclib_free( void *addr, int bytes )
 {
   unsigned pages;
-  unsigned pageno;
+  word pageno;
 
   assert( (word)addr % PAGESIZE == 0 );
 
@@ -462,13 +572,13 @@ void gclib_free( void *addr, int bytes )
     else
       data.heap_bytes -= bytes;
 #else
-    if (gclib_desc_b[pageno] & MB_HEAP_MEMORY)
+    if (desc_b( pageno ) & MB_HEAP_MEMORY)
       data.heap_bytes -= bytes;
-    else if (gclib_desc_b[pageno] & MB_REMSET)
+    else if (desc_b( pageno ) & MB_REMSET)
       data.remset_bytes -= bytes;
-    else if (gclib_desc_b[pageno] & MB_SUMMARY_SETS)
+    else if (desc_b( pageno ) & MB_SUMMARY_SETS)
       data.summ_bytes -= bytes;
-    else if (gclib_desc_b[pageno] & MB_SMIRCY_MARK)
+    else if (desc_b( pageno ) & MB_SMIRCY_MARK)
       data.smircy_bytes -= bytes;
     else
       data.rts_bytes -= bytes;
@@ -477,11 +587,11 @@ void gclib_free( void *addr, int bytes )
 
   while (pages > 0) {
 #if !GCLIB_LARGE_TABLE
-    assert( (gclib_desc_b[pageno] & MB_ALLOCATED ) &&
-	    !(gclib_desc_b[pageno] & MB_FOREIGN ) );
-    gclib_desc_b[pageno] = MB_FOREIGN;
+    assert( (desc_b( pageno ) & MB_ALLOCATED ) &&
+	    !(desc_b( pageno ) & MB_FOREIGN ) );
+    desc_b( pageno ) = MB_FOREIGN;
 #endif
-    gclib_desc_g[pageno] = UNALLOCATED_PAGE;
+    desc_g( pageno ) = UNALLOCATED_PAGE;
     pageno++;
     pages--;
   }
@@ -489,6 +599,34 @@ void gclib_free( void *addr, int bytes )
   update_mem_bytes();
 }
 
+static int compare_blocks( const void *a, const void *b )
+{
+  byte *x = (byte*)((gclib_block_t*)a)->addr;
+  byte *y = (byte*)((gclib_block_t*)b)->addr;
+
+  return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+void gclib_free_blocks( gclib_block_t *blocks, int n )
+{
+  int i, j;
+  byte *start, *end;
+
+  qsort( blocks, n, sizeof( gclib_block_t ), compare_blocks );
+  for ( i=0 ; i < n ; i=j ) {
+    start = (byte*)blocks[i].addr;
+    end = start + roundup_page( blocks[i].bytes );
+    j = i+1;
+#if OSDEP_FREE_ALIGNED_MERGES
+    while (j < n && (byte*)blocks[j].addr == end) {
+      end += roundup_page( blocks[j].bytes );
+      j++;
+    }
+#endif
+    gclib_free( start, end - start );
+  }
+}
+
 void gclib_shrink_block( void *p, int oldsize, int newsize )
 {
   assert( oldsize >= newsize );
@@ -498,20 +636,20 @@ void gclib_shrink_block( void *p, int oldsize, int newsize )
 
 void gclib_set_generation( void *address, int nbytes, int generation )
 {
-  int p;
+  word p;
 
   for ( p = pageof( address ) ; nbytes > 0 ; nbytes -= PAGESIZE, p++ ) {
 #if GCLIB_LARGE_TABLE
     gclib_desc_g[p] = (gclib_desc_g[p] & MB_MASK) | generation;
 #else
-    gclib_desc_g[p] = generation;
+    desc_g( p ) = generation;
 #endif
   }
 }
 
 void gclib_add_attribute( void *address, int nbytes, unsigned attr )
 {
-  int p;
+  word p;
 
 #if GCLIB_LARGE_TABLE
   attr = attr & MB_MASK;
@@ -521,11 +659,24 @@ void gclib_add_attribute( void *address, int nbytes, unsigned attr )
 #if GCLIB_LARGE_TABLE
     gclib_desc_g[p] |= attr;
 #else
-    gclib_desc_b[p] |= attr;
+    desc_b( p ) |= attr;
 #endif
   }
 }
 
+void gclib_set_protection( void *address, int nbytes, int prot )
+{
+#if OSDEP_PROTECT_ALIGNED
+  assert( (word)address % PAGESIZE == 0 );
+#if !GCLIB_LARGE_TABLE
+  assert( attr_of( address ) & MB_HEAP_MEMORY );
+#endif
+
+  /* The GCLIB_PROT_ values are the OSDEP_PROT_ values. */
+  osdep_protect_aligned( address, roundup_page( nbytes ), prot );
+#endif
+}
+
 void gclib_stats( gclib_stats_t *stats )
 {
   stats->heap_allocated         = bytes2words( data.heap_bytes );
@@ -11,6 +11,9 @@
  * wb_disable() disables the barrier (see file Rts/Sparc/barrier.s).
  * wb_re_setup() is used by the low-level allocator to inform the
  *    barrier about a new (reallocated) page table.  This is a hack.
+ * wb_use_cards() selects card marking instead of the SSBs; the card
+ *    table is allocated by wb_setup() and follows the page table
+ *    in wb_re_setup().
  *
  * Also see Rts/Sparc/barrier.s.
  *
@@ -36,6 +39,13 @@ static word **wb_genssblimv;   /* ditto */
 static int wb_generations;     /* the value 'n' */
 static word *wb_globals;       /* the globals array */
 
+static bool wb_cards_wanted;   /* card marking selected */
+static byte *wb_cards;         /* the card table, or NULL */
+static word wb_cards_first;    /* card number of wb_cards[0] */
+static unsigned wb_cards_count; /* number of cards in wb_cards */
+
+static void setup_cards( void );
+
 void wb_setup( gclib_desc_t *genv, /* maps page number to generation number */
 	       byte *pagebase,     /* address of lowest page in arena: fixed */
 	       int generations,    /* the value 'n': fixed */
@@ -63,6 +73,9 @@ void wb_setup( gclib_desc_t *genv, /* maps page number to generation number */
   globals[ G_PGBASE ] = (word)pagebase;
   globals[ G_NP_YOUNG_GEN ] = (word)np_young_gen;
   globals[ G_NP_YOUNG_GEN_SSBIDX ] = (word)np_ssbidx;
+  globals[ G_CARDTBL ] = 0;
+  if (wb_cards_wanted)
+    setup_cards();
   wb_lowlevel_enable_barrier( globals );
 }
 
@@ -77,7 +90,64 @@ void wb_re_setup( byte *pagebase, unsigned *genv )
   if (wb_generations > 0) {
     wb_globals[ G_GENV ] = (word)genv;
     wb_globals[ G_PGBASE ] = (word)pagebase;
+    if (wb_cards != NULL)
+      setup_cards();
   }
 }
 
+void wb_use_cards( void )
+{
+  wb_cards_wanted = TRUE;
+}
+
+byte *wb_card_of( word *addr )
+{
+  word card = (word)addr >> CARD_SHIFT;
+
+  if (wb_cards == NULL)
+    return NULL;
+  assert( card - wb_cards_first < wb_cards_count );
+  return wb_cards + (card - wb_cards_first);
+}
+
+/* (Re)allocate the card table to cover the descriptor tables, keeping
+   the marks on cards that were covered before.  The table is allocated
+   with calloc() so that the pages of a large table that are never
+   touched need not be backed by memory.
+   */
+static void setup_cards( void )
+{
+  caddr_t lowest;
+  unsigned pages, count, i;
+  word first;
+  byte *cards;
+
+  gclib_table_range( &lowest, &pages );
+  first = (word)lowest >> CARD_SHIFT;
+  count = pages * (PAGESIZE / CARD_BYTES);
+  if (wb_cards != NULL && first == wb_cards_first && count == wb_cards_count)
+    return;
+
+  cards = (byte*)calloc( count, 1 );
+  while (cards == NULL) {
+    memfail( MF_MALLOC, "Could not allocate the card table." );
+    cards = (byte*)calloc( count, 1 );
+  }
+  if (wb_cards != NULL) {
+    for ( i = 0 ; i < wb_cards_count ; i++ )
+      if (wb_cards[i] != CARD_CLEAN &&
+          wb_cards_first + i - first < count)
+        cards[ wb_cards_first + i - first ] = wb_cards[i];
+    free( wb_cards );
+  }
+  else
+    annoyingmsg( "Write barrier marks %u cards of %d bytes.", 
+                 count, CARD_BYTES );
+
+  wb_cards = cards;
+  wb_cards_first = first;
+  wb_cards_count = count;
+  wb_globals[ G_CARDTBL ] = (word)(cards - first);
+}
+
 /* eof */
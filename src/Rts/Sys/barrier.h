@@ -32,6 +32,27 @@ void wb_disable_barrier( word *globals );
 /* If the descriptor tables change, notify the barrier */
 void wb_re_setup( byte *pagebase, unsigned *genv );
 
+/* Card marking.  When the card table is in use, the barrier does not
+   log into the SSBs but marks the card that holds the header of the
+   lhs object, and globals[ G_CARDTBL ] holds the table biased so that
+   it can be indexed by an address shifted right by CARD_SHIFT.  The
+   table covers the range of the descriptor tables.  See uremset_cards.c.
+   */
+
+#define CARD_SHIFT  9           /* 512-byte cards */
+#define CARD_BYTES  (1 << CARD_SHIFT)
+#define CARD_CLEAN  0
+#define CARD_DIRTY  1
+
+#define wb_mark_card( globals, lhs ) \
+  (((byte*)(globals)[ G_CARDTBL ])[ (word)(lhs) >> CARD_SHIFT ] = CARD_DIRTY)
+
+/* Select card marking; must be called before wb_setup(). */
+void wb_use_cards( void );
+
+/* The card of `addr', or NULL if card marking is not in use. */
+byte *wb_card_of( word *addr );
+
 /* Lowlevel support for barrier setup and shutdown. */
 
 extern void wb_lowlevel_disable_barrier( word *globals );
@@ -0,0 +1,362 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- bulk operations on bitmaps.
+ *
+ * See bitmap.h for the interface.
+ *
+ * The range operations deal with the partial words at either end and
+ * pass the whole words in between to one of three sets of kernels:
+ * plain C, SSE4.2, and AVX2.  The set is chosen by bitmap_init() when
+ * the collector is created, before any collector thread runs.  The
+ * x86 kernels are compiled with per-function target attributes, so
+ * the rest of the system need not be compiled for those instruction
+ * sets; that needs GCC 4.9 or later, or clang.
+ */
+
+#include "larceny.h"
+#include "bitmap.h"
+
+#if defined(BITS_32)
+# define BITS_IN_WORD       32
+# define BIT_IDX_TO_WORD    5   /* shift to get word index from bit index */
+# define BIT_IN_WORD_MASK   31  /* mask to get bit within word */
+#elif defined(BITS_64)
+# define BITS_IN_WORD       64
+# define BIT_IDX_TO_WORD    6
+# define BIT_IN_WORD_MASK   63
+#else
+# error "Must define bitmap macros for non-32 bit systems."
+#endif
+
+#define FROM_BIT( b )   (~(word)0 << ((b) & BIT_IN_WORD_MASK))
+  /* Bits of a word at or above bit b */
+#define BELOW_BIT( b )  (~(word)0 >> (BIT_IN_WORD_MASK - (((b)-1) & BIT_IN_WORD_MASK)))
+  /* Bits of a word below bit b, for b in (k*BITS_IN_WORD,
+     (k+1)*BITS_IN_WORD]; all of them when b is the next word's first */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || \
+                            (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+# define X86_KERNELS 1
+# include <immintrin.h>
+# define WORDS_PER_XMM  (16/sizeof(word))
+# define WORDS_PER_YMM  (32/sizeof(word))
+#else
+# define X86_KERNELS 0
+#endif
+
+static void clear_words( word *p, int n );
+static int popcount_words( word *p, int n );
+static void join_words( word *dest, word *src, int n );
+static int first_nonzero_word( word *p, int n );
+
+/* The plain C kernels until bitmap_init() has made the choice. */
+static struct {
+  void (*clear)( word *p, int n );
+  int  (*popcount)( word *p, int n );
+  void (*join)( word *dest, word *src, int n );
+  int  (*first_nonzero)( word *p, int n );  /* Index of first, or n */
+} kernels = { clear_words, popcount_words, join_words, first_nonzero_word };
+
+/* Plain C */
+
+static int popcount_word( word w )
+{
+#if defined(__GNUC__)
+  return __builtin_popcountl( (unsigned long)w );
+#else
+  int n = 0;
+  for ( ; w != 0 ; w &= w-1 )
+    n++;
+  return n;
+#endif
+}
+
+static int lowest_bit( word w )
+{
+#if defined(__GNUC__)
+  return __builtin_ctzl( (unsigned long)w );
+#else
+  int n = 0;
+  for ( ; (w & 1) == 0 ; w >>= 1 )
+    n++;
+  return n;
+#endif
+}
+
+static void clear_words( word *p, int n )
+{
+  memset( p, 0, n*sizeof(word) );
+}
+
+static int popcount_words( word *p, int n )
+{
+  int i, count = 0;
+
+  for ( i = 0 ; i < n ; i++ )
+    count += popcount_word( p[i] );
+  return count;
+}
+
+static void join_words( word *dest, word *src, int n )
+{
+  int i;
+
+  for ( i = 0 ; i < n ; i++ )
+    dest[i] |= src[i];
+}
+
+static int first_nonzero_word( word *p, int n )
+{
+  int i;
+
+  for ( i = 0 ; i < n && p[i] == 0 ; i++ )
+    ;
+  return i;
+}
+
+#if X86_KERNELS
+
+/* SSE4.2.  The population count is the AVX2 one below on 128-bit
+   vectors: pshufb (SSSE3) looks up the count of each nibble, and
+   psadbw sums the bytes of the counts.  ptest came with SSE4.1. */
+
+__attribute__((target("sse4.2,popcnt")))
+static void clear_words_sse( word *p, int n )
+{
+  __m128i zero = _mm_setzero_si128();
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_XMM <= n ; i += WORDS_PER_XMM )
+    _mm_storeu_si128( (__m128i*)(p+i), zero );
+  for ( ; i < n ; i++ )
+    p[i] = 0;
+}
+
+__attribute__((target("sse4.2,popcnt")))
+static int popcount_words_sse( word *p, int n )
+{
+  const __m128i table = _mm_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3,
+                                       1, 2, 2, 3, 2, 3, 3, 4 );
+  const __m128i nibble = _mm_set1_epi8( 0x0f );
+  __m128i acc = _mm_setzero_si128();
+  __m128i v, c;
+  long long sums[2];
+  int i, count;
+
+  for ( i = 0 ; i + WORDS_PER_XMM <= n ; i += WORDS_PER_XMM ) {
+    v = _mm_loadu_si128( (__m128i*)(p+i) );
+    c = _mm_add_epi8(
+          _mm_shuffle_epi8( table, _mm_and_si128( v, nibble ) ),
+          _mm_shuffle_epi8( table,
+                            _mm_and_si128( _mm_srli_epi16( v, 4 ), nibble ) ) );
+    acc = _mm_add_epi64( acc, _mm_sad_epu8( c, _mm_setzero_si128() ) );
+  }
+  _mm_storeu_si128( (__m128i*)sums, acc );
+  count = (int)(sums[0] + sums[1]);
+  for ( ; i < n ; i++ )
+    count += __builtin_popcountl( (unsigned long)p[i] );
+  return count;
+}
+
+__attribute__((target("sse4.2,popcnt")))
+static void join_words_sse( word *dest, word *src, int n )
+{
+  __m128i a, b;
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_XMM <= n ; i += WORDS_PER_XMM ) {
+    a = _mm_loadu_si128( (__m128i*)(dest+i) );
+    b = _mm_loadu_si128( (__m128i*)(src+i) );
+    _mm_storeu_si128( (__m128i*)(dest+i), _mm_or_si128( a, b ) );
+  }
+  for ( ; i < n ; i++ )
+    dest[i] |= src[i];
+}
+
+__attribute__((target("sse4.2,popcnt")))
+static int first_nonzero_word_sse( word *p, int n )
+{
+  __m128i v;
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_XMM <= n ; i += WORDS_PER_XMM ) {
+    v = _mm_loadu_si128( (__m128i*)(p+i) );
+    if (!_mm_testz_si128( v, v ))
+      break;
+  }
+  for ( ; i < n && p[i] == 0 ; i++ )
+    ;
+  return i;
+}
+
+/* AVX2.  The population count looks up the count of each nibble in a
+   table held in a register, and sums the bytes of the counts with
+   psadbw every vector. */
+
+__attribute__((target("avx2,popcnt")))
+static void clear_words_avx2( word *p, int n )
+{
+  __m256i zero = _mm256_setzero_si256();
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_YMM <= n ; i += WORDS_PER_YMM )
+    _mm256_storeu_si256( (__m256i*)(p+i), zero );
+  for ( ; i < n ; i++ )
+    p[i] = 0;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int popcount_words_avx2( word *p, int n )
+{
+  const __m256i table = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4 );
+  const __m256i nibble = _mm256_set1_epi8( 0x0f );
+  __m256i acc = _mm256_setzero_si256();
+  __m256i v, c;
+  long long sums[4];
+  int i, count;
+
+  for ( i = 0 ; i + WORDS_PER_YMM <= n ; i += WORDS_PER_YMM ) {
+    v = _mm256_loadu_si256( (__m256i*)(p+i) );
+    c = _mm256_add_epi8(
+          _mm256_shuffle_epi8( table, _mm256_and_si256( v, nibble ) ),
+          _mm256_shuffle_epi8( table,
+                               _mm256_and_si256( _mm256_srli_epi16( v, 4 ),
+                                                 nibble ) ) );
+    acc = _mm256_add_epi64( acc,
+                            _mm256_sad_epu8( c, _mm256_setzero_si256() ) );
+  }
+  _mm256_storeu_si256( (__m256i*)sums, acc );
+  count = (int)(sums[0] + sums[1] + sums[2] + sums[3]);
+  for ( ; i < n ; i++ )
+    count += __builtin_popcountl( (unsigned long)p[i] );
+  return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+static void join_words_avx2( word *dest, word *src, int n )
+{
+  __m256i a, b;
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_YMM <= n ; i += WORDS_PER_YMM ) {
+    a = _mm256_loadu_si256( (__m256i*)(dest+i) );
+    b = _mm256_loadu_si256( (__m256i*)(src+i) );
+    _mm256_storeu_si256( (__m256i*)(dest+i), _mm256_or_si256( a, b ) );
+  }
+  for ( ; i < n ; i++ )
+    dest[i] |= src[i];
+}
+
+__attribute__((target("avx2,popcnt")))
+static int first_nonzero_word_avx2( word *p, int n )
+{
+  __m256i v;
+  int i;
+
+  for ( i = 0 ; i + WORDS_PER_YMM <= n ; i += WORDS_PER_YMM ) {
+    v = _mm256_loadu_si256( (__m256i*)(p+i) );
+    if (!_mm256_testz_si256( v, v ))
+      break;
+  }
+  for ( ; i < n && p[i] == 0 ; i++ )
+    ;
+  return i;
+}
+
+#endif /* X86_KERNELS */
+
+void bitmap_init( void )
+{
+  char *name = "C";
+
+#if X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "popcnt" )) {
+    name = "AVX2";
+    kernels.clear = clear_words_avx2;
+    kernels.popcount = popcount_words_avx2;
+    kernels.join = join_words_avx2;
+    kernels.first_nonzero = first_nonzero_word_avx2;
+  }
+  else if (__builtin_cpu_supports( "sse4.2" ) &&
+           __builtin_cpu_supports( "popcnt" )) {
+    name = "SSE4.2";
+    kernels.clear = clear_words_sse;
+    kernels.popcount = popcount_words_sse;
+    kernels.join = join_words_sse;
+    kernels.first_nonzero = first_nonzero_word_sse;
+  }
+#endif
+  annoyingmsg( "Bitmap operations use %s kernels.", name );
+}
+
+/* Range operations */
+
+void bitmap_clear( word *bitmap, int lo, int hi )
+{
+  int wlo, whi;
+
+  if (lo >= hi)
+    return;
+  wlo = lo >> BIT_IDX_TO_WORD;
+  whi = (hi-1) >> BIT_IDX_TO_WORD;
+  if (wlo == whi)
+    bitmap[wlo] &= ~(FROM_BIT( lo ) & BELOW_BIT( hi ));
+  else {
+    bitmap[wlo] &= ~FROM_BIT( lo );
+    kernels.clear( bitmap+wlo+1, whi-wlo-1 );
+    bitmap[whi] &= ~BELOW_BIT( hi );
+  }
+}
+
+int bitmap_popcount( word *bitmap, int lo, int hi )
+{
+  int wlo, whi;
+
+  if (lo >= hi)
+    return 0;
+  wlo = lo >> BIT_IDX_TO_WORD;
+  whi = (hi-1) >> BIT_IDX_TO_WORD;
+  if (wlo == whi)
+    return popcount_word( bitmap[wlo] & FROM_BIT( lo ) & BELOW_BIT( hi ) );
+  else
+    return (popcount_word( bitmap[wlo] & FROM_BIT( lo ) ) +
+            kernels.popcount( bitmap+wlo+1, whi-wlo-1 ) +
+            popcount_word( bitmap[whi] & BELOW_BIT( hi ) ));
+}
+
+void bitmap_union( word *dest, word *src, int words )
+{
+  kernels.join( dest, src, words );
+}
+
+int bitmap_next_set( word *bitmap, int lo, int hi )
+{
+  int w, whi, bit;
+  word bits;
+
+  if (lo >= hi)
+    return hi;
+  w = lo >> BIT_IDX_TO_WORD;
+  whi = (hi-1) >> BIT_IDX_TO_WORD;
+  bits = bitmap[w] & FROM_BIT( lo );
+  if (bits == 0) {
+    if (w == whi)
+      return hi;
+    w = w+1 + kernels.first_nonzero( bitmap+w+1, whi-w );
+    if (w > whi)
+      return hi;
+    bits = bitmap[w];
+  }
+  bit = (w << BIT_IDX_TO_WORD) + lowest_bit( bits );
+  return (bit < hi) ? bit : hi;
+}
+
+/* eof */
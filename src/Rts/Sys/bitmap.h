@@ -0,0 +1,46 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- bulk operations on bitmaps.
+ *
+ * The mark bitmaps of msgc-core.c and smircy.c and the leaves of the
+ * extensible bitmaps in extbmp.c are arrays of words in which bit j of
+ * word i is bit number i*BITS_IN_WORD+j.  The operations here work on
+ * ranges of such bits.  On x86 they use SSE4.2 or AVX2 when the
+ * processor has them, as determined by CPUID in bitmap_init();
+ * elsewhere they work a word at a time.
+ *
+ * Ranges are half-open, [lo,hi), and given in bits.
+ */
+
+#ifndef INCLUDED_BITMAP_H
+#define INCLUDED_BITMAP_H
+
+#include "larceny-types.h"
+
+void bitmap_init( void );
+  /* Chooses the kernels.  Called once by create_gc(), before there are
+     collector threads; until then the operations work a word at a time.
+     */
+
+void bitmap_clear( word *bitmap, int lo, int hi );
+  /* Clears bits [lo,hi).
+     */
+
+int bitmap_popcount( word *bitmap, int lo, int hi );
+  /* Returns the number of bits in [lo,hi) that are set.
+     */
+
+void bitmap_union( word *dest, word *src, int words );
+  /* dest[i] := dest[i] | src[i] for i in [0,words).
+     */
+
+int bitmap_next_set( word *bitmap, int lo, int hi );
+  /* Returns the number of the first set bit in [lo,hi), or hi if there
+     is none.
+     */
+
+#endif /* INCLUDED_BITMAP_H */
+
+/* eof */
@@ -144,7 +144,7 @@
         word *T_oldptr = ptr;                                                 \
         word T_bytes = roundup4( sizefield( T_w ) );                          \
         ptr = (word *)((word)ptr + (T_bytes + 4)); /* doesn't skip padding */ \
-        if (!(T_bytes & 4)) *ptr++ = 0;            /* pad. */                 \
+        if (!(T_bytes & 4)) skip_pad( ptr );     /* pad. */                   \
         /* Only code vectors typically use a plain bytevector typetag,        \
          * so almost any bytevector will be a code vector that must           \
          * be flushed.                                                        \
@@ -163,7 +163,7 @@
           ptr++;                                                              \
         }                                                                     \
         if (must_add_to_extra) remember_vec( tagptr( T_objp, VEC_TAG ), e );  \
-        if (!(sizefield( T_w ) & 4)) *ptr++ = 0; /* pad. */                   \
+        if (!(sizefield( T_w ) & 4)) skip_pad( ptr ); /* pad. */              \
       }                                                                       \
     }                                                                         \
     else {                                                                    \
@@ -0,0 +1,584 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny -- parallel copying for stopcopy and generational promotion.
+ *
+ * Entry point (from cheney.c):
+ *   par_oldspace_copy
+ *
+ * This is the copying phase of gclib_stopcopy_promote_into and
+ * gclib_stopcopy_collect, spread over the threads of gc->workers.
+ * It is used only when the collection needs none of the extensions
+ * of the serial collector (no remembered-set updating during the
+ * scan, no snapshot marking in progress, no splitting, no
+ * non-predictive promotion).  Otherwise the caller falls back to the
+ * serial algorithm.
+ *
+ * Algorithm.
+ *
+ * The roots and the remembered set are enumerated serially into two
+ * arrays.  The remembered set scanner decides whether each entry is
+ * retained exactly as remset_scanner_oflo() does, by looking at the
+ * generations of the referents before anything is forwarded.
+ *
+ * The workers then claim batches of roots and remembered objects with
+ * an atomic add, forwarding what they refer to.  Every worker copies
+ * into its own local allocation buffer (LAB), which is a chunk of the
+ * tospace; worker 0 starts in the chunk that is current at the time
+ * of the call and the others obtain chunks from gc_find_space() when
+ * they first need one.  The objects in [grey,dest) of a worker's LAB
+ * have been copied but not scanned; a worker scans them Cheney-style,
+ * and when its LAB is exhausted the unscanned part of the old LAB is
+ * published on a shared work list of ranges.  Long local ranges are
+ * also published when some worker is idle.
+ *
+ * An object is claimed for copying by replacing its first word with
+ * BUSY_HDR using compare-and-swap.  The winner copies the object,
+ * stores the forwarding pointer in the second word, and then stores
+ * FORWARD_HDR in the first word.  Losers wait for FORWARD_HDR.
+ * BUSY_HDR is a reserved header (RES_HDR) with the maximal size field,
+ * and never appears in the first word of a live object or pair.
+ *
+ * Large objects in the LOS are marked under the pool lock and their
+ * extent is put on the work list to be scanned in place, replacing
+ * the serial collector's walk of los->mark1.
+ *
+ * Allocating a LAB or a large object may move the page table, which
+ * every worker reads through gen_of(), and may reallocate the chunk
+ * array of the tospace.  Workers therefore run in the pool's shared
+ * mode and switch to exclusive mode to allocate; see gc_workers_t.h.
+ * A worker that waits for a claimed object yields its shared mode
+ * periodically, since the claimant may be waiting to allocate.
+ *
+ * The collection terminates when every worker is idle and the work
+ * list is empty.
+ */
+
+#define GC_INTERNAL
+
+#include <string.h>
+#include "larceny.h"
+#include "memmgr.h"
+#include "gc_t.h"
+#include "gset_t.h"
+#include "semispace_t.h"
+#include "los_t.h"
+#include "gclib.h"
+#include "stats.h"
+#include "cheney.h"
+#include "gc_workers_t.h"
+
+#define BUSY_HDR         0xFFFFFF82  /* mkheader( 0xFFFFFF, RES_HDR ) */
+#define ROOT_BATCH       64          /* Roots claimed at a time */
+#define REMSET_BATCH     16          /* Remembered objects claimed at a time */
+#define SHARE_WORDS      256         /* Grey ranges longer than this are
+                                        shared when a worker is idle */
+#define SPIN_YIELD       1024        /* Spins between yields on a claim */
+
+/* External */
+
+extern void mem_icache_flush( void *start, void *end );
+
+typedef struct par_range par_range_t;
+typedef struct par_worker par_worker_t;
+typedef struct par_env par_env_t;
+
+struct par_range {
+  word *lo;
+  word *hi;
+};
+
+struct par_worker {
+  par_env_t *env;
+  int  chunk;                   /* Index of LAB chunk in tospace, or -1 */
+  word *dest;                   /* Copy pointer in LAB */
+  word *lim;                    /* Copy limit of LAB */
+  word *grey;                   /* [grey,dest) is copied but not scanned */
+  int  words_forwarded_from_nursery;
+  word pad[8];                  /* Keep workers off each other's lines */
+};
+
+struct par_env {
+  gc_t *gc;
+  gc_workers_t *pool;
+  semispace_t *tospace;
+  gset_t forw_gset;
+  int  tgt_gen;
+  bool iflush;
+
+  word **roots;                 /* Locations of roots to forward */
+  int  roots_len;
+  int  roots_cap;
+  int  roots_next;              /* Next unclaimed root; atomic */
+
+  word *remset;                 /* Remembered objects to scan */
+  int  remset_len;
+  int  remset_cap;
+  int  remset_next;             /* Next unclaimed object; atomic */
+  int  remset_scanned;          /* For the remset statistics */
+
+  /* The following are protected by the pool lock. */
+  par_range_t *work;            /* Shared grey ranges */
+  int  work_len;
+  int  work_cap;
+  int  idle;                    /* Number of idle workers */
+  bool done;                    /* TRUE when all work is complete */
+
+  int  nworkers;
+  par_worker_t *workers;
+};
+
+static word par_forward( par_worker_t *w, word obj, int gno );
+
+#define forward_p( env, gno ) \
+  ((gno) == 0 || gset_memberp( (gno), (env)->forw_gset ))
+
+#define par_forw( w, loc )                                              \
+  do { word T_obj = *(loc);                                             \
+       if (isptr( T_obj )) {                                            \
+         int T_gno = gen_of( T_obj );                                   \
+         if (forward_p( (w)->env, T_gno ))                              \
+           *(loc) = par_forward( (w), T_obj, T_gno );                   \
+       }                                                                \
+  } while (0)
+
+/* Work list; the caller holds the pool lock. */
+
+static void push_range_locked( par_env_t *env, word *lo, word *hi )
+{
+  if (lo == hi) return;
+  if (env->work_len == env->work_cap) {
+    env->work_cap = (env->work_cap == 0 ? 64 : env->work_cap*2);
+    env->work = (par_range_t*)
+      must_realloc( env->work, sizeof( par_range_t )*env->work_cap );
+  }
+  env->work[env->work_len].lo = lo;
+  env->work[env->work_len].hi = hi;
+  env->work_len++;
+  if (env->idle > 0)
+    gc_workers_broadcast( env->pool );
+}
+
+/* Like seal_chunk(), but for any chunk of the semispace.
+   The caller is in exclusive mode. */
+
+static void seal_lab( par_worker_t *w )
+{
+  semispace_t *ss = w->env->tospace;
+  word *dest = w->dest, *lim = w->lim;
+
+  if (dest < lim) {
+    word len = (lim - dest)*sizeof(word);
+    *dest = mkheader(len-sizeof(word),BIGNUM_HDR);
+    if (dest+1 < lim) *(dest+1) = 0xABCDABCD;
+  }
+  ss->chunks[ w->chunk ].top = dest;
+  assert2( ss->chunks[ w->chunk ].bot <= ss->chunks[ w->chunk ].top );
+}
+
+static void new_lab( par_worker_t *w, unsigned bytes )
+{
+  par_env_t *env = w->env;
+  semispace_t *ss;
+
+  gc_workers_leave_shared( env->pool );
+  gc_workers_enter_exclusive( env->pool );
+  if (w->chunk >= 0) {
+    seal_lab( w );
+    gc_workers_lock( env->pool );
+    push_range_locked( env, w->grey, w->dest );
+    gc_workers_unlock( env->pool );
+  }
+  ss = gc_find_space( env->gc, bytes, env->tospace );
+  assert( ss == env->tospace );
+  w->chunk = ss->current;
+  w->dest = w->grey = ss->chunks[ ss->current ].top;
+  w->lim = ss->chunks[ ss->current ].lim;
+  gc_workers_leave_exclusive( env->pool );
+  gc_workers_enter_shared( env->pool );
+}
+
+static word publish( word *ptr, word *newptr, word tag )
+{
+  word ret = (word)tagptr( newptr, tag );
+
+  *(ptr+1) = ret;
+  gc_memory_barrier();
+  *(volatile word*)ptr = FORWARD_HDR;
+  return ret;
+}
+
+static word copy_small( par_worker_t *w, word *ptr, word tag, word first,
+                        unsigned words, int gno )
+{
+  word *newptr;
+  unsigned need = words*sizeof(word) + (tag == BVEC_TAG ? 8 : 0);
+
+  if ((unsigned)((char*)w->lim - (char*)w->dest) < need)
+    new_lab( w, need );
+
+  /* Keep bytevectors 4-word aligned, as forward() does. */
+  if (tag == BVEC_TAG && (((word)w->dest) & 0xF) == 0x8) {
+    w->dest[0] = 0;
+    w->dest[1] = 0;
+    w->dest += 2;
+  }
+
+  newptr = w->dest;
+  newptr[0] = first;
+  if (words < 32) {
+    unsigned i;
+    for ( i=1 ; i < words ; i++ )
+      newptr[i] = ptr[i];
+  }
+  else
+    memcpy( newptr+1, ptr+1, (words-1)*sizeof(word) );
+  w->dest += words;
+
+  if (gno == 0)
+    w->words_forwarded_from_nursery += words;
+  if (tag == BVEC_TAG)
+    copied_icache_flush( newptr );
+  return publish( ptr, newptr, tag );
+}
+
+/* A large object that lives in the LOS is marked and scanned in place. */
+
+static word mark_large( par_worker_t *w, word *ptr, word tag, unsigned words )
+{
+  par_env_t *env = w->env;
+  los_t *los = env->gc->los;
+  int src_gen;
+  bool was_marked;
+
+  gc_workers_lock( env->pool );
+  src_gen = gen_of( ptr );
+  was_marked =
+    los_mark_and_set_generation( los, los->mark1, ptr, src_gen, env->tgt_gen );
+  if (!was_marked) {
+    push_range_locked( env, ptr, ptr+words );
+    if (src_gen == 0)
+      w->words_forwarded_from_nursery += words;
+  }
+  gc_workers_unlock( env->pool );
+  return tagptr( ptr, tag );
+}
+
+/* A large object that was not allocated in the LOS must be moved there;
+   the caller has claimed it. */
+
+static word copy_large( par_worker_t *w, word *ptr, word tag, word hdr,
+                        unsigned words, int gno )
+{
+  par_env_t *env = w->env;
+  los_t *los = env->gc->los;
+  word *newptr;
+
+  gc_workers_leave_shared( env->pool );
+  gc_workers_enter_exclusive( env->pool );
+  newptr = los_allocate( los, words*sizeof(word), gno );
+  newptr[0] = hdr;
+  memcpy( newptr+1, ptr+1, (words-1)*sizeof(word) );
+  los_mark_and_set_generation( los, los->mark1, newptr, gno, env->tgt_gen );
+  gc_workers_lock( env->pool );
+  push_range_locked( env, newptr, newptr+words );
+  gc_workers_unlock( env->pool );
+  gc_workers_leave_exclusive( env->pool );
+  gc_workers_enter_shared( env->pool );
+
+  if (gno == 0)
+    w->words_forwarded_from_nursery += words;
+  if (tag == BVEC_TAG)
+    copied_icache_flush( newptr );
+  return publish( ptr, newptr, tag );
+}
+
+static word par_forward( par_worker_t *w, word obj, int gno )
+{
+  word * const ptr = ptrof( obj );
+  const word tag = tagof( obj );
+  unsigned spins = 0;
+
+  while (1) {
+    word first = *(volatile word*)ptr;
+
+    if (first == FORWARD_HDR) {
+      gc_memory_barrier();
+      return *(volatile word*)(ptr+1);
+    }
+    else if (first == BUSY_HDR) {
+      /* Another worker is copying it, and may need exclusive mode. */
+      if (++spins % SPIN_YIELD == 0)
+        gc_workers_yield_shared( w->env->pool );
+    }
+    else if (tag == PAIR_TAG) {
+      if (gc_atomic_cas( ptr, first, BUSY_HDR ))
+        return copy_small( w, ptr, tag, first, 2, gno );
+    }
+    else {
+      unsigned words;
+
+      assert2( ishdr( first ) );
+      words = roundup8( sizefield( first ) + 4 ) / 4;
+      if (words > GC_LARGE_OBJECT_LIMIT/4 && (attr_of( ptr ) & MB_LARGE_OBJECT))
+        return mark_large( w, ptr, tag, words );
+      if (gc_atomic_cas( ptr, first, BUSY_HDR )) {
+        if (words > GC_LARGE_OBJECT_LIMIT/4)
+          return copy_large( w, ptr, tag, first, words, gno );
+        else
+          return copy_small( w, ptr, tag, first, words, gno );
+      }
+    }
+  }
+}
+
+static void scan_range( par_worker_t *w, word *ptr, word *lim )
+{
+  par_env_t *env = w->env;
+
+  while (ptr < lim)
+    scan_core( env, ptr, env->iflush, par_forw( w, ptr ) );
+}
+
+static void scan_remembered( par_worker_t *w, word obj )
+{
+  word *p = ptrof( obj );
+
+  if (tagof( obj ) == PAIR_TAG) {
+    par_forw( w, p );
+    par_forw( w, p+1 );
+  }
+  else {
+    word words = sizefield( *p ) / 4;
+    while (words--) {
+      ++p;
+      par_forw( w, p );
+    }
+  }
+}
+
+/* Scan until every worker runs out of work.  The worker is in shared
+   mode on entry and exit, but not while it waits for work. */
+
+static void trace( par_worker_t *w )
+{
+  par_env_t *env = w->env;
+
+  while (1) {
+    par_range_t r;
+
+    if (w->grey < w->dest) {
+      r.lo = w->grey;
+      r.hi = w->grey = w->dest;
+      if (env->idle > 0 && r.hi - r.lo > SHARE_WORDS) {
+        gc_workers_lock( env->pool );
+        push_range_locked( env, r.lo, r.hi );
+        gc_workers_unlock( env->pool );
+      }
+      else {
+        scan_range( w, r.lo, r.hi );
+        gc_workers_yield_shared( env->pool );
+        continue;
+      }
+    }
+
+    gc_workers_leave_shared( env->pool );
+    gc_workers_lock( env->pool );
+    while (env->work_len == 0 && !env->done) {
+      env->idle++;
+      if (env->idle == env->nworkers) {
+        env->done = TRUE;
+        gc_workers_broadcast( env->pool );
+      }
+      else
+        gc_workers_wait( env->pool );
+      env->idle--;
+    }
+    if (env->work_len == 0) {
+      gc_workers_unlock( env->pool );
+      gc_workers_enter_shared( env->pool );
+      return;
+    }
+    r = env->work[ --env->work_len ];
+    gc_workers_unlock( env->pool );
+    gc_workers_enter_shared( env->pool );
+    scan_range( w, r.lo, r.hi );
+  }
+}
+
+static void par_copy_worker( int id, void *data )
+{
+  par_env_t *env = (par_env_t*)data;
+  par_worker_t *w = &env->workers[id];
+  int i, k;
+
+  gc_workers_enter_shared( env->pool );
+
+  while ((i = gc_atomic_add( &env->roots_next, ROOT_BATCH ))
+         < env->roots_len) {
+    for ( k=min( i+ROOT_BATCH, env->roots_len ) ; i < k ; i++ )
+      par_forw( w, env->roots[i] );
+    gc_workers_yield_shared( env->pool );
+  }
+
+  while ((i = gc_atomic_add( &env->remset_next, REMSET_BATCH ))
+         < env->remset_len) {
+    for ( k=min( i+REMSET_BATCH, env->remset_len ) ; i < k ; i++ )
+      scan_remembered( w, env->remset[i] );
+    if (w->grey < w->dest) {
+      word *lo = w->grey;
+      w->grey = w->dest;
+      scan_range( w, lo, w->grey );
+    }
+    gc_workers_yield_shared( env->pool );
+  }
+
+  trace( w );
+
+  gc_workers_leave_shared( env->pool );
+  if (w->chunk >= 0) {
+    gc_workers_enter_exclusive( env->pool );
+    seal_lab( w );
+    gc_workers_leave_exclusive( env->pool );
+  }
+}
+
+/* Serial enumeration of roots and remembered sets. */
+
+static void record_root( word *loc, void *data )
+{
+  par_env_t *env = (par_env_t*)data;
+  word obj = *loc;
+
+  if (!isptr( obj ) || !forward_p( env, gen_of( obj ) ))
+    return;
+  if (env->roots_len == env->roots_cap) {
+    env->roots_cap = (env->roots_cap == 0 ? 256 : env->roots_cap*2);
+    env->roots = (word**)
+      must_realloc( env->roots, sizeof( word* )*env->roots_cap );
+  }
+  env->roots[ env->roots_len++ ] = loc;
+}
+
+static void record_remset_field( par_env_t *env, word x, unsigned old_obj_gen,
+                                 bool *has_intergen_ptr, bool *needs_scan )
+{
+  if (isptr( x )) {
+    unsigned gno = gen_of( x );
+    if (gno < old_obj_gen) *has_intergen_ptr = TRUE;
+    if (forward_p( env, gno )) *needs_scan = TRUE;
+  }
+}
+
+static bool record_remembered( word object, void *data )
+{
+  par_env_t *env = (par_env_t*)data;
+  unsigned old_obj_gen = gen_of( object );
+  bool has_intergen_ptr = FALSE, needs_scan = FALSE;
+  word *p = ptrof( object );
+
+  env->remset_scanned++;
+  assert2( *p != FORWARD_HDR );
+  if (tagof( object ) == PAIR_TAG) {
+    record_remset_field( env, p[0], old_obj_gen,
+                         &has_intergen_ptr, &needs_scan );
+    record_remset_field( env, p[1], old_obj_gen,
+                         &has_intergen_ptr, &needs_scan );
+  }
+  else {
+    word words = sizefield( *p ) / 4;
+    while (words--) {
+      ++p;
+      record_remset_field( env, *p, old_obj_gen,
+                           &has_intergen_ptr, &needs_scan );
+    }
+  }
+
+  if (needs_scan) {
+    if (env->remset_len == env->remset_cap) {
+      env->remset_cap = (env->remset_cap == 0 ? 256 : env->remset_cap*2);
+      env->remset = (word*)
+        must_realloc( env->remset, sizeof( word )*env->remset_cap );
+    }
+    env->remset[ env->remset_len++ ] = object;
+  }
+  return has_intergen_ptr;
+}
+
+static void enumerate_remsets( par_env_t *env )
+{
+  stats_id_t timer1, timer2;
+  int elapsed, cpu;
+  gc_t *gc = env->gc;
+
+  timer1 = stats_start_timer( TIMER_ELAPSED );
+  timer2 = stats_start_timer( TIMER_CPU );
+
+  env->remset_scanned = 0;
+  gc_enumerate_remsets_complement( gc, env->forw_gset,
+                                   record_remembered, (void*)env );
+
+  elapsed = stats_stop_timer( timer1 );
+  cpu     = stats_stop_timer( timer2 );
+
+  gc->stat_max_entries_remset_scan =
+    max( gc->stat_max_entries_remset_scan, env->remset_scanned );
+  gc->stat_max_remset_scan = max( gc->stat_max_remset_scan, elapsed );
+  gc->stat_max_remset_scan_cpu = max( gc->stat_max_remset_scan_cpu, cpu );
+  gc->stat_total_entries_remset_scan += env->remset_scanned;
+  gc->stat_total_remset_scan += elapsed;
+  gc->stat_total_remset_scan_cpu += cpu;
+  gc->stat_remset_scan_count++;
+}
+
+bool par_oldspace_copy( gc_t *gc, semispace_t *tospace, gset_t forw_gset )
+{
+  par_env_t env;
+  int i, words = 0;
+
+  if (gc->workers == 0 || gc_workers_count( gc->workers ) < 2)
+    return FALSE;
+  if (gc->scan_update_remset || gc->smircy != NULL || gc->np_remset != -1)
+    return FALSE;
+
+  memset( &env, 0, sizeof( par_env_t ) );
+  env.gc = gc;
+  env.pool = gc->workers;
+  env.tospace = tospace;
+  env.forw_gset = forw_gset;
+  env.tgt_gen = tospace->gen_no;
+  env.iflush = gc_iflush( gc );
+  env.nworkers = gc_workers_count( gc->workers );
+  env.workers =
+    (par_worker_t*)must_malloc( sizeof( par_worker_t )*env.nworkers );
+  for ( i=0 ; i < env.nworkers ; i++ ) {
+    env.workers[i].env = &env;
+    env.workers[i].chunk = -1;
+    env.workers[i].dest = env.workers[i].lim = env.workers[i].grey = 0;
+    env.workers[i].words_forwarded_from_nursery = 0;
+  }
+  env.workers[0].chunk = tospace->current;
+  env.workers[0].dest = env.workers[0].grey
+    = tospace->chunks[ tospace->current ].top;
+  env.workers[0].lim = tospace->chunks[ tospace->current ].lim;
+
+  gc_enumerate_smircy_roots( gc, record_root, (void*)&env );
+  gc_enumerate_roots( gc, record_root, (void*)&env );
+  enumerate_remsets( &env );
+
+  gc_workers_run( env.pool, par_copy_worker, (void*)&env );
+
+  assert( env.work_len == 0 );
+  for ( i=0 ; i < env.nworkers ; i++ )
+    words += env.workers[i].words_forwarded_from_nursery;
+  gc->words_from_nursery_last_gc = words;
+
+  free( env.workers );
+  if (env.roots) free( env.roots );
+  if (env.remset) free( env.remset );
+  if (env.work) free( env.work );
+  return TRUE;
+}
+
+/* eof */
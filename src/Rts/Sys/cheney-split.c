@@ -33,7 +33,19 @@
    the Boehm collector by allowing the creation of a clean split heap.
 
    A splitting gc uses two destination semispaces: one for pointer data
-   (ss_data) and one for non-pointer data (ss_text).
+   (ss_data) and one for non-pointer data (ss_text).  The non-pointer
+   data are further grouped into subareas so that the code vectors end
+   up together, apart from the strings (symbol names among them) and
+   the numbers and other bytevectors.  Only the code vectors go to
+   ss_text itself; the others are copied out of line by
+   forward_to_subarea(), as the subareas are never scanned.
+
+   A code vector has the same header as any other bytevector, and is
+   known only by being in the code slot of a procedure.  So a plain
+   bytevector reached from any other slot is not copied at once: the
+   slot is deferred, and the bytevector goes to ss_other at the end of
+   the collection unless a procedure has reached it by then.  This is
+   safe because bytevectors hold no pointers.
 
    Forw_oflo2() is like forw_oflo(); forw_core2() is like forw_core().
    The same scanning macros are used for this type of collection as
@@ -71,6 +83,13 @@
   else if (tagof( T_obj ) == PAIR_TAG) {                                \
     FORW_PAIR( TMP_P, loc, dest, lim, e, forw_limit_gen);               \
   }                                                                     \
+  else if (tagof( T_obj ) == BVEC_TAG &&                                \
+           typetag( *TMP_P ) != BVEC_SUBTAG) {                          \
+    *loc = forward_to_subarea( T_obj, e );                              \
+  }                                                                     \
+  else if (tagof( T_obj ) == BVEC_TAG && loc != code_slot) {            \
+    defer_slot( loc );                                                  \
+  }                                                                     \
   else if (tagof( T_obj ) == BVEC_TAG) {                                \
     word *TMPD;                                                         \
     check_space2(dest2,lim2,sizefield(*TMP_P)+4,e->tospace2); /*text*/  \
@@ -96,6 +115,49 @@
 extern void mem_icache_flush( void *start, void *end );
 
 static void scan_oflo_splitting( cheney_env_t *e );
+static word forward_to_subarea( word obj, cheney_env_t *e );
+
+/* Text subareas other than the code, for the current splitting gc */
+static semispace_t *ss_strings;
+static semispace_t *ss_other;
+
+/* The code slot of the procedure being scanned, or 0 */
+static word *code_slot;
+
+/* Slots that refer to plain bytevectors not yet copied */
+static word **deferred;
+static int ndeferred;
+static int deferred_size;
+
+static void defer_slot( word *loc )
+{
+  if (ndeferred == deferred_size) {
+    deferred_size = max( 2*deferred_size, 1024 );
+    deferred = (word**)
+      must_realloc( deferred, sizeof( word* )*deferred_size );
+  }
+  deferred[ ndeferred++ ] = loc;
+}
+
+/* Copies the plain bytevectors that no procedure reached to ss_other,
+   and updates the deferred slots. */
+static void forward_deferred( cheney_env_t *e )
+{
+  word *loc, *p;
+  int i;
+
+  for ( i=0 ; i < ndeferred ; i++ ) {
+    loc = deferred[i];
+    p = ptrof( *loc );
+    if (*p == FORWARD_HDR)
+      *loc = *(p+1);
+    else
+      *loc = forward_to_subarea( *loc, e );
+  }
+  free( deferred );
+  deferred = 0;
+  ndeferred = deferred_size = 0;
+}
 
 static void
 expand_semispace( semispace_t *ss, word **lim, word **dest, unsigned bytes )
@@ -106,14 +168,40 @@ expand_semispace( semispace_t *ss, word **lim, word **dest, unsigned bytes )
   *dest = ss->chunks[ss->current].top;
 }
 
-void gclib_stopcopy_split_heap( gc_t *gc, semispace_t *data, semispace_t *text)
+/* Copies a string, number, or other non-code bytevector-like object
+   to the end of its subarea and returns the new pointer. */
+static word forward_to_subarea( word obj, cheney_env_t *e )
+{
+  word *p = ptrof( obj );
+  word tt = typetag( *p );
+  semispace_t *ss;
+  word *dest, *lim;
+
+  ss = ((tt == STR_SUBTAG || tt == USTR_SUBTAG) ? ss_strings : ss_other);
+  dest = ss->chunks[ss->current].top;
+  lim = ss->chunks[ss->current].lim;
+  /* forward() may pad to keep the bytevector 16-byte aligned. */
+  check_space2( dest, lim, roundup8( sizefield( *p )+4 )+8, ss );
+  obj = forward( obj, &dest, e );
+  ss->chunks[ss->current].top = dest;
+  return obj;
+}
+
+void gclib_stopcopy_split_heap( gc_t *gc, semispace_t *data, 
+                                semispace_t *code, semispace_t *strings,
+                                semispace_t *other )
 {
   cheney_env_t e;
 
-  init_env( &e, gc, &data, 1, 1, text, gset_younger_than( data->gen_no+1 ), 
+  ss_strings = strings;
+  ss_other = other;
+  init_env( &e, gc, &data, 1, 1, code, gset_younger_than( data->gen_no+1 ), 
             SPLITTING_GC, scan_oflo_splitting );
   oldspace_copy( &e );
+  forward_deferred( &e );
   /* Note: No LOS sweeping */
+  ss_strings = ss_other = 0;
+  code_slot = 0;
 }
 
 static void scan_oflo_splitting( cheney_env_t *e )
@@ -128,6 +216,10 @@ static void scan_oflo_splitting( cheney_env_t *e )
 
   while (scanptr != dest) {
     while (scanptr != dest && scanptr < scanlim) {
+      if (ishdr( *scanptr ) && header( *scanptr ) == header( PROC_HDR ))
+        code_slot = scanptr + PROC_HEADER_WORDS + IDX_PROC_CODE;
+      else
+        code_slot = 0;
       scan_core( e, scanptr, e->iflush,
                  forw_oflo2( scanptr, forw_gset, dest, dest2,
                              copylim, copylim2, e ) );
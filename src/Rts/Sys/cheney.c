@@ -8,6 +8,10 @@
  * artifacts from supporting those extensions remain as idiosyncrasies
  * in the code in this file.
  * 
+ * When the collector has a pool of worker threads, the copying phase
+ * of gclib_stopcopy_promote_into and gclib_stopcopy_collect may be
+ * performed in parallel; see cheney-par.c.
+ * 
  * Entry points (from outside cheney-* files):
  *   gclib_stopcopy_promote_into 
  *   gclib_stopcopy_collect 
@@ -206,6 +210,57 @@ static word install_fwdptr( word *addr, word *newaddr, word tag ) {
                              dest, lim, e, check_spaceI ),                    \
                   update_remset )
 
+/* Prefetching scan; see scan_oflo_prefetch().  PREFETCH_DEPTH must be
+   a power of 2. */
+
+#define PREFETCH_DEPTH 8
+
+#if defined(__GNUC__)
+# define prefetch_for_write( p )  __builtin_prefetch( (p), 1, 3 )
+#else
+# define prefetch_for_write( p )  ((void)0)
+#endif
+
+/* Queues loc if it must be forwarded, and forwards the location queued
+   PREFETCH_DEPTH locations ago.  */
+#define pf_enqueue( loc, q, q_idx, q_len, fwdgens, fwdgens_data,              \
+                    dest, lim, e, check_spaceI )                              \
+  do { word T_obj = *loc;                                                     \
+       if (isptr(T_obj) && fwdgens( gen_of(T_obj), (fwdgens_data))) {         \
+         word *T_old = q[q_idx];                                              \
+         prefetch_for_write( ptrof( T_obj ) );                                \
+         q[q_idx] = loc;                                                      \
+         q_idx = (q_idx+1) & (PREFETCH_DEPTH-1);                              \
+         if (T_old != 0) {                                                    \
+           pf_forward( T_old, dest, lim, e, check_spaceI );                   \
+         } else                                                               \
+           q_len++;                                                           \
+       }                                                                      \
+  } while( 0 )
+
+/* Forwards every queued location, oldest first. */
+#define pf_drain( q, q_idx, q_len, dest, lim, e, check_spaceI )               \
+  do { int T_i;                                                               \
+       for ( T_i = 0 ; T_i < PREFETCH_DEPTH ; T_i++ ) {                       \
+         word *T_old = q[q_idx];                                              \
+         q[q_idx] = 0;                                                        \
+         q_idx = (q_idx+1) & (PREFETCH_DEPTH-1);                              \
+         if (T_old != 0) {                                                    \
+           pf_forward( T_old, dest, lim, e, check_spaceI );                   \
+         }                                                                    \
+       }                                                                      \
+       q_len = 0;                                                             \
+  } while( 0 )
+
+/* The location was checked when it was queued, and nothing else writes
+   it before it is forwarded, but its referent may have been forwarded
+   through another location in the meantime; forw_core handles that. */
+#define pf_forward( loc, dest, lim, e, check_spaceI )                         \
+  do { word *T_loc = loc;                                                     \
+       word T_obj2 = *T_loc;                                                  \
+       forw_core( T_obj2, T_loc, dest, lim, e, check_spaceI );                \
+  } while( 0 )
+
 /* External */
 
 extern void mem_icache_flush( void *start, void *end );
@@ -225,6 +280,16 @@ static bool forward_nursery_and( int gno, gset_t gset ) {
   return gno == 0 || gset_memberp( gno, gset ); }
 static const int tospaces_init_buf_size = 10;
 
+static void (*tospace_scanner( gc_t *gc ))( cheney_env_t * )
+{
+  if (gc->scan_update_remset)
+    return scan_oflo_normal_update_rs;
+  else if (gc->scan_prefetch)
+    return scan_oflo_prefetch;
+  else
+    return scan_oflo_normal;
+}
+
 static void 
 init_env_with_cursors( cheney_env_t *e, 
                        gc_t *gc,
@@ -315,7 +380,7 @@ void gclib_stopcopy_collect_genset( gc_t *gc, gset_t gs, semispace_t *tospace )
   init_env_with_cursors
     ( &e, gc, spaces, 1, init_size, cursors, 
       0, gs, 0, 
-      gc->scan_update_remset ? scan_oflo_normal_update_rs : scan_oflo_normal );
+      tospace_scanner( gc ) );
   oldspace_copy( &e );
   sweep_large_objects_in( gc, gs );
   stats_set_gc_event_stats( &cheney );
@@ -343,7 +408,7 @@ void gclib_stopcopy_collect_locs( gc_t *gc, gset_t gs, semispace_t *tospace )
   init_env_with_cursors
     ( &e, gc, spaces, 1, init_size, cursors, 
       0, gs, POINTS_ACROSS_FCN, 
-      gc->scan_update_remset ? scan_oflo_normal_update_rs : scan_oflo_normal );
+      tospace_scanner( gc ) );
   oldspace_copy_using_locations( &e );
   sweep_large_objects_in( gc, gs );
   stats_set_gc_event_stats( &cheney );
@@ -359,6 +424,11 @@ void gclib_stopcopy_promote_into( gc_t *gc, semispace_t *tospace )
   semispace_cursor_t *cursors; 
   int init_size = tospaces_init_buf_size;
   
+  if (par_oldspace_copy( gc, tospace, gset_younger_than( tospace->gen_no ) )) {
+    sweep_large_objects( gc, tospace->gen_no-1, tospace->gen_no, -1 );
+    return;
+  }
+
   spaces = begin_semispaces_buffer( init_size );
   cursors = begin_semispace_cursors( init_size );
   spaces[0] = tospace;
@@ -369,7 +439,7 @@ void gclib_stopcopy_promote_into( gc_t *gc, semispace_t *tospace )
   init_env_with_cursors
     ( &e, gc, spaces, 1, init_size, cursors, 
       0, gset_younger_than( tospace->gen_no ), 0, 
-      gc->scan_update_remset ? scan_oflo_normal_update_rs : scan_oflo_normal );
+      tospace_scanner( gc ) );
   oldspace_copy( &e );
   sweep_large_objects( gc, tospace->gen_no-1, tospace->gen_no, -1 );
   stats_set_gc_event_stats( &cheney );
@@ -385,6 +455,11 @@ void gclib_stopcopy_collect( gc_t *gc, semispace_t *tospace )
   semispace_cursor_t *cursors;
   int init_size = tospaces_init_buf_size;
 
+  if (par_oldspace_copy( gc, tospace, gset_younger_than( tospace->gen_no+1 ) )) {
+    sweep_large_objects( gc, tospace->gen_no, tospace->gen_no, -1 );
+    return;
+  }
+
   spaces = begin_semispaces_buffer( init_size );
   cursors = begin_semispace_cursors( init_size );
   spaces[0] = tospace;
@@ -395,7 +470,7 @@ void gclib_stopcopy_collect( gc_t *gc, semispace_t *tospace )
   init_env_with_cursors
     ( &e, gc, spaces, 1, init_size, cursors, 
       0, gset_younger_than( tospace->gen_no+1 ), 0, 
-      gc->scan_update_remset ? scan_oflo_normal_update_rs : scan_oflo_normal );
+      tospace_scanner( gc ) );
   oldspace_copy( &e );
   sweep_large_objects( gc, tospace->gen_no, tospace->gen_no, -1 );
   stats_set_gc_event_stats( &cheney );
@@ -421,7 +496,7 @@ void gclib_stopcopy_collect_and_scan_static( gc_t *gc, semispace_t *tospace )
   init_env_with_cursors
     ( &e, gc, spaces, 1, init_size, cursors, 
       0, gset_younger_than( tospace->gen_no+1 ), SCAN_STATIC, 
-      gc->scan_update_remset ? scan_oflo_normal_update_rs : scan_oflo_normal );
+      tospace_scanner( gc ) );
   oldspace_copy( &e );
   sweep_large_objects( gc, tospace->gen_no, tospace->gen_no, -1 );
   stats_set_gc_event_stats( &cheney );
@@ -432,11 +507,16 @@ void gclib_stopcopy_collect_and_scan_static( gc_t *gc, semispace_t *tospace )
 
 void sweep_large_objects_in( gc_t *gc, gset_t genset )
 {
-  int i;
+  int i, n;
+  int *gen_nos;
 
+  gen_nos = (int*)must_malloc( sizeof( int )*(gset_max_elem( genset )+1) );
+  n = 0;
   for ( i=0; i <= gset_max_elem( genset ); i++ )
     if (gset_memberp( i, genset ))
-      los_sweep( gc->los, i );
+      gen_nos[n++] = i;
+  los_sweep_gens( gc->los, gen_nos, n, gc->workers );
+  free( gen_nos );
   los_append_and_clear_list_infer_gen( gc->los, gc->los->mark1 );
 }
 
@@ -446,9 +526,13 @@ void sweep_large_objects( gc_t *gc,
                           int dest2 )
 {
   int i;
+  int *gen_nos;
 
+  gen_nos = (int*)must_malloc( sizeof( int )*max( sweep_oldest+1, 1 ) );
   for ( i=0 ; i <= sweep_oldest ; i++ )
-    los_sweep( gc->los, i );
+    gen_nos[i] = i;
+  los_sweep_gens( gc->los, gen_nos, sweep_oldest+1, gc->workers );
+  free( gen_nos );
   los_append_and_clear_list( gc->los, gc->los->mark1, dest );
   if (dest2 >= 0) los_append_and_clear_list( gc->los, gc->los->mark2, dest2 );
 }
@@ -514,7 +598,9 @@ init_env_with_cursors( cheney_env_t *e,
 {
   memset( e, 0, sizeof( cheney_env_t ) );
   e->gc = gc;
+#if !GCLIB_SPARSE_TABLE
   e->gclib_desc_g = gclib_desc_g;
+#endif
   e->forw_gset = forw_gset;
   e->scan_static = attributes & SCAN_STATIC;
   e->splitting = attributes & SPLITTING_GC;
@@ -949,6 +1035,90 @@ void scan_oflo_normal_update_rs( cheney_env_t *e )
   e->lim = copylim;
 }
 
+/* Like scan_oflo_normal, but instead of forwarding a location as soon
+ * as it is scanned, queues it and prefetches the header of its referent,
+ * which forward() will read and overwrite with a forwarding pointer a
+ * few locations later.  Copying linked structures is otherwise dominated
+ * by the cache miss on each referent.
+ *
+ * The order in which objects are copied is unchanged, so the result is
+ * the same breadth-first layout.  The queue must be empty before the
+ * scan can be declared finished, since forwarding a queued location may
+ * copy more objects.
+ *
+ * Not for collectors that update remembered sets during the scan: that
+ * needs the forwarded value of each location as soon as it is scanned.
+ */
+
+void scan_oflo_prefetch( cheney_env_t *e )
+{
+  gset_t   forw_gset = e->forw_gset;
+  word     *scanptr = e->scan_ptr;
+  word     *scanlim = e->scan_lim;
+  word     *dest = e->dest;
+  word     *copylim = e->lim;
+  word     *los_p = 0, *p;
+  word     *q[PREFETCH_DEPTH];  /* Locations to forward, a ring */
+  int      q_idx = 0;           /* Oldest location, and next free slot */
+  int      q_len = 0;           /* Number of locations in q */
+  int      morework;
+#if GCLIB_LARGE_TABLE && SHADOW_TABLE
+  gclib_desc_t *gclib_desc_g = e->gclib_desc_g;
+#endif
+
+  assert( !e->gc->scan_update_remset );
+  memset( q, 0, sizeof( q ) );
+
+  do {
+    morework = 0;
+
+    while (scanptr != dest || q_len > 0) {
+      while (scanptr != dest && scanptr < scanlim) {
+        scan_core( e, scanptr, e->iflush,
+                   pf_enqueue( scanptr, q, q_idx, q_len,
+                               forward_nursery_and, forw_gset,
+                               dest, copylim, e, check_space_expand ) );
+      }
+
+      if (scanptr == dest) {
+        pf_drain( q, q_idx, q_len, dest, copylim, e, check_space_expand );
+      }
+      else {
+        e->scan_idx++;
+        if (e->scan_idx > tospace_scan(e)->current) {
+          e->tospaces_cur_scan++;
+          assert(e->tospaces_cur_scan < e->tospaces_len);
+          e->scan_idx = e->cursors[ e->tospaces_cur_scan ].chunks_index;
+          scanptr     = e->cursors[ e->tospaces_cur_scan ].chunk_ptr;
+          scanlim = tospace_scan(e)->chunks[e->scan_idx].lim;
+        } else {
+          scanptr = tospace_scan(e)->chunks[e->scan_idx].bot;
+          scanlim = tospace_scan(e)->chunks[e->scan_idx].lim;
+        }
+        
+        /* See scan_oflo_normal. */
+        if (dest == copylim) {
+          dest = copylim = 0;
+        }
+      }
+    }
+
+    while ((p = los_walk_list( e->los->mark1, los_p )) != 0) {
+      los_p = p;
+      morework = 1;
+      assert2( ishdr( *p ) );
+      scan_core( e, p, e->iflush,
+                 pf_enqueue( p, q, q_idx, q_len,
+                             forward_nursery_and, forw_gset,
+                             dest, copylim, e, check_space_expand ) );
+    }
+    pf_drain( q, q_idx, q_len, dest, copylim, e, check_space_expand );
+  } while (morework);
+
+  e->dest = dest;
+  e->lim = copylim;
+}
+
 /* For whatever reason, we were flushing the cache on bytevectors
  * found in the from space.  This flushes the cache on bytevectors
  * after they've been copied to the new space.
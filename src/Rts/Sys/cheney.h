@@ -207,6 +207,14 @@ static void stop( void )
 # define COUNT_REMSET_LARGE_OBJ(x) (void)0
 #endif
 
+/* Clears the pad word at ptr and advances past it.  The word is written
+ * only if it is not zero already, so that scanning the static area does
+ * not dirty pages that are shared copy-on-write with other processes
+ * (see -prefork).
+ */
+#define skip_pad( ptr )                                                       \
+  do { if (*(ptr) != 0) *(ptr) = 0; (ptr)++; } while (0)
+
 /* ptr is scan-pointer for Cheney algorithm (often named loc in this file).
  * FORW is a command that, when appropriate, will copy **ptr into
  * to-space and update *ptr.
@@ -225,7 +233,7 @@ static void stop( void )
         word *T_oldptr = ptr;                                                 \
         word T_bytes = roundup4( sizefield( T_w ) );                          \
         ptr = (word *)((word)ptr + (T_bytes + 4)); /* doesn't skip padding */ \
-        if (!(T_bytes & 4)) *ptr++ = 0;             /* pad. */                \
+        if (!(T_bytes & 4)) skip_pad( ptr );     /* pad. */                   \
         /* Only code vectors typically use a plain bytevector typetag,        \
          * so almost any bytevector will be a code vector that must           \
          * be flushed.                                                        \
@@ -241,7 +249,7 @@ static void stop( void )
           FORW;                                                               \
           ptr++;                                                              \
         }                                                                     \
-        if (!(sizefield( T_w ) & 4)) *ptr++ = 0; /* pad. */                   \
+        if (!(sizefield( T_w ) & 4)) skip_pad( ptr ); /* pad. */              \
       }                                                                       \
     }                                                                         \
     else {                                                                    \
@@ -265,7 +273,7 @@ static void stop( void )
         word *T_oldptr = ptr;                                                 \
         word T_bytes = roundup4( sizefield( T_w ) );                          \
         ptr = (word *)((word)ptr + (T_bytes + 4)); /* doesn't skip padding */ \
-        if (!(T_bytes & 4)) *ptr++ = 0;             /* pad. */                \
+        if (!(T_bytes & 4)) skip_pad( ptr );     /* pad. */                   \
         /* Only code vectors typically use a plain bytevector typetag,        \
          * so almost any bytevector will be a code vector that must           \
          * be flushed.                                                        \
@@ -293,7 +301,7 @@ static void stop( void )
           FORW;                                                               \
           ptr++;                                                              \
         }                                                                     \
-        if (!(sizefield( T_w ) & 4)) *ptr++ = 0; /* pad. */                   \
+        if (!(sizefield( T_w ) & 4)) skip_pad( ptr ); /* pad. */              \
       }                                                                       \
     }                                                                         \
     else {                                                                    \
@@ -370,11 +378,16 @@ no_update_remset( cheney_env_t *e, word origin_ptr, int g_lhs, int pair_tag, wor
 /* private procedures shared among cheney*.c */
 void scan_oflo_normal( cheney_env_t *e );
 void scan_oflo_normal_update_rs( cheney_env_t *e );
+void scan_oflo_prefetch( cheney_env_t *e );
 word forward(const word, word **, cheney_env_t *e );
 void oldspace_copy( cheney_env_t *e );
 void seal_chunk( semispace_t *ss, word *lim, word *dest );
 void sweep_large_objects( gc_t *gc, int sweep_oldest, int g1, int g2 );
 void expand_space( cheney_env_t *, word **, word **, unsigned );
+void copied_icache_flush( word *bv );
+bool par_oldspace_copy( gc_t *gc, semispace_t *tospace, gset_t forw_gset );
+  /* Parallel copying phase (cheney-par.c); returns FALSE, having done
+     nothing, if the collection must be performed serially. */
 void init_env( cheney_env_t *e, gc_t *gc,
 	       semispace_t **tospaces, int tospaces_len, int tospaces_cap,
                semispace_t *tospace2,
@@ -22,6 +22,7 @@
 #include "gc_t.h"
 #include "gclib.h"
 #include "extbmp_t.h"
+#include "bitmap.h"
 
 #if defined(BITS_32)
 # define BIT_IDX_SHIFT       3  /* shift to get doubleword bit address */
@@ -30,6 +31,14 @@
 # define BITS_IN_WORD       32
 /* This upper bounds distinct entries in bitmap. */
 # define SHIFTED_ADDRESS_SPACE 536870912 /* 2^32 >> 3 */
+#elif defined(BITS_64)
+# define BIT_IDX_SHIFT       4  /* shift to get doubleword bit address */
+# define BIT_IDX_TO_WORDADDR 6  /* shift to get word addr from bit addr */
+# define BIT_IN_WORD_MASK   63  /* mask to get bit shift */
+# define BITS_IN_WORD       64
+/* This upper bounds distinct entries in bitmap; the user part of the
+   address space is 48 bits. */
+# define SHIFTED_ADDRESS_SPACE 17592186044416LL /* 2^48 >> 4 */
 #else
 # error "Must define EXTBMP macros for non-32 bit systems."
 #endif
@@ -277,12 +286,7 @@ static void free_tnode( extbmp_t *ebmp, tnode_t *t,
 }
 
 static void init_leaf_fields_cleared( extbmp_t *ebmp, leaf_t *l ) {
-  int i;
-  int bmp_words = ebmp->leaf_words;
-  word *bmp = l->bitmap;
-  for (i = 0; i < bmp_words; i++) {
-    bmp[i] = 0;
-  }
+  bitmap_clear( l->bitmap, 0, ebmp->leaf_words*BITS_IN_WORD );
   l->gno = -2;
   l->prev_for_gno = NULL;
   l->next_for_gno = NULL;
@@ -393,7 +397,7 @@ extbmp_t *create_extensible_bitmap_params( gc_t *gc, gc_param_t *info,
   /* Creates bitmap representing empty set of addresses */
   extbmp_t *ebmp;
   int depth;
-  int max_leaves;
+  long long max_leaves;
   int leaf_words = CEILDIV(leaf_bytes, sizeof(word));
   long long address_range_in_words;
 
@@ -437,7 +441,7 @@ extbmp_t *create_extensible_bitmap_params( gc_t *gc, gc_param_t *info,
   }
   ebmp->leaf_count = 0;
 
-  annoyingmsg( "ebmp{gc,leaf_words=%d,entries_per_inode=%d,depth=%d,tree} max_leaves:%d",
+  annoyingmsg( "ebmp{gc,leaf_words=%d,entries_per_inode=%d,depth=%d,tree} max_leaves:%lld",
                ebmp->leaf_words, ebmp->entries_per_inode, ebmp->depth, max_leaves );
   return ebmp;
 }
@@ -756,20 +760,102 @@ void extbmp_clear_members_in( extbmp_t *ebmp, int gno )
   extbmp_enumerate_in( ebmp, FALSE, gno, scan_clear_always, NULL );
 }
 
-static bool scan_accum_count( word loc, void *data )
+/* Returns cardinality(tree & [s,l)).  Addresses are carried as long
+ * long because the children of the root can reach past 2^32. */
+static int tnode_count_in( extbmp_t *ebmp, tnode_t *tree, int depth,
+                           long long first_addr_for_node, 
+                           long long s, long long l )
+{
+  if (depth == 0) {
+    long long lim, lo, hi;
+    lim = first_addr_for_node + (ADDRS_PER_WORD*sizeof(word))*ebmp->leaf_words;
+    lo = (s > first_addr_for_node) ? s : first_addr_for_node;
+    hi = (l < lim) ? l : lim;
+    if (lo >= hi)
+      return 0;
+    return bitmap_popcount( tree->leaf.bitmap, 
+                            (int)((lo - first_addr_for_node) >> BIT_IDX_SHIFT),
+                            (int)((hi - first_addr_for_node 
+                                   + MIN_BYTES_PER_OBJECT - 1) 
+                                  >> BIT_IDX_SHIFT) );
+  } else {
+    inode_t *inode = &tree->inode;
+    long long span = inode->address_words_per_child*sizeof(word);
+    long long child;
+    int i, count;
+
+    count = 0;
+    for ( i = 0; i < ebmp->entries_per_inode; i++ ) {
+      child = first_addr_for_node + i*span;
+      if (child >= l)
+        break;
+      if (inode->nodes[i] != NULL && child + span > s)
+        count += tnode_count_in( ebmp, inode->nodes[i], depth-1, child, s, l );
+    }
+    return count;
+  }
+}
+
+struct count_in_range_data {
+  extbmp_t *ebmp;
+  int count;
+};
+static void count_in_range( word *s, word *l, void *d )
 {
-  int *accum = (int*)data;
-  *accum += 1;
-  return TRUE;
+  struct count_in_range_data *data = (struct count_in_range_data*)d;
+  data->count += tnode_count_in( data->ebmp, data->ebmp->tree, 
+                                 data->ebmp->depth, 0, 
+                                 (long long)(word)s, (long long)(word)l );
 }
 
 int  extbmp_count_members_in( extbmp_t *ebmp, int gno )
 { /* cardinality(ebmp & addresses(gno)) */
-  int accum;
-  /* stupid simple but slow impl */
-  accum = 0;
-  extbmp_enumerate_in( ebmp, FALSE, gno, scan_accum_count, &accum );
-  return accum;
+  struct count_in_range_data data;
+  data.ebmp = ebmp;
+  data.count = 0;
+  gc_enumerate_hdr_address_ranges( ebmp->gc, gno, count_in_range, &data );
+  return data.count;
+}
+
+/* dest := dest U tree, where tree is a subtree of another bitmap with
+ * the same shape as dest. */
+static void tnode_union( extbmp_t *dest, tnode_t *tree, int depth, 
+                         word first_addr_for_node )
+{
+  if (depth == 0) {
+    leaf_t *from = &tree->leaf;
+    leaf_t *to;
+    word first;
+
+    if (from->gno < 0)          /* never had a member */
+      return;
+    find_or_alloc_leaf( dest, first_addr_for_node, &to, &first );
+    assert( first == first_addr_for_node );
+    bitmap_union( to->bitmap, from->bitmap, dest->leaf_words );
+    if (to->gno < 0) {
+      insert_leaf_in_list( dest, to, from->gno );
+    } else if (to->gno != 0 && to->gno != from->gno) {
+      move_leaf_to_mixed_list( dest, to, from->gno );
+    }
+  } else {
+    inode_t *inode = &tree->inode;
+    int i;
+
+    for ( i = 0; i < dest->entries_per_inode; i++ ) {
+      if (inode->nodes[i] != NULL)
+        tnode_union( dest, inode->nodes[i], depth-1, 
+                     (word)(((word*)first_addr_for_node) + 
+                            i * inode->address_words_per_child) );
+    }
+  }
+}
+
+void extbmp_union( extbmp_t *dest, extbmp_t *src )
+{ /* dest := dest U src */
+  assert( dest->leaf_words == src->leaf_words );
+  assert( dest->entries_per_inode == src->entries_per_inode );
+  assert( dest->depth == src->depth );
+  tnode_union( dest, src->tree, src->depth, 0 );
 }
 
 /* Returns TRUE implies entire leaf post-enumeration is clear[ed] (ie all zero bits). 
@@ -791,8 +877,8 @@ static bool tnode_enum_leaf( extbmp_t *ebmp,
 {
   word *bitmap;
   int leaf_words, leaf_word_limit;
-  int word_idx, j, bit_in_word;
-  word curr_bmp_word, obj;
+  int word_idx, j, bit_in_word, bit, bit_limit;
+  word obj;
   bool scan_retval;
   bool found_nonzero_word;
   word limit_addr_for_leaf;
@@ -860,99 +946,75 @@ static bool tnode_enum_leaf( extbmp_t *ebmp,
   }
   assert( leaf_word_limit >= 0 && leaf_word_limit <= leaf_words );
 
-  for (; word_idx < leaf_word_limit; word_idx += 1) {
-    curr_bmp_word = bitmap[ word_idx ];
-    if (curr_bmp_word == 0) {
-      continue;
-    } else {
-      word curr_bmp_word_orig = curr_bmp_word;
-
-      if (ignore_gno) {
-        dbmsg(     "tnode_enum_leaf"
-                   " first_addr_for_leaf:0x%08x word_idx:%4d word:%8x       "
-                   " enum:[0x%08x,0x%08x)", 
-                   first_addr_for_leaf, word_idx, curr_bmp_word, 
-                   first_enum_addr, limit_enum_addr );
-      } else {
+  bit_limit = leaf_word_limit*BITS_IN_WORD;
+  for ( bit = bitmap_next_set( bitmap, word_idx*BITS_IN_WORD, bit_limit );
+        bit < bit_limit;
+        bit = bitmap_next_set( bitmap, bit+1, bit_limit )) {
+    word_idx = bit >> BIT_IDX_TO_WORDADDR;
+    j = bit & BIT_IN_WORD_MASK;
+    bit_in_word = (1 << j);
+    obj = first_addr_for_leaf + (bit << BIT_IDX_SHIFT);
+    assert( tagof(obj) == 0 );
+    if (! ignore_gno) {
+      word obj2 = tagptr( obj, PAIR_TAG );
+
+      if ((gno_is_static_area && (gen_of(obj2) != ebmp->gc->gno_count-1))
+          ||
+          ((! gno_is_static_area) && (gen_of(obj2) != gno))) {
         dbmsg(     "tnode_enum_leaf"
-                   " first_addr_for_leaf:0x%08x word_idx:%4d word:%8x gno:%d"
-                   " enum:[0x%08x,0x%08x)",
-                   first_addr_for_leaf, word_idx, curr_bmp_word, gno, 
-                   first_enum_addr, limit_enum_addr );
+                   " first_addr_for_leaf:0x%08x word_idx:%d j:%2d"
+                   " SKIP 0x%08x (%d) looking for gno=%d", 
+                   first_addr_for_leaf, word_idx, j, 
+                   obj, gen_of(obj2), gno );
+        /* can probably do a bit better even without changing to
+         * iteration-over-region-address-ranges -- the whole
+         * page of an address belongs to the same gno */
+        /* If I do that then I will have to revisit how I am
+         * handling leaf clearing (see found_nonzero_word); but
+         * that will probably be necessary anyway. */
+        found_nonzero_word = TRUE;
+        continue;
       }
+    }
 
-      for (j = 0; j < BITS_IN_WORD; j += 1) {
-        bit_in_word = (1 << j);
-        if (curr_bmp_word & bit_in_word) {
-          obj = (first_addr_for_leaf 
-                 + ((word_idx*BITS_IN_WORD + j) << BIT_IDX_SHIFT));
-          assert( tagof(obj) == 0 );
-          if (! ignore_gno) {
-            word obj2 = tagptr( obj, PAIR_TAG );
-
-            if ((gno_is_static_area && (gen_of(obj2) != ebmp->gc->gno_count-1))
-                ||
-                ((! gno_is_static_area) && (gen_of(obj2) != gno))) {
-              dbmsg(     "tnode_enum_leaf"
-                         " first_addr_for_leaf:0x%08x word_idx:%d j:%2d"
-                         " SKIP 0x%08x (%d) looking for gno=%d", 
-                         first_addr_for_leaf, word_idx, j, 
-                         obj, gen_of(obj2), gno );
-              /* can probably do a bit better even without changing to
-               * iteration-over-region-address-ranges -- the whole
-               * page of an address belongs to the same gno */
-              /* If I do that then I will have to revisit how I am
-               * handling leaf clearing (see found_nonzero_word); but
-               * that will probably be necessary anyway. */
-              continue;
-            }
-          }
-
-          if (need_tagged_ptr) {
-            word w = *ptrof(obj);
+    if (need_tagged_ptr) {
+      word w = *ptrof(obj);
 
 #if 0
-          consolemsg("tnode_enum_leaf"
-                     " first_addr_for_leaf:0x%08x word_idx:%4d j:%d"
-                     " obj:0x%08x (%d) mhdr:0x%08x", 
-                     first_addr_for_leaf, word_idx, j, 
-                     obj, gen_of(obj), w );
+      consolemsg("tnode_enum_leaf"
+                 " first_addr_for_leaf:0x%08x word_idx:%4d j:%d"
+                 " obj:0x%08x (%d) mhdr:0x%08x", 
+                 first_addr_for_leaf, word_idx, j, 
+                 obj, gen_of(obj), w );
 #endif
 
-            if ( ! ishdr(w) ) {
-              obj = tagptr( obj, PAIR_TAG );
-            } else if ( header(w) == BV_HDR ) {
-              obj = tagptr( obj, BVEC_TAG );
-            } else if ( header(w) == VEC_HDR ) {
-              obj = tagptr( obj, VEC_TAG );
-            } else {
-              /* Felix cannot assert this and thinks he knew why once
-               * but no longer remembers.
-               * assert( header(w) == PROC_HDR ); */
-              obj = tagptr( obj, PROC_TAG );
-            }
-          }
+      if ( ! ishdr(w) ) {
+        obj = tagptr( obj, PAIR_TAG );
+      } else if ( header(w) == BV_HDR ) {
+        obj = tagptr( obj, BVEC_TAG );
+      } else if ( header(w) == VEC_HDR ) {
+        obj = tagptr( obj, VEC_TAG );
+      } else {
+        /* Felix cannot assert this and thinks he knew why once
+         * but no longer remembers.
+         * assert( header(w) == PROC_HDR ); */
+        obj = tagptr( obj, PROC_TAG );
+      }
+    }
 
 #if 0
-          consolemsg("tnode_enum_leaf"
-                     " first_addr_for_leaf:0x%08x word_idx:%4d j:%d"
-                     " obj:0x%08x (%d)", 
-                     first_addr_for_leaf, word_idx, j, 
-                     obj, gen_of(obj) );
+    consolemsg("tnode_enum_leaf"
+               " first_addr_for_leaf:0x%08x word_idx:%4d j:%d"
+               " obj:0x%08x (%d)", 
+               first_addr_for_leaf, word_idx, j, 
+               obj, gen_of(obj) );
 #endif
 
-          scan_retval = scanner( obj, data );
-          if (! scan_retval)
-            curr_bmp_word = curr_bmp_word & ~(bit_in_word);
-        }
-      }
-      if (curr_bmp_word != curr_bmp_word_orig) {
-        bitmap[ word_idx ] = curr_bmp_word;
-      }
-      if (curr_bmp_word != 0) {
-        found_nonzero_word = TRUE;
-      }
-    }
+    scan_retval = scanner( obj, data );
+    if (! scan_retval)
+      bitmap[ word_idx ] &= ~bit_in_word;
+    else
+      found_nonzero_word = TRUE;
   }
 
   if (! found_nonzero_word) {
@@ -975,12 +1037,12 @@ static void tnode_enumerate_slow_but_certain
                              bool (*scanner)(word loc, void *data), 
                              void *data )
 {
-  int i;
+  long long i;
   word w;
   bool scan_ret;
   for ( i = 0; i < SHIFTED_ADDRESS_SPACE; i += 1 ) {
     assert( i >= 0 );
-    w = ((unsigned)i) << BIT_IDX_SHIFT;
+    w = ((word)i) << BIT_IDX_SHIFT;
     if (extbmp_is_member( ebmp, w )) {
       scan_ret = scanner( w, data );
       if (! scan_ret) {
@@ -26,6 +26,10 @@ void extbmp_clear_members_in( extbmp_t *ebmp, int gno );
 int  extbmp_count_members_in( extbmp_t *ebmp, int gno );
   /* cardinality(ebmp & addresses(gno)) */
 
+void extbmp_union( extbmp_t *dest, extbmp_t *src );
+  /* dest := dest U src; the two must have been created with the same
+   * parameters. */
+
 void extbmp_expand_remset_gnos( extbmp_t *ebmp, int fresh_gno );
 
 void extbmp_enumerate( extbmp_t *ebmp,
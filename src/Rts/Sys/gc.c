@@ -20,6 +20,8 @@
 #include "semispace_t.h"
 #include "heapio.h"
 #include "memmgr.h"
+#include "los_t.h"
+#include "gclib.h"
 
 static gc_t *gc;
 static int  generations;
@@ -85,6 +87,31 @@ word allocate_nonmoving( int length, int tag )
   return 0;
 }
 
+/* The bytevector is allocated in the youngest generation, like any new
+   large object, and is reclaimed with it.  The first four bytes are 
+   not part of the file; see los_allocate_mapped().
+   */
+word allocate_mapped( int fd, int page, int length )
+{
+#if !defined( BDW_GC )
+  int lead = LOS_MAPPED_LEAD - sizeof(word);   /* Bytes before the file's */
+  word *obj;
+
+  if (gc->los == 0 || page < 0 || length <= 0 || 
+      length > LARGEST_OBJECT - lead)
+    return FALSE_CONST;
+  obj = los_allocate_mapped( gc->los, sizeof(word) + lead + length, 0,
+                             fd, (long long)page*PAGESIZE );
+  if (obj == 0)
+    return FALSE_CONST;
+  obj[0] = mkheader( lead + length, BYTEVECTOR_HDR );
+  obj[1] = 0;
+  return tagptr( obj, BVEC_TAG );
+#else
+  return FALSE_CONST;
+#endif
+}
+
 static char *heapio_msg[] =
 { "OK", "Wrong type", "Wrong version", "Can't read", "Can't open",
   "Heap not open", "Can't write", "Unmatched heap code", "Can't close" };
@@ -105,7 +132,8 @@ int load_heap_image_from_file( const char *filename )
   sbase = 0;
   tbase = 0;
 
-  if (heap->type == HEAP_SINGLE || heap->type == HEAP_SPLIT) {
+  if (heap->type == HEAP_SINGLE || heap->type == HEAP_SPLIT ||
+      heap->type == HEAP_MAPPED) {
     text_size = heap->text_size * sizeof(word); 
     data_size = heap->data_size * sizeof(word); 
 
@@ -114,6 +142,10 @@ int load_heap_image_from_file( const char *filename )
     tbase = gc_data_load_area( gc, data_size );
     if ((r = hio_load_bootstrap( heap, sbase, tbase, globals )) < 0)
       goto fail;
+#if !defined( BDW_GC )
+    if (gc->static_area)
+      sh_protect( gc->static_area );
+#endif
   }
   else if (!gc_load_heap( gc, heap ))
     goto fail2;
@@ -33,6 +33,8 @@
 /* RROF collector */
 #define DEFAULT_LOAD_FACTOR_HARD     10.0
 #define SMIRCY_MISC_BOUND            2000
+#define CONCURRENT_MARK_SLICE        4096  /* Budget of one slice of the
+                                              background mark thread */
 
 /* Felix's dissertation described three sets of parameters that seem */
 /* to work well.  One of those sets is wired in as the default set.  */
@@ -82,6 +84,7 @@ struct gc_param {               /* Parameter structure passed to create_gc() */
   bool is_regional_system;
   bool use_static_area;                /* In the nonconservative systems */
   bool use_non_predictive_collector;   /* In the generational system */
+  bool use_mark_compact;               /* In the generational system */
   bool use_incremental_bdw_collector;  /* In the conservative system */
   bool dont_shrink_heap;               /* In the nonconservative systems */
   bool use_oracle_to_update_remsets;   /* In the regional system. */
@@ -93,6 +96,8 @@ struct gc_param {               /* Parameter structure passed to create_gc() */
   bool   has_refine_factor;	       /* In the regional system. */
   double refinement_factor;	       /* In the regional system. */
   bool   alloc_mark_bmp_once;	       /* In the regional system. */
+  bool   concurrent_mark;	       /* In the regional system. */
+  bool   concurrent_summarize;	       /* In the regional system. */
   bool   has_sumzbudget;	       /* In the regional system. */
   double sumzbudget_inv;	       /* In the regional system. */
   bool   has_sumzcoverage;	       /* In the regional system. */
@@ -106,6 +111,9 @@ struct gc_param {               /* Parameter structure passed to create_gc() */
 
   bool chose_rhashrep;
   bool chose_rbitsrep;
+  bool chose_rbucketrep;
+  bool use_card_marking;        /* Card-marking barrier (generational) */
+  int  pretenure_percent;       /* 0, or survival rate that pretenures */
 
   /* Common parameters */
   word *globals;		/* globals table used by collector */
@@ -134,6 +142,10 @@ struct gc_param {               /* Parameter structure passed to create_gc() */
   bool rrof_prefer_lat_summ;
 
   int oracle_countdown;         /* 0 => none; 1 => oracle; o/w countdown */
+
+  int gc_threads;               /* Number of collector threads; <= 1 => none */
+  bool prefetch_scan;           /* Cheney scan prefetches referents */
+  bool dump_mapped_heap;        /* Split heaps are dumped page-aligned */
 };
 
 /* In memmgr.c */
@@ -82,6 +82,7 @@ gc_t
   gc->smircy_completion = 0;
   gc->np_remset = -1;
   gc->scan_update_remset = 0;
+  gc->scan_prefetch = 0;
 
   gc->stat_max_entries_remset_scan = 0;
   gc->stat_total_entries_remset_scan = 0;
@@ -92,6 +93,8 @@ gc_t
   gc->stat_remset_scan_count     = 0;
 
   gc->words_from_nursery_last_gc = 0;
+  gc->workers = 0;
+  gc->pretenure = 0;
 
   gc->initialize = initialize;
   gc->allocate = allocate;
@@ -82,6 +82,12 @@ struct gc {
        Felix cannot tell from the current codebase.)
        */
 
+  int scan_prefetch;
+    /* 1 iff the single-threaded Cheney scan should defer forwarding
+       through a small queue and prefetch the referents it will forward;
+       see scan_oflo_prefetch() in cheney.c.
+       */
+
   int stat_max_entries_remset_scan;
   long long stat_total_entries_remset_scan;
   int stat_max_remset_scan;
@@ -96,6 +102,16 @@ struct gc {
 
   int words_from_nursery_last_gc;
 
+  gc_workers_t *workers;
+    /* In precise collectors: A pool of threads that may share the work
+       of a collection, or NULL if the collector is single-threaded.
+       */
+
+  pretenure_t *pretenure;
+    /* In precise collectors: The allocation-site table used by mc_alloc
+       when globals[ G_PRETENURE ] is set, or NULL.
+       */
+
   void *data;
     /* Private data.
        */
@@ -0,0 +1,280 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- pool of garbage collector worker threads.
+ *
+ * See gc_workers_t.h for the interface.
+ *
+ * Each run is identified by a generation number.  gc_workers_run()
+ * publishes the function and bumps the generation; the helper threads
+ * wake up, run the function, and count themselves out.  The caller
+ * runs worker 0 itself and then waits until all helpers are out.
+ */
+
+#define GC_INTERNAL
+
+#include "larceny.h"
+#include "gc_workers_t.h"
+
+#if defined(HAVE_PTHREADS)
+# include <pthread.h>
+#endif
+
+struct gc_workers {
+  int nthreads;                 /* Including the calling thread */
+#if defined(HAVE_PTHREADS)
+  pthread_t *threads;           /* nthreads-1 helper threads */
+  pthread_mutex_t lock;         /* The pool lock (gc_workers_lock) */
+  pthread_cond_t cond;          /* For gc_workers_wait/broadcast */
+  int readers;                  /* Workers in shared mode */
+  int writers_waiting;          /* Workers waiting for exclusive mode */
+  bool writer;                  /* TRUE if a worker is in exclusive mode */
+  pthread_mutex_t run_lock;     /* Protects the fields below */
+  pthread_cond_t run_start;     /* Signalled when a run begins */
+  pthread_cond_t run_done;      /* Signalled when a helper finishes */
+  unsigned generation;          /* Incremented for each run */
+  int running;                  /* Helpers still running current fn */
+  bool shutdown;                /* TRUE when helpers must exit */
+  void (*fn)( int id, void *data );
+  void *data;
+#endif
+};
+
+#if defined(HAVE_PTHREADS)
+struct worker_arg {
+  gc_workers_t *w;
+  int id;
+};
+
+static void *worker_main( void *p )
+{
+  struct worker_arg *arg = (struct worker_arg*)p;
+  gc_workers_t *w = arg->w;
+  int id = arg->id;
+  unsigned seen = 0;
+
+  free( arg );
+  pthread_mutex_lock( &w->run_lock );
+  while (1) {
+    void (*fn)( int id, void *data );
+    void *data;
+
+    while (w->generation == seen && !w->shutdown)
+      pthread_cond_wait( &w->run_start, &w->run_lock );
+    if (w->shutdown)
+      break;
+    seen = w->generation;
+    fn = w->fn;
+    data = w->data;
+    pthread_mutex_unlock( &w->run_lock );
+
+    fn( id, data );
+
+    pthread_mutex_lock( &w->run_lock );
+    if (--w->running == 0)
+      pthread_cond_signal( &w->run_done );
+  }
+  pthread_mutex_unlock( &w->run_lock );
+  return 0;
+}
+#endif
+
+gc_workers_t *create_gc_workers( int nthreads )
+{
+  gc_workers_t *w;
+
+  if (nthreads < 1) nthreads = 1;
+  if (nthreads > GC_WORKERS_MAX) nthreads = GC_WORKERS_MAX;
+#if !defined(HAVE_PTHREADS)
+  if (nthreads > 1)
+    consolemsg( "GC worker threads are not supported in this "
+                "configuration; using 1." );
+  nthreads = 1;
+#endif
+
+  w = (gc_workers_t*)must_malloc( sizeof( gc_workers_t ) );
+  w->nthreads = nthreads;
+
+#if defined(HAVE_PTHREADS)
+  { int i;
+
+    pthread_mutex_init( &w->lock, 0 );
+    pthread_cond_init( &w->cond, 0 );
+    w->readers = 0;
+    w->writers_waiting = 0;
+    w->writer = FALSE;
+    pthread_mutex_init( &w->run_lock, 0 );
+    pthread_cond_init( &w->run_start, 0 );
+    pthread_cond_init( &w->run_done, 0 );
+    w->generation = 0;
+    w->running = 0;
+    w->shutdown = FALSE;
+    w->fn = 0;
+    w->data = 0;
+    w->threads = (pthread_t*)must_malloc( sizeof( pthread_t )*nthreads );
+
+    for ( i=1 ; i < nthreads ; i++ ) {
+      struct worker_arg *arg =
+        (struct worker_arg*)must_malloc( sizeof( struct worker_arg ) );
+      arg->w = w;
+      arg->id = i;
+      if (pthread_create( &w->threads[i], 0, worker_main, arg ) != 0) {
+        consolemsg( "Could not create GC worker thread %d; using %d.", i, i );
+        free( arg );
+        w->nthreads = i;
+        break;
+      }
+    }
+  }
+#endif
+
+  annoyingmsg( "Created pool of %d GC worker(s).", w->nthreads );
+  return w;
+}
+
+void gc_workers_free( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  int i;
+
+  pthread_mutex_lock( &w->run_lock );
+  w->shutdown = TRUE;
+  pthread_cond_broadcast( &w->run_start );
+  pthread_mutex_unlock( &w->run_lock );
+  for ( i=1 ; i < w->nthreads ; i++ )
+    pthread_join( w->threads[i], 0 );
+  free( w->threads );
+  pthread_cond_destroy( &w->run_done );
+  pthread_cond_destroy( &w->run_start );
+  pthread_mutex_destroy( &w->run_lock );
+  pthread_cond_destroy( &w->cond );
+  pthread_mutex_destroy( &w->lock );
+#endif
+  free( w );
+}
+
+int gc_workers_count( gc_workers_t *w )
+{
+  return w->nthreads;
+}
+
+void gc_workers_run( gc_workers_t *w,
+                     void (*fn)( int id, void *data ), void *data )
+{
+#if defined(HAVE_PTHREADS)
+  if (w->nthreads > 1) {
+    pthread_mutex_lock( &w->run_lock );
+    assert( w->running == 0 );
+    w->fn = fn;
+    w->data = data;
+    w->running = w->nthreads-1;
+    w->generation++;
+    pthread_cond_broadcast( &w->run_start );
+    pthread_mutex_unlock( &w->run_lock );
+
+    fn( 0, data );
+
+    pthread_mutex_lock( &w->run_lock );
+    while (w->running > 0)
+      pthread_cond_wait( &w->run_done, &w->run_lock );
+    w->fn = 0;
+    w->data = 0;
+    pthread_mutex_unlock( &w->run_lock );
+    return;
+  }
+#endif
+  fn( 0, data );
+}
+
+void gc_workers_lock( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &w->lock );
+#endif
+}
+
+void gc_workers_unlock( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_unlock( &w->lock );
+#endif
+}
+
+void gc_workers_wait( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_cond_wait( &w->cond, &w->lock );
+#else
+  panic_abort( "gc_workers_wait: would block forever." );
+#endif
+}
+
+void gc_workers_broadcast( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_cond_broadcast( &w->cond );
+#endif
+}
+
+/* Shared and exclusive modes are a readers/writer lock that prefers
+   writers, built on the pool lock and condition variable.  Waiters
+   for work (gc_workers_wait) share the condition variable, so every
+   state change broadcasts. */
+
+void gc_workers_enter_shared( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &w->lock );
+  while (w->writer || w->writers_waiting > 0)
+    pthread_cond_wait( &w->cond, &w->lock );
+  w->readers++;
+  pthread_mutex_unlock( &w->lock );
+#endif
+}
+
+void gc_workers_leave_shared( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &w->lock );
+  assert( w->readers > 0 );
+  if (--w->readers == 0 && w->writers_waiting > 0)
+    pthread_cond_broadcast( &w->cond );
+  pthread_mutex_unlock( &w->lock );
+#endif
+}
+
+void gc_workers_yield_shared( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  if (*(volatile int*)&w->writers_waiting > 0) {
+    gc_workers_leave_shared( w );
+    gc_workers_enter_shared( w );
+  }
+#endif
+}
+
+void gc_workers_enter_exclusive( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &w->lock );
+  w->writers_waiting++;
+  while (w->writer || w->readers > 0)
+    pthread_cond_wait( &w->cond, &w->lock );
+  w->writers_waiting--;
+  w->writer = TRUE;
+  pthread_mutex_unlock( &w->lock );
+#endif
+}
+
+void gc_workers_leave_exclusive( gc_workers_t *w )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &w->lock );
+  w->writer = FALSE;
+  pthread_cond_broadcast( &w->cond );
+  pthread_mutex_unlock( &w->lock );
+#endif
+}
+
+/* eof */
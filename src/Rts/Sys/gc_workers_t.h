@@ -0,0 +1,115 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- pool of garbage collector worker threads.
+ *
+ * The pool is created once, when the collector is created, and its
+ * threads sleep between collections.  A phase of a collection that
+ * can be split among several threads hands a function to
+ * gc_workers_run(), which runs it on every worker (the calling thread
+ * is worker 0) and returns when all workers have returned.
+ *
+ * The mutator never runs concurrently with the workers, so the rest
+ * of the runtime needs no locking.  Code run by the workers must
+ * take the pool lock around any use of shared collector structures.
+ *
+ * The low-level allocator may move the page table (gclib_desc_g and
+ * friends) when it allocates, so a worker that reads the page table
+ * must be in shared mode, and a worker that allocates must be in
+ * exclusive mode, which waits until no other worker is in shared mode.
+ * Workers in shared mode must call gc_workers_yield_shared()
+ * regularly, and must leave shared mode before they block.
+ *
+ * When the system is configured without HAVE_PTHREADS the pool has
+ * exactly one worker and all operations degenerate to their serial
+ * equivalents.
+ */
+
+#ifndef INCLUDED_GC_WORKERS_T_H
+#define INCLUDED_GC_WORKERS_T_H
+
+#include "config.h"
+#include "larceny-types.h"
+
+#define GC_WORKERS_MAX   32     /* Upper limit on -gcthreads */
+
+gc_workers_t *create_gc_workers( int nthreads );
+  /* Creates a pool of nthreads workers, nthreads-1 of which are new
+     threads.  nthreads is clamped to [1,GC_WORKERS_MAX], and to 1 if
+     threads are not supported.
+     */
+
+void gc_workers_free( gc_workers_t *w );
+  /* Terminates the worker threads and frees the pool.
+     */
+
+int gc_workers_count( gc_workers_t *w );
+  /* Returns the number of workers in the pool, including the caller.
+     */
+
+void gc_workers_run( gc_workers_t *w,
+                     void (*fn)( int id, void *data ), void *data );
+  /* Runs fn( i, data ) on worker i for each 0 <= i < count, with
+     worker 0 being the calling thread.  Returns when every invocation
+     has returned.  Calls to gc_workers_run must not be nested.
+     */
+
+void gc_workers_lock( gc_workers_t *w );
+void gc_workers_unlock( gc_workers_t *w );
+  /* Acquire and release the pool lock.  The lock is not recursive.
+     */
+
+void gc_workers_wait( gc_workers_t *w );
+  /* requires: caller holds the pool lock.
+     Releases the lock, waits for gc_workers_broadcast, and reacquires
+     the lock.  May wake spuriously; callers must recheck their condition.
+     */
+
+void gc_workers_broadcast( gc_workers_t *w );
+  /* Wakes every worker that is blocked in gc_workers_wait.
+     */
+
+void gc_workers_enter_shared( gc_workers_t *w );
+void gc_workers_leave_shared( gc_workers_t *w );
+  /* requires: caller does not hold the pool lock.
+     Enter and leave shared mode.  Entering waits for any pending
+     exclusive section to finish.
+     */
+
+void gc_workers_yield_shared( gc_workers_t *w );
+  /* requires: caller is in shared mode and does not hold the pool lock.
+     Leaves and reenters shared mode if another worker is waiting to
+     enter exclusive mode; otherwise does nothing.
+     */
+
+void gc_workers_enter_exclusive( gc_workers_t *w );
+void gc_workers_leave_exclusive( gc_workers_t *w );
+  /* requires: caller is not in shared mode and does not hold the lock.
+     Enter and leave exclusive mode.
+     */
+
+/* Atomic operations on words, for use by code that runs on the
+   workers.  All of them are full memory barriers.
+   */
+#if defined(HAVE_PTHREADS)
+# define gc_atomic_cas( p, old, new ) \
+    __sync_bool_compare_and_swap( (p), (old), (new) )
+# define gc_atomic_add( p, n )        __sync_fetch_and_add( (p), (n) )
+# define gc_memory_barrier()          __sync_synchronize()
+# define gc_atomic_set_bits( p, n ) \
+    ((__sync_fetch_and_or( (p), (n) ) & (n)) == (n))
+#else
+# define gc_atomic_cas( p, old, new ) \
+    ((*(p) == (old)) ? (*(p) = (new), 1) : 0)
+# define gc_atomic_add( p, n )        ((*(p) += (n)) - (n))
+# define gc_memory_barrier()          (void)0
+# define gc_atomic_set_bits( p, n ) \
+    ((*(p) & (n)) == (n) ? 1 : (*(p) |= (n), 0))
+#endif
+  /* gc_atomic_set_bits sets the bits n in *p and returns nonzero iff
+     they were all set already. */
+
+#endif /* INCLUDED_GC_WORKERS_T_H */
+
+/* eof */
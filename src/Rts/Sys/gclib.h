@@ -33,6 +33,22 @@
       gclib_desc_g element type is byte, and the high bit is the large
         object bit and the low 7 bits are the generation number; and
       the table for entire 4GB address range is preallocated.
+
+   The attribute GCLIB_SPARSE_TABLE may be set instead.  It is meant
+   for 64-bit address spaces, where neither a flat table nor one that
+   slides over the heap will do.  If set, then
+      gclib_desc_g, gclib_desc_b, and gclib_pagebase are not defined;
+      the page number of an address is the address shifted right by
+      PAGESHIFT, as with GCLIB_LARGE_TABLE;
+      the generation numbers and attribute bits are kept in leaves of
+        GCLIB_LEAF_PAGES entries each, which are found through the
+        directories gclib_dir_g and gclib_dir_b;
+      a leaf is allocated when memory in its range is first allocated,
+        and the directory entries of other ranges all point to one
+        shared leaf of foreign pages, so a lookup never has to check
+        for a missing leaf; and
+      the directories and leaves are never moved.
+   Use gen_of() and attr_of(), or gclib_desc() with a page number.
 */
 
 #ifndef ASSEMBLER
@@ -61,13 +77,32 @@
 #define pageof_pb( n, pb ) ((int)(((word)(n)-(word)(pb)) >> (PAGESHIFT)))
 #if GCLIB_LARGE_TABLE
 # define pageof( n )       ((int)((word)(n) >> (PAGESHIFT)))
+#elif GCLIB_SPARSE_TABLE
+# define pageof( n )       ((word)(n) >> (PAGESHIFT))
 #else
 # define pageof( n )     ((int)(((word)(n)-(word)gclib_pagebase)>>(PAGESHIFT)))
 #endif
 
+#if GCLIB_SPARSE_TABLE
+# if defined(BITS_64)
+#  define GCLIB_ADDRESS_BITS  48          /* User part of x86-64, AArch64 */
+# else
+#  define GCLIB_ADDRESS_BITS  32
+# endif
+# define GCLIB_LEAF_SHIFT    18            /* 1GB of pages per leaf */
+# define GCLIB_LEAF_PAGES    (1 << GCLIB_LEAF_SHIFT)
+# define GCLIB_DIR_ENTRIES   \
+  ((word)1 << (GCLIB_ADDRESS_BITS - PAGESHIFT - GCLIB_LEAF_SHIFT))
+# define gclib_desc( dir, pg ) \
+  ((dir)[(word)(pg) >> GCLIB_LEAF_SHIFT][(word)(pg) & (GCLIB_LEAF_PAGES-1)])
+#endif
+
 #if GCLIB_LARGE_TABLE
 # define gen_of( ptr )      (gclib_desc_g[pageof(ptr)] & ~MB_MASK)
 # define attr_of( ptr )     (gclib_desc_g[pageof(ptr)] & MB_MASK)
+#elif GCLIB_SPARSE_TABLE
+# define gen_of( ptr )      gclib_desc( gclib_dir_g, pageof(ptr) )
+# define attr_of( ptr )     gclib_desc( gclib_dir_b, pageof(ptr) )
 #else
 # define gen_of( ptr )      (gclib_desc_g[pageof(ptr)])
 # define attr_of( ptr )     (gclib_desc_b[pageof(ptr)])
@@ -107,11 +142,25 @@ typedef unsigned gclib_desc_t;
 
 /* Global variables */
 
+#if GCLIB_SPARSE_TABLE
+extern gclib_desc_t **gclib_dir_g;      /* leaves of generation owners */
+extern gclib_desc_t **gclib_dir_b;      /* leaves of attribute bits */
+#else
 extern gclib_desc_t *gclib_desc_g;	/* generation owner */
 #if !GCLIB_LARGE_TABLE
 extern gclib_desc_t* gclib_desc_b;      /* attribute bits */
 extern caddr_t       gclib_pagebase;    /* address of lowest page */
 #endif
+#endif
+
+/* The generation of ptr in the table genv that the write barrier was
+   given; the barrier caches the table in globals[ G_GENV ].  With the
+   sparse table the directories do not move and gen_of() is used.  */
+#if GCLIB_SPARSE_TABLE
+# define genv_of( genv, ptr )  gen_of( ptr )
+#else
+# define genv_of( genv, ptr )  ((genv)[pageof(ptr)])
+#endif
 
 /* The following are defined in "alloc.c" */
 
@@ -130,13 +179,15 @@ void *gclib_alloc_heap( int bytes, int gen_no );
      allocated starting on a page boundary.  If a heap limit is in
      effect, and if the request cannot be satisfied without exceeding
      the limit, memfail() is called to signal that the limit is
-     exceeded.
+     exceeded.  Heap memory may hold code, so it is executable, except
+     in Petit Larceny, where code is compiled C and is never in the heap.
      */
 
 void *gclib_alloc_rts( int bytes, unsigned attribute );
   /* Allocate `bytes' bytes of RTS memory with the given attribute, and
      return a pointer to the block.
-     The memory is allocated starting on a page boundary.
+     The memory is allocated starting on a page boundary.  It is not
+     executable if the system keeps writable data and code apart.
      */
 
 void gclib_free( void *addr, int bytes );
@@ -146,6 +197,19 @@ void gclib_free( void *addr, int bytes );
      you may not use this function to free partial blocks.
      */
 
+typedef struct {
+  void *addr;
+  int  bytes;
+} gclib_block_t;
+
+void gclib_free_blocks( gclib_block_t *blocks, int n );
+  /* Free the n blocks, each as by gclib_free().  The blocks must all
+     have the same major attributes (e.g. all heap memory).  The array
+     is sorted by address in place, and each run of adjacent blocks is
+     returned to the operating system in one piece if the platform
+     allows it.
+     */
+
 void gclib_shrink_block( void *addr, int oldsize, int newsize );
   /* Shrink the block by reducing its size; the address of the block
      remains the same.  `Oldsize' must reflect the actual size of the
@@ -159,6 +223,14 @@ void gclib_memory_range( caddr_t *lowest, caddr_t *highest );
      descriptor tables.
      */
 
+void gclib_table_range( caddr_t *lowest, unsigned *pages );
+  /* Returns the address of the first page covered by the descriptor
+     tables and the number of pages they cover.  The range changes when
+     the tables slide or grow, and wb_re_setup() is called when it does.
+     The sparse table covers everything, so for it this is the range of
+     pages that have been allocated, which changes likewise.
+     */
+
 void gclib_set_generation( void *address, int nbytes, int generation );
   /* Set the generation number for all pages in the range implied by
      `address' and `nbytes' to `generation'.
@@ -169,6 +241,18 @@ void gclib_add_attribute( void *address, int nbytes, unsigned attr );
      pages in the range implied by `address' and `nbytes'.
      */
 
+#define GCLIB_PROT_DATA   0     /* read, write */
+#define GCLIB_PROT_TEXT   1     /* read, execute */
+#define GCLIB_PROT_MIXED  2     /* read, write, execute; the default */
+
+void gclib_set_protection( void *address, int nbytes, int prot );
+  /* Set the protection of all the pages in the range implied by
+     `address' and `nbytes', which must lie in heap memory, to `prot'.
+     This has an effect only if the system keeps writable data and code
+     apart (-wxorx); heap memory is otherwise always GCLIB_PROT_MIXED.
+     Freed memory need not be given a protection first.
+     */
+
 void gclib_stats( gclib_stats_t *stats );
   /* Returns some statistics about the memory manager.
      */
@@ -234,11 +318,15 @@ void gclib_stopcopy_collect_np( gc_t *gc, semispace_t *tospace );
      'young' area.
      */
 
-void gclib_stopcopy_split_heap( gc_t *gc,
-			        semispace_t *data, semispace_t *text );
-  /* Copy all live data into the two static-area semispaces provided. 
-     We are making the assumption that the semispaces have higher
-     generation numbers than any other areas.
+void gclib_stopcopy_split_heap( gc_t *gc, semispace_t *data, 
+                                semispace_t *code, semispace_t *strings,
+                                semispace_t *other );
+  /* Copy all live data into the static-area semispaces provided: 
+     objects that contain pointers into 'data', code vectors into 'code',
+     strings into 'strings', and other bytevector-like objects into
+     'other'.  Objects of each kind are copied in the order the collector
+     reaches them from the roots.  We are making the assumption that the
+     semispaces have higher generation numbers than any other areas.
      */
 
 void gclib_check_object( word obj );
@@ -19,9 +19,9 @@
  *   are adjusted as the heap is read in.
  *
  * Bootstrap split heaps are created from bootstrap single heaps using
- * either the external 'hsplit' utility program or the reorganize-and-dump
- * command line switch.  The split heap has two data areas, data and text,
- * where the text area holds executable code only:
+ * the reorganize-and-dump command line switch.  The split heap has two
+ * data areas, data and text, where the text area holds the objects that
+ * contain no pointers: code vectors first, then strings, then the rest:
  *
  *    - version number (1 word)
  *    - roots (n words; depends on version)
@@ -33,6 +33,25 @@
  *   Intergenerational pointers (data -> text) have the high bit set. 
  *   All pointers are adjusted relative to 0 of the heap they point to.
  *
+ * Mapped heaps are split heaps whose header is padded with zeroes to a
+ * page boundary, so that the text area and the data area (whose sizes
+ * are multiples of the page size) start on page boundaries in the file:
+ *
+ *    - version number (1 word)
+ *    - roots (n words; depends on version)
+ *    - word count for the text area
+ *    - word count for the data area
+ *    - padding to a page boundary
+ *    - text area
+ *    - data area
+ *
+ *   The loader maps both areas copy-on-write from the file instead of
+ *   reading them.  The text area has no pointers, so it is never written
+ *   and stays shared with the file cache and with every other process
+ *   that runs the heap.  The data area is relocated in place, which
+ *   writes only the words that are pointers; the file is not read
+ *   through stdio at all.
+ *
  * Dumped heaps are dumped interactively and preserve the data of each
  * generation individually, and in addition allows for the dumping of
  * heap metadata (e.g. free lists):
@@ -67,7 +86,7 @@
  * The version number has two fields: the low 16 bits is a heap version
  * number (incremented whenever the heap layout changes, for example
  * when roots are added).  The high 16 bits is the heap type: 0=single,
- * 1=split, 2=dumped.
+ * 1=split, 2=dumped, 3=mapped.
  *
  * -----
  *
@@ -86,6 +105,10 @@
 #include "heapio.h"
 #include "semispace_t.h"
 #include "gclib.h"
+#include "gc_workers_t.h"
+
+/* Bytes of segment buffers filled by one parallel translation round */
+#define DUMP_BATCH_BYTES  (16*1024*1024)
 
 typedef struct hio_range hio_range;
 
@@ -116,17 +139,22 @@ static jmp_buf EX_heapio_ex;
 
 static int  load_text( heapio_t *h, word *base, int count );
 static int  load_data( heapio_t *h, word *text, word *data, int count );
+static int  map_area( heapio_t *h, word *base, int count, long offset );
+static void relocate_data( word *text_base, word *data_base, int count );
+static int  header_bytes( void );
+static void pad( int bytes, FILE *fp );
 #if 0
 static void putheader( FILE*, word, word, word, word*, word );
 static void put_tagged_word( word, FILE*, word, word, word );
 static void dump_text( word, word, FILE* );
 static void dump_data( word, word, word, word, FILE* );
 #else
+static word tagged_word( word w, word *lowest, word *pagetbl );
 static void put_tagged_word( word w, word *lowest, word *pagetbl, FILE *fp );
-static void dump_text_block( hio_range a, word *lowest, word *pagetbl,
-			     FILE *fp );
-static void dump_data_block( hio_range a, word *lowest, word *pagetbl,
-			     FILE *fp );
+static int  translate_text_block( hio_range *a, word *buf );
+static int  translate_data_block( hio_range *a, word *lowest, word *pagetbl,
+				  word *buf );
+static void dump_blocks( heapio_t *h, word *lowest, word *pagetbl );
 #endif
 static word getword( FILE *fp );
 static void putword( word, FILE* );
@@ -142,7 +170,9 @@ heapio_t *create_heapio( void )
   h->input = 0;
   h->output = 0;
   h->split_heap = 0;
+  h->mapped_heap = 0;
   h->bootstrap_heap = 0;
+  h->workers = 0;
   h->text_segments = (hio_tbl*)must_malloc( sizeof( hio_tbl ) );
   h->text_segments->a = 0;
   h->text_segments->size = 0;
@@ -189,6 +219,9 @@ int hio_open( heapio_t *h, const char *filename )
     h->data_size = getword( fp );
     h->text_size = 0;
     break;
+  case HEAP_MAPPED:
+    h->mapped_heap = 1;
+    /* FALLTHROUGH */
   case HEAP_SPLIT:
     h->split_heap = 1;
     h->bootstrap_heap = 1;
@@ -220,6 +253,9 @@ int hio_create( heapio_t *h, const char *filename, int type )
   case HEAP_SINGLE :
     h->bootstrap_heap = 1;
     break;
+  case HEAP_MAPPED :
+    h->mapped_heap = 1;
+    /* FALLTHROUGH */
   case HEAP_SPLIT :
     h->bootstrap_heap = 1;
     h->split_heap = 1;
@@ -304,6 +340,11 @@ int hio_dump_segment( heapio_t *h, int type, word *bot, word *top )
   return HEAPIO_OK;
 }
 
+void hio_dump_workers( heapio_t *h, gc_workers_t *workers )
+{
+  h->workers = workers;
+}
+
 int hio_dump_commit( heapio_t *h )
 {
   word *lowest, *highest, *pagetbl;
@@ -352,20 +393,32 @@ int hio_dump_commit( heapio_t *h )
     put_tagged_word( h->globals[i], lowest, pagetbl, h->fp );
   putword( text_size/sizeof(word), h->fp );
   putword( data_size/sizeof(word), h->fp );
-  for ( i=0 ; i < h->text_segments->next ; i++ )
-    dump_text_block( h->text_segments->a[i], lowest, pagetbl, h->fp );
-  for ( i=0 ; i < h->data_segments->next ; i++ )
-    dump_data_block( h->data_segments->a[i], lowest, pagetbl, h->fp );
+  if (h->mapped_heap)
+    pad( header_bytes(), h->fp );
+  dump_blocks( h, lowest, pagetbl );
   return HEAPIO_OK;
 }
 
-static void
-put_tagged_word( word w, word *lowest, word *pagetbl, FILE *fp )
+/* Bytes from the start of a split heap image to its text area. */
+static int
+header_bytes( void )
+{
+  return (1 + (LAST_ROOT-FIRST_ROOT+1) + 2) * sizeof( word );
+}
+
+static word
+tagged_word( word w, word *lowest, word *pagetbl )
 {
   if (isptr( w ))
-    putword( pagetbl[pageof_pb(w, lowest)] | (w & PAGEMASK), fp );
+    return pagetbl[pageof_pb(w, lowest)] | (w & PAGEMASK);
   else
-    putword( w, fp );
+    return w;
+}
+
+static void
+put_tagged_word( word w, word *lowest, word *pagetbl, FILE *fp )
+{
+  putword( tagged_word( w, lowest, pagetbl ), fp );
 }    
 
 static void
@@ -378,48 +431,149 @@ pad( int bytes, FILE *fp )
       putc( 0, fp );
 }
 
+/* The words of the image are in the byte order of the machine (see
+   putword), so the segments are translated in memory and written with
+   fwrite.  Each segment becomes a buffer padded to a page boundary; the
+   buffers of a round are filled by the workers, if there are any, and
+   then written in order.  The translation only reads the heap and the
+   image page table, so the workers need no locking.
+   */
+
+typedef struct dump_job dump_job_t;
+
+struct dump_job {
+  hio_range *blocks;            /* Text segments, then data segments */
+  int ntext;                    /* Number of text segments */
+  word **bufs;                  /* Buffer of each segment */
+  int *lengths;                 /* Bytes of each buffer to be written */
+  int next;                     /* Next segment of the round */
+  int limit;                    /* End of the round */
+  word *lowest;
+  word *pagetbl;
+};
+
+static int
+block_buffer_bytes( hio_range *a )
+{
+  /* A large object may be translated one word past its top. */
+  return roundup_page( a->bytes + sizeof( word ) );
+}
+
 static void
-dump_text_block( hio_range a, word *lowest, word *pagetbl, FILE *fp )
+translate_blocks( int id, void *data )
 {
-  if (fwrite( (void*)a.bot, 1, a.bytes, fp ) != a.bytes)
-    THROW( HEAPIO_CANTWRITE );
-  pad( a.bytes, fp );
+  dump_job_t *job = (dump_job_t*)data;
+  int i;
+
+  while ((i = gc_atomic_add( &job->next, 1 )) < job->limit) {
+    if (i < job->ntext)
+      job->lengths[i] = translate_text_block( &job->blocks[i], job->bufs[i] );
+    else
+      job->lengths[i] = translate_data_block( &job->blocks[i], job->lowest,
+					      job->pagetbl, job->bufs[i] );
+  }
 }
 
 static void
-dump_data_block( hio_range a, word *lowest, word *pagetbl, FILE *fp )
+dump_blocks( heapio_t *h, word *lowest, word *pagetbl )
 {
-  word w, *p;
-  int i, data_count;
-  int bytes_written;
-  data_count = (a.top - a.bot);
-  p = a.bot;
-  if (a.is_large) {
-    while (p != a.real_bot) {
-      putword( 0, fp );
+  dump_job_t job;
+  int n, i, first, budget, bytes;
+
+  n = h->text_segments->next + h->data_segments->next;
+  job.ntext = h->text_segments->next;
+  job.blocks = (hio_range*)must_malloc( sizeof( hio_range )*max( n, 1 ) );
+  job.bufs = (word**)must_malloc( sizeof( word* )*max( n, 1 ) );
+  job.lengths = (int*)must_malloc( sizeof( int )*max( n, 1 ) );
+  job.lowest = lowest;
+  job.pagetbl = pagetbl;
+  for ( i=0 ; i < h->text_segments->next ; i++ )
+    job.blocks[i] = h->text_segments->a[i];
+  for ( i=0 ; i < h->data_segments->next ; i++ )
+    job.blocks[job.ntext+i] = h->data_segments->a[i];
+
+  /* Without workers there is one segment per round. */
+  budget = (h->workers ? DUMP_BATCH_BYTES : 0);
+  for ( first=0 ; first < n ; first=job.limit ) {
+    bytes = 0;
+    for ( job.limit=first ; job.limit < n ; job.limit++ ) {
+      i = block_buffer_bytes( &job.blocks[job.limit] );
+      if (job.limit > first && bytes + i > budget)
+	break;
+      job.bufs[job.limit] = (word*)must_malloc( i );
+      bytes += i;
+    }
+    job.next = first;
+#if !defined(BDW_GC)
+    if (h->workers && job.limit - first > 1)
+      gc_workers_run( h->workers, translate_blocks, &job );
+    else
+#endif
+      translate_blocks( 0, &job );
+    for ( i=first ; i < job.limit ; i++ ) {
+      if (fwrite( (void*)job.bufs[i], 1, job.lengths[i], h->fp ) 
+	  != job.lengths[i]) {
+	for ( ; i < job.limit ; i++ )
+	  free( job.bufs[i] );
+	free( job.blocks );
+	free( job.bufs );
+	free( job.lengths );
+	THROW( HEAPIO_CANTWRITE );
+      }
+      free( job.bufs[i] );
+    }
+  }
+  free( job.blocks );
+  free( job.bufs );
+  free( job.lengths );
+}
+
+/* Returns the number of bytes of buf to be written. */
+static int
+translate_text_block( hio_range *a, word *buf )
+{
+  int bytes = roundup_page( a->bytes );
+
+  memcpy( buf, a->bot, a->bytes );
+  memset( (byte*)buf + a->bytes, 0, bytes - a->bytes );
+  return bytes;
+}
+
+/* Returns the number of bytes of buf to be written. */
+static int
+translate_data_block( hio_range *a, word *lowest, word *pagetbl, word *buf )
+{
+  word w, *p, *q;
+  int i, data_count, bytes;
+
+  data_count = (a->top - a->bot);
+  p = a->bot;
+  q = buf;
+  if (a->is_large) {
+    while (p != a->real_bot) {
+      *q++ = 0;
       p++;
       data_count--;
     }
   }
-  /* data_count may go negative if a.top is not 8-byte aligned,
+  /* data_count may go negative if a->top is not 8-byte aligned,
      this may occur when dumping large objects.  */
   while (data_count > 0) {
     w = *p++; 
-    put_tagged_word( w, lowest, pagetbl, fp );
+    *q++ = tagged_word( w, lowest, pagetbl );
     data_count--;
 
     if (header( w ) == BV_HDR) {
       i = roundup4( sizefield( w ) ) / sizeof( word );
-      while (i--) {
-	putword( *p++, fp );
-	data_count--;
-      }
+      memcpy( q, p, i*sizeof( word ) );
+      p += i;
+      q += i;
+      data_count -= i;
     }
   }
-  /* data_count is usually 0, but when negative, we've written a bit
-   * further and the padding must account for that. */
-  bytes_written = a.bytes - data_count*sizeof(word);
-  pad( bytes_written, fp );
+  bytes = (q - buf)*sizeof( word );
+  memset( (byte*)buf + bytes, 0, roundup_page( bytes ) - bytes );
+  return roundup_page( bytes );
 }
 
 int hio_load_bootstrap( heapio_t *h, word *text_base, word *data_base,
@@ -444,6 +598,17 @@ int hio_load_bootstrap( heapio_t *h, word *text_base, word *data_base,
       globals[ i ] = h->roots[j];
   }
 
+  if (h->mapped_heap) {
+    long offset = roundup_page( header_bytes() );
+
+    r = map_area( h, text_base, h->text_size, offset );
+    if (r < 0) return r;
+    offset += h->text_size*sizeof( word );
+    r = map_area( h, data_base, h->data_size, offset );
+    if (r < 0) return r;
+    relocate_data( text_base, data_base, h->data_size );
+    return HEAPIO_OK;
+  }
   if (h->split_heap) {
     r = load_text( h, text_base, h->text_size );
     if (r < 0) return r;
@@ -451,6 +616,28 @@ int hio_load_bootstrap( heapio_t *h, word *text_base, word *data_base,
   return load_data( h, text_base, data_base, h->data_size );
 }
 
+/* Maps count words at offset in the file to base, or reads them if the
+   area cannot be mapped there.
+   */
+static int
+map_area( heapio_t *h, word *base, int count, long offset )
+{
+  supremely_annoyingmsg("heapio map_area( h, 0x%08x, %d, %ld )", 
+			base, count, offset);
+
+  if (count == 0)
+    return HEAPIO_OK;
+#if OSDEP_MAP_FILE
+  if ((word)base % PAGESIZE == 0 &&
+      osdep_map_file( base, count*sizeof( word ), fileno( h->fp ), offset ))
+    return HEAPIO_OK;
+#endif
+  if (fseek( h->fp, offset, SEEK_SET ) != 0 ||
+      fread( (char*)base, sizeof( word ), count, h->fp ) < count)
+    return HEAPIO_CANTREAD;
+  return HEAPIO_OK;
+}
+
 static int
 load_text( heapio_t *h, word *text_base, int count )
 {
@@ -467,14 +654,22 @@ load_text( heapio_t *h, word *text_base, int count )
 static int
 load_data( heapio_t *h, word *text_base, word *data_base, int count )
 {
-  word *p, w;
-  int i;
   supremely_annoyingmsg("heapio load_data( h, 0x%08x, [0x%08x,0x%08x), %d )", 
 			text_base, data_base, data_base+count, count);
 
   if (fread( (char*)data_base, sizeof( word ), count, h->fp ) < count)
     return HEAPIO_CANTREAD;
 
+  relocate_data( text_base, data_base, count );
+  return HEAPIO_OK;
+}
+
+static void
+relocate_data( word *text_base, word *data_base, int count )
+{
+  word *p, w;
+  int i;
+
   p = data_base;
   while (count > 0) {
     w = *p;
@@ -496,7 +691,6 @@ load_data( heapio_t *h, word *text_base, word *data_base, int count )
     hardconsolemsg( "LOAD: INCONSISTENT." );
     abort();
   }
-  return HEAPIO_OK;
 }
 
 #if 0
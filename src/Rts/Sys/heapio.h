@@ -26,9 +26,11 @@ struct heapio_t {
   word    roots[ LAST_ROOT-FIRST_ROOT+1 ];
   bool    split_heap;           /* 1 if the heap has a static area */
   bool    bootstrap_heap;       /* 1 if single or split heap */
+  bool    mapped_heap;          /* 1 if the areas are page-aligned */
   bool    input;                /* 1 if open for input */
   bool    output;               /* 1 if open for output */
   word    *globals;
+  gc_workers_t *workers;        /* Translate segments in parallel, or 0 */
   hio_tbl *text_segments; 
   hio_tbl *data_segments;
 };
@@ -47,6 +49,7 @@ struct heapio_t {
 #define HEAP_SINGLE          0
 #define HEAP_SPLIT           1
 #define HEAP_DUMPED          2
+#define HEAP_MAPPED          3          /* split, page-aligned areas */
 
 /* Codes for hio_dump_segment. */
 
@@ -91,16 +94,24 @@ extern int hio_dump_segment( heapio_t *h, int type, word *bot, word *top );
      Returns 0 on success or a negative error code on failure.
      */
 
+extern void hio_dump_workers( heapio_t *h, gc_workers_t *workers );
+  /* Have hio_dump_commit() use the worker pool to translate the segments
+     of the dump in parallel.  Must be called before hio_dump_commit().
+     */
+
 extern int hio_dump_commit( heapio_t *h );
-  /* Finish the dump.
+  /* Finish the dump.  Each segment is translated into a buffer and
+     written with a single write.
 
      Returns 0 on success or a negative error code on failure.
      */
 
 extern int
 hio_load_bootstrap( heapio_t *h, word *text, word *data, word *globals );
-  /* If h is an open heap of type HEAP_SPLIT or HEAP_SINGLE, then load the
-     heap image into the text and data areas.
+  /* If h is an open heap of type HEAP_SPLIT, HEAP_MAPPED, or HEAP_SINGLE,
+     then load the heap image into the text and data areas.  The areas
+     of a HEAP_MAPPED heap are mapped from the file rather than read, if
+     they are page-aligned.
 
      Returns 0 on success or a negative error code on failure.
      */
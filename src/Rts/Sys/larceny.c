@@ -26,6 +26,7 @@
 #include "stats.h"        /* for stats_init() */
 #include "gc_t.h"
 #include "young_heap_t.h" /* for yh_create_initial_stack() */
+#include "stack.h"        /* for stk_set_restore_limit() */
 
 opt_t command_line_options;
 
@@ -133,6 +134,7 @@ int main( int argc, char **os_argv )
   command_line_options.timerval = 0xFFFFFFFF;
   command_line_options.heapfile = 0;
   command_line_options.enable_breakpoints = 1;
+  command_line_options.numa_node = -1;
   command_line_options.restv = 0;
   command_line_options.gc_info.ephemeral_info = 0;
   command_line_options.gc_info.use_static_area = 1;
@@ -226,6 +228,17 @@ int main( int argc, char **os_argv )
   if (annoying || supremely_annoying)
     dump_options( &command_line_options );
 
+#if OSDEP_PROTECT_ALIGNED
+  if (command_line_options.wxorx)
+    osdep_use_wxorx();
+#endif
+#if OSDEP_HEAP_ARENA
+  if (command_line_options.heap_arena > 0)
+    osdep_use_heap_arena( command_line_options.heap_arena,
+                          command_line_options.numa_node,
+                          command_line_options.numa_interleave );
+#endif
+
   if (command_line_options.flush)
     globals[ G_CACHE_FLUSH ] = 1;
   else if (command_line_options.noflush)
@@ -258,6 +271,23 @@ int main( int argc, char **os_argv )
     return 0;
   }
 
+#if OSDEP_PREFORK
+  /* The heap image is in the static area, which the workers share until
+     they write to it; the collectors do not write to static pages except
+     to update pointers to younger objects.
+     */
+  if (command_line_options.prefork > 0)
+    osdep_prefork( command_line_options.prefork );
+#endif
+
+#if OSDEP_URING
+  if (command_line_options.io_uring && !osdep_uring_init())
+    annoyingmsg( "io_uring is not available; file I/O will not be batched." );
+#endif
+
+  if (command_line_options.stack_batch > 1)
+    stk_set_restore_limit( command_line_options.stack_batch );
+
   /* initialize some policy globals */
   globals[ G_BREAKPT_ENABLE ] =
     (command_line_options.enable_breakpoints ? TRUE_CONST : FALSE_CONST);
@@ -510,6 +540,7 @@ parse_options( int argc, char **argv, opt_t *o )
   int mmu_size;
   int mark_period;
   int oracle_countdown;
+  int gc_threads;
   double popular_factor = 0.0;
   double infamy_factor = 0.0;
   double refine_factor = 0.0;
@@ -542,6 +573,10 @@ parse_options( int argc, char **argv, opt_t *o )
       init_generational( o, areas, "-areas" );
     else if (hstrcmp( *argv, "-gen" ) == 0)
       init_generational( o, areas, "-gen" );
+    else if (hstrcmp( *argv, "-mark-compact" ) == 0) {
+      o->gc_info.is_generational_system = 1;
+      o->gc_info.use_mark_compact = 1;
+    }
     else if (hstrcmp( *argv, "-nostatic" ) == 0)
       o->gc_info.use_static_area = 0;
     else if (hstrcmp( *argv, "-nocontract" ) == 0)
@@ -579,6 +614,40 @@ parse_options( int argc, char **argv, opt_t *o )
     else if (numbarg( "-mmusize", &argc, &argv, &mmu_size)) {
       o->gc_info.mmu_buf_size = mmu_size;
     }
+    else if (numbarg( "-gcthreads", &argc, &argv, &gc_threads )) {
+      if (gc_threads < 1)
+        param_error( "The number of GC threads must be at least 1." );
+      o->gc_info.gc_threads = gc_threads;
+    }
+    else if (hstrcmp( *argv, "-prefetch-scan" ) == 0) {
+      o->gc_info.prefetch_scan = TRUE;
+    }
+    else if (sizearg( "-arena", &argc, &argv, &o->heap_arena ))
+      ;
+    else if (numbarg( "-numa", &argc, &argv, &o->numa_node )) {
+      if (o->numa_node < 0 || o->numa_node >= 64)
+        param_error( "The NUMA node must be between 0 and 63." );
+    }
+    else if (hstrcmp( *argv, "-numa-interleave" ) == 0) {
+      o->numa_interleave = TRUE;
+    }
+    else if (hstrcmp( *argv, "-wxorx" ) == 0) {
+      o->wxorx = TRUE;
+    }
+    else if (hstrcmp( *argv, "-mapped-heap" ) == 0) {
+      o->gc_info.dump_mapped_heap = TRUE;
+    }
+    else if (numbarg( "-prefork", &argc, &argv, &o->prefork )) {
+      if (o->prefork < 1)
+        param_error( "The number of workers must be at least 1." );
+    }
+    else if (numbarg( "-stack-batch", &argc, &argv, &o->stack_batch )) {
+      if (o->stack_batch < 1)
+        param_error( "The stack batch must be at least 1 frame." );
+    }
+    else if (hstrcmp( *argv, "-io-uring" ) == 0) {
+      o->io_uring = TRUE;
+    }
     else if (numbarg( "-regions", &argc, &argv, &areas))  {
       init_regional( o, areas, "-regions" );
     } else if (hstrcmp( *argv, "-rrof" ) == 0 || 
@@ -610,6 +679,12 @@ parse_options( int argc, char **argv, opt_t *o )
     else if (hstrcmp( *argv, "-alloc_mark_bmp_once" ) == 0) {
       o->gc_info.alloc_mark_bmp_once = 1;
     } 
+    else if (hstrcmp( *argv, "-concurrent-mark" ) == 0) {
+      o->gc_info.concurrent_mark = TRUE;
+    } 
+    else if (hstrcmp( *argv, "-concurrent-summarize" ) == 0) {
+      o->gc_info.concurrent_summarize = TRUE;
+    } 
     else if (doublearg( "-sumzbudget", &argc, &argv, &sumz_budget)) {
       o->gc_info.has_sumzbudget = TRUE;
       o->gc_info.sumzbudget_inv = sumz_budget;
@@ -649,9 +724,22 @@ parse_options( int argc, char **argv, opt_t *o )
     else if   (hstrcmp( *argv, "-rhashrep" ) == 0) {
       o->gc_info.chose_rhashrep = TRUE;
       o->gc_info.chose_rbitsrep = FALSE;
+      o->gc_info.chose_rbucketrep = FALSE;
     } else if (hstrcmp( *argv, "-rbitsrep" ) == 0) {
       o->gc_info.chose_rhashrep = FALSE;
       o->gc_info.chose_rbitsrep = TRUE;
+      o->gc_info.chose_rbucketrep = FALSE;
+    } else if (hstrcmp( *argv, "-rbucketrep" ) == 0) {
+      o->gc_info.chose_rhashrep = FALSE;
+      o->gc_info.chose_rbitsrep = FALSE;
+      o->gc_info.chose_rbucketrep = TRUE;
+    } else if (hstrcmp( *argv, "-cardrep" ) == 0) {
+      o->gc_info.use_card_marking = TRUE;
+    } else if (numbarg( "-pretenure", &argc, &argv,
+                        &o->gc_info.pretenure_percent )) {
+      if (o->gc_info.pretenure_percent < 1 ||
+          o->gc_info.pretenure_percent > 100)
+        param_error( "The pretenuring survival rate must be 1 to 100." );
     } else 
 #endif /* !BDW_GC */
     if (numbarg( "-ticks", &argc, &argv, (int*)&o->timerval ))
@@ -866,13 +954,72 @@ parse_options( int argc, char **argv, opt_t *o )
   if (o->gc_info.is_generational_system && o->gc_info.is_stopcopy_system)
     param_error( "Both generational and non-generational gc selected." );
 
+  if (o->gc_info.use_mark_compact &&
+      (o->gc_info.is_stopcopy_system || o->gc_info.is_regional_system ||
+       o->gc_info.use_non_predictive_collector))
+    param_error( "-mark-compact requires the standard generational collector." );
+
+  if (o->gc_info.use_card_marking &&
+      (o->gc_info.is_stopcopy_system || o->gc_info.is_regional_system ||
+       o->gc_info.use_non_predictive_collector))
+    param_error( "-cardrep requires the standard generational collector." );
+
+  if (o->gc_info.use_card_marking &&
+      strcmp( larceny_architecture, "SPARC" ) == 0)
+    param_error( "-cardrep is not supported by the SPARC write barrier." );
+
+  if (o->gc_info.pretenure_percent > 0 &&
+      (o->gc_info.is_stopcopy_system || o->gc_info.is_regional_system ||
+       o->gc_info.use_non_predictive_collector))
+    param_error( "-pretenure requires the standard generational collector." );
+
+  if (o->gc_info.pretenure_percent > 0 &&
+      strcmp( larceny_architecture, "IAssassin" ) != 0 &&
+      strcmp( larceny_architecture, "X86-NASM" ) != 0)
+    param_error( "-pretenure is supported only by the native x86 systems." );
+
+  if ((o->numa_node >= 0 || o->numa_interleave) && o->heap_arena == 0)
+    param_error( "-numa and -numa-interleave require -arena." );
+
+#if !OSDEP_HEAP_ARENA
+  if (o->heap_arena > 0)
+    param_error( "-arena is supported only on Linux." );
+#endif
+
+#if !OSDEP_PROTECT_ALIGNED
+  if (o->wxorx)
+    param_error( "-wxorx is supported only on Unix." );
+#endif
+
+#if !OSDEP_URING
+  if (o->io_uring)
+    param_error( "-io-uring is supported only on Linux." );
+#endif
+
+#if OSDEP_PREFORK
+  if (o->prefork > 0 &&
+      (o->gc_info.is_conservative_system || o->gc_info.gc_threads > 1 ||
+       o->gc_info.concurrent_mark || o->gc_info.concurrent_summarize))
+    param_error( "-prefork can't be used with collector threads "
+                 "or the conservative collector." );
+#else
+  if (o->prefork > 0)
+    param_error( "-prefork is supported only on Unix." );
+#endif
+
+  if (o->gc_info.concurrent_mark && !o->gc_info.is_regional_system)
+    param_error( "-concurrent-mark requires the regional collector." );
+
+  if (o->gc_info.concurrent_summarize && !o->gc_info.is_regional_system)
+    param_error( "-concurrent-summarize requires the regional collector." );
+
   /* TODO: double check logic in this case. */
   if (!o->gc_info.is_stopcopy_system && !o->gc_info.is_conservative_system &&
       !o->gc_info.is_regional_system
       && o->gc_info.ephemeral_info == 0)
     init_generational( o, areas, "*invalid*" );
 
-  if (o->gc_info.is_generational_system)
+  if (o->gc_info.is_generational_system && !o->gc_info.use_mark_compact)
     if (load_factor < 2.0)
       param_error( "Load factor must be at least 2.0" );
 
@@ -1165,6 +1312,13 @@ static void dump_options( opt_t *o )
   consolemsg( "Supremely annoying: %d", o->supremely_annoying );
   consolemsg( "Flush/noflush: %d/%d", o->flush, o->noflush );
   consolemsg( "Reorganize and dump: %d", o->reorganize_and_dump );
+  consolemsg( "Heap arena: %d (NUMA node %d, interleave %d)",
+              o->heap_arena, o->numa_node, o->numa_interleave );
+  consolemsg( "W^X: %d", o->wxorx );
+  consolemsg( "Mapped heap dumps: %d", o->gc_info.dump_mapped_heap );
+  consolemsg( "Prefork workers: %d", o->prefork );
+  consolemsg( "Stack batch: %d", o->stack_batch );
+  consolemsg( "io_uring: %d", o->io_uring );
   consolemsg( "" );
   if (o->gc_info.is_conservative_system) {
     consolemsg( "Using conservative garbage collector." );
@@ -1220,7 +1374,10 @@ static void dump_options( opt_t *o )
 #endif
     {
       sc_info_t *i = &o->gc_info.dynamic_sc_info;
-      consolemsg( "  Dynamic area (normal copying)" );
+      if (o->gc_info.use_mark_compact)
+        consolemsg( "  Dynamic area (mark-compact)" );
+      else
+        consolemsg( "  Dynamic area (normal copying)" );
       consolemsg( "    Size (bytes): %d", i->size_bytes );
       consolemsg( "    Inverse load factor: %f", i->load_factor );
       consolemsg( "    Min size: %d", i->dynamic_min );
@@ -1228,6 +1385,8 @@ static void dump_options( opt_t *o )
     }
     consolemsg( "  Using non-predictive dynamic area: %d",
                o->gc_info.use_non_predictive_collector );
+    consolemsg( "  Pretenuring survival rate: %d",
+                o->gc_info.pretenure_percent );
     consolemsg( "  Using static area: %d", o->gc_info.use_static_area );
   }
   else {
@@ -1346,6 +1505,10 @@ static char *wizardhelptext[] = {
   "     Use the stop-and-copy garbage collector." ,
   "  -gen",
   "     Use the standard generational collector.  This is the default.",
+  "  -mark-compact",
+  "     Use the generational collector with a dynamic area that is",
+  "     compacted in place instead of copied, so it needs no copy reserve.",
+  "     The load factor may then be less than 2.0.",
 #if ROF_COLLECTOR
   "  -rof",
   "     Use the hybrid renewal-oldest-first collector (experimental).",
@@ -1358,8 +1521,8 @@ static char *wizardhelptext[] = {
   "     to keep memory consumption below d*live, where live data",
   "     is computed or estimated following major collections.",
 #if !defined(BDW_GC)
-  "     The regional collector allows d to be less than 2.0.",
-  "     All of Larceny's other collectors require d to be at least 2.0.",
+  "     The regional collector and -mark-compact allow d to be less",
+  "     than 2.0.  Larceny's other collectors require d to be at least 2.0.",
   "     The default is 3.0.",
 #else
   "     In the conservative collector, d must be at least 1.0; no default is",
@@ -1492,6 +1655,72 @@ static char *wizardhelptext[] = {
   "     Use a hashtable (array) representation of the remembered set.",
   "  -rbitsrep",
   "     Use a bitmap (tree) representation of the remembered set.",
+  "  -rbucketrep",
+  "     Use a hashtable (array) representation of the remembered set",
+  "     whose tables are open-addressed in cache-line buckets.",
+  "  -cardrep",
+  "     Make the write barrier mark 512-byte cards instead of logging",
+  "     stores, and find the objects on marked cards at each collection.",
+  "     Requires the standard generational collector.",
+  "  -pretenure n",
+  "     Profile the allocation sites of compiled code, and allocate the",
+  "     objects of a site directly in the first ephemeral area once n",
+  "     percent of its sampled objects have survived their first",
+  "     collection.  Requires the standard generational collector and",
+  "     the native x86 system; code compiled with in-line allocation",
+  "     is not profiled.",
+  "  -gcthreads n",
+  "     Use n threads to copy objects during promotions and collections",
+  "     of the generational and stop-and-copy collectors, and to mark",
+  "     during the snapshot refinement cycles of the regional collector.",
+  "     The stop-and-copy collector also uses them when dumping the heap.",
+  "     The default is 1.  Parallel collection requires a runtime built",
+  "     with HAVE_PTHREADS; otherwise the option has no effect.",
+  "  -prefetch-scan",
+  "     Make the copying collectors prefetch the objects they are about",
+  "     to copy while scanning to-space.  The default is the plain",
+  "     breadth-first scan.",
+  "  -arena nnnn",
+  "     Reserve nnnn bytes of address space for the heap at startup, and",
+  "     commit it in 2MB chunks backed by huge pages.  Freed memory is",
+  "     returned to the system but its address space is kept.  Linux only.",
+  "  -numa n",
+  "     With -arena: bind the heap to NUMA node n.",
+  "  -numa-interleave",
+  "     With -arena: interleave the heap over all NUMA nodes.",
+  "  -wxorx",
+  "     Map less memory both writable and executable: the run-time",
+  "     system's own memory is not executable, and the code vectors of a",
+  "     split static heap are executable but read-only.  The rest of the",
+  "     static heap is writable but not executable.  The dynamic heap may",
+  "     hold new code and stays writable and executable, except in Petit",
+  "     Larceny, whose code is never in the heap.",
+  "  -mapped-heap",
+  "     Dump split heaps with page-aligned text and data areas, so that",
+  "     they are mapped from the file when loaded instead of read.",
+  "  -prefork n",
+  "     Load the heap image, then fork n worker processes that share its",
+  "     static area copy-on-write, and wait for them.  Each worker finds",
+  "     its index, from 0, in the environment variable LARCENY_WORKER.",
+  "     Not with -gcthreads, -concurrent-mark, or -concurrent-summarize.",
+  "  -stack-batch n",
+  "     Let one stack underflow restore up to n flushed frames.  The",
+  "     number restored starts at 1 after each continuation capture,",
+  "     throw, or collection, and doubles with each further underflow.",
+  "     The default is 1.",
+  "  -io-uring",
+  "     Read regular files ahead in 64KB blocks and write them behind,",
+  "     submitting each write at once, through io_uring.  Files",
+  "     opened for appending, or for both reading and writing, are not",
+  "     affected.  Ignored if the kernel does not support io_uring.",
+  "  -concurrent-mark",
+  "     For the regional collector only:  Do the snapshot marking on a",
+  "     background thread instead of during collector pauses.  Requires",
+  "     a runtime built with HAVE_PTHREADS.",
+  "  -concurrent-summarize",
+  "     For the regional collector only:  Construct summaries of the",
+  "     remembered sets on a background thread instead of during",
+  "     collector pauses.  Requires a runtime built with HAVE_PTHREADS.",
 #endif
   "  -ticks nnnn",
   "     Set the initial countdown timer interval value.",
@@ -1503,7 +1732,8 @@ static char *wizardhelptext[] = {
   "  -reorganize-and-dump",
   "     Split a heap image into text and data, and save the split heap in a",
   "     file. If Larceny is started with foo.heap, this command will create",
-  "     foo.heap.split.  The heap image is not executed.",
+  "     foo.heap.split.  The heap image is not executed.  The text area",
+  "     holds the code vectors, then the strings, then other bytevectors.",
 #endif
   "" ,
   "Values can be decimal, octal (0nnn), hex (0xnnn), or suffixed",
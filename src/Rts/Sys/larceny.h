@@ -80,6 +80,13 @@ struct opt {
   char       *r6program;        /* file containing R6RS top-level program */
   char       *r6path;           /* directories containing R6RS libraries */
   int        transcoder;        /* default transcoder */
+  int        heap_arena;        /* bytes of heap arena to reserve, or 0 */
+  int        numa_node;         /* NUMA node of the arena, or -1 */
+  bool       numa_interleave;   /* interleave the arena over all nodes */
+  bool       wxorx;             /* map less memory writable and executable */
+  int        prefork;           /* worker processes to fork, or 0 */
+  int        stack_batch;       /* most frames restored per underflow */
+  bool       io_uring;          /* batch file I/O with io_uring */
   int        restc;                     /* number of extra arguments */
   char       **restv;                   /* vector of extra arguments */
 };
@@ -117,6 +124,7 @@ extern int dump_dumped_heap( char *filename, gc_t *gc, word *globals );
 extern int  create_memory_manager( gc_param_t *params, int *generations );
 extern word *alloc_from_heap( int nbytes );
 extern word allocate_nonmoving( int length, int tag );
+extern word allocate_mapped( int fd, int page, int length );
 extern int  load_heap_image_from_file( const char *filename );
 extern int  dump_heap_image_to_file( const char *filename );
 extern int  reorganize_and_dump_static_heap( const char *filename );
@@ -180,6 +188,11 @@ extern void primitive_exit( word );
 extern void primitive_errno( void );
 extern void primitive_seterrno( word );
 extern void primitive_time( word );
+extern void primitive_sched_submit( word, word, word );
+extern void primitive_sched_next( word );
+extern void primitive_sched_result( void );
+extern void primitive_open_mapped( word, word );
+extern void primitive_map_file( word, word, word );
 #endif
 
 
@@ -9,22 +9,34 @@
  * before the normal object header.  The header contains a size field, a
  * pointer to a previous object, and a pointer to a next object.  The linked
  * list of objects is doubly linked, circular, with a header node.
+ *
+ * The pre-header also holds the offset of the object from the start of
+ * its pages.  The offset is the size of the pre-header except for an
+ * object allocated by los_allocate_mapped(), which is placed at the end
+ * of its first page so that the rest of its pages can map a file.  The
+ * mapping is replaced by ordinary memory before the pages are freed.
  */
 
 #include "larceny.h"
 #include "los_t.h"
 #include "gclib.h"
+#include "gc_workers_t.h"
 
 #define HEADER_WORDS     4	/* Number of header words */
-#define HEADER_UNUSED    -4     /* Unused field (could be mark?) */
+#define HEADER_START     -4     /* Offset of the object in its block */
 #define HEADER_SIZE      -3     /* Offset of size field */
 #define HEADER_NEXTP     -2	/* Offset of 'next' pointer */
 #define HEADER_PREVP     -1	/* Offset of 'previous' pointer */
 
+#define MAPPED           1      /* Flag in start field: pages map a file */
+
+#define start( x )        (((int*)(x))[ HEADER_START ])
 #define size( x )         (((int*)(x))[ HEADER_SIZE ])
 #define next( x )         (((word**)(x))[ HEADER_NEXTP ])
 #define prev( x )         (((word**)(x))[ HEADER_PREVP ])
+#define block( x )        ((word*)((byte*)(x) - (start( x ) & ~MAPPED)))
 
+#define set_start( a, b ) start(a)=b
 #define set_size( a, b )  size(a)=b
 #define set_next( a, b )  next(a)=b
 #define set_prev( a, b )  prev(a)=b
@@ -124,7 +136,7 @@ static int count_bytes_on_marklist( los_t *los, los_list_t *mark,
   rtn = 0;
   while ( p != h ) {
     n = next( p );
-    gen_no = gen_of( p - HEADER_WORDS );
+    gen_no = gen_of( block( p ) );
     assert2( 0 <= gen_no && gen_no < los->generations );
     if (match_gen_no == gen_no) {
       nbytes = size( p );
@@ -159,6 +171,7 @@ word *los_allocate( los_t *los, int nbytes, int gen_no )
   gclib_add_attribute( w, size, MB_LARGE_OBJECT );
 
   w += HEADER_WORDS;
+  set_start( w, HEADER_WORDS*sizeof(word) );
   set_size( w, size );
   insert_at_end( w, los->object_lists[ gen_no ] );
 
@@ -168,6 +181,39 @@ word *los_allocate( los_t *los, int nbytes, int gen_no )
   return w;
 }
 
+word *los_allocate_mapped( los_t *los, int nbytes, int gen_no, 
+			   int fd, long long offset )
+{
+#if OSDEP_MAP_FILE
+  word *b, *w;
+  int size;
+
+  assert( 0 <= gen_no && gen_no < los->generations );
+  assert( nbytes > LOS_MAPPED_LEAD && offset % PAGESIZE == 0 );
+
+  size = PAGESIZE + roundup_page( nbytes - LOS_MAPPED_LEAD );
+  b = gclib_alloc_heap( size, gen_no );
+  if (!osdep_map_file( (byte*)b + PAGESIZE, nbytes - LOS_MAPPED_LEAD,
+		       fd, offset )) {
+    gclib_free( b, size );
+    return 0;
+  }
+  gclib_add_attribute( b, size, MB_LARGE_OBJECT );
+
+  w = (word*)((byte*)b + PAGESIZE - LOS_MAPPED_LEAD);
+  set_start( w, (PAGESIZE - LOS_MAPPED_LEAD) | MAPPED );
+  set_size( w, size );
+  insert_at_end( w, los->object_lists[ gen_no ] );
+
+  supremely_annoyingmsg( "{LOS} Mapping large object size %d at 0x%08x", 
+			 size, w );
+
+  return w;
+#else
+  return 0;
+#endif
+}
+
 bool los_mark( los_t *los, los_list_t *marked, word *w, int gen_no )
 {
   word *p = prev( w );
@@ -202,29 +248,108 @@ bool los_mark_and_set_generation( los_t *los, los_list_t *marked, word *w,
   /* marked->bytes += size( w );  WRONG! -- insert_at_end does this too */
   insert_at_end( w, marked );
   set_prev( w, 0 );
-  gclib_set_generation( w - HEADER_WORDS, size( w ), to_gen );
+  gclib_set_generation( block( w ), size( w ), to_gen );
   return 0;
 }
 
 void los_sweep( los_t *los, int gen_no )
 {
-  word *p, *n, *h;
-  int nbytes;
+  los_sweep_gens( los, &gen_no, 1, 0 );
+}
 
-  assert( 0 <= gen_no && gen_no < los->generations );
+/* Sweeping is done in two steps.  First each list is walked and its
+   blocks are recorded in its own slice of one array; every block is at
+   least a page, so a list of b bytes needs at most b/PAGESIZE slots.
+   The lists can be walked in parallel because they are disjoint and
+   walking them does not touch the page tables.  Then the slices are
+   packed together and the blocks freed all at once.
+   */
 
-  h = los->object_lists[gen_no]->header;
-  p = next( h );
-  while ( p != h ) {
-    n = next( p );
-    remove( p );
-    nbytes = size( p );
-    gclib_free( p - HEADER_WORDS, nbytes );
+typedef struct sweep_data sweep_data_t;
+
+struct sweep_data {
+  los_t         *los;
+  int           *gen_nos;
+  int           n;
+  int           next_list;      /* Next list to claim */
+  gclib_block_t *blocks;
+  int           *first;         /* first[i]: start of list i's slice */
+  int           *count;         /* count[i]: blocks recorded by list i */
+};
+
+static void sweep_list( sweep_data_t *d, int i )
+{
+  word *p, *h;
+  gclib_block_t *b;
+  int k = 0;
+
+  h = d->los->object_lists[ d->gen_nos[i] ]->header;
+  b = d->blocks + d->first[i];
+  for ( p = next( h ) ; p != h ; p = next( p ) ) {
+    b[k].addr = block( p );
+    b[k].bytes = size( p );
+#if OSDEP_MAP_FILE
+    if (start( p ) & MAPPED)
+      osdep_unmap_file( (byte*)block( p ) + PAGESIZE, size( p ) - PAGESIZE );
+#endif
     supremely_annoyingmsg( "{LOS} Freeing large object %d bytes at 0x%08x",
-			   nbytes, (void*)p );
-    p = n;
+			   size( p ), (void*)p );
+    k++;
   }
-  clear_list( los->object_lists[ gen_no ] );
+  assert( k <= d->first[i+1] - d->first[i] );
+  d->count[i] = k;
+}
+
+static void sweep_worker( int id, void *data )
+{
+  sweep_data_t *d = (sweep_data_t*)data;
+  int i;
+
+  while ((i = gc_atomic_add( &d->next_list, 1 )) < d->n)
+    sweep_list( d, i );
+}
+
+void los_sweep_gens( los_t *los, int *gen_nos, int n, gc_workers_t *workers )
+{
+  sweep_data_t d;
+  int i, slots, nblocks;
+
+  d.los = los;
+  d.gen_nos = gen_nos;
+  d.n = n;
+  d.next_list = 0;
+  d.first = (int*)must_malloc( sizeof( int )*(n+1) );
+  d.count = (int*)must_malloc( sizeof( int )*n );
+
+  slots = 0;
+  for ( i=0 ; i < n ; i++ ) {
+    assert( 0 <= gen_nos[i] && gen_nos[i] < los->generations );
+    d.first[i] = slots;
+    slots += los->object_lists[ gen_nos[i] ]->bytes / PAGESIZE;
+  }
+  d.first[n] = slots;
+
+  if (slots > 0) {
+    d.blocks = (gclib_block_t*)must_malloc( sizeof( gclib_block_t )*slots );
+    if (workers != 0 && n > 1 && gc_workers_count( workers ) > 1)
+      gc_workers_run( workers, sweep_worker, &d );
+    else
+      sweep_worker( 0, &d );
+
+    nblocks = 0;
+    for ( i=0 ; i < n ; i++ ) {
+      memmove( d.blocks + nblocks, d.blocks + d.first[i], 
+	       sizeof( gclib_block_t )*d.count[i] );
+      nblocks += d.count[i];
+    }
+    gclib_free_blocks( d.blocks, nblocks );
+    free( d.blocks );
+  }
+
+  for ( i=0 ; i < n ; i++ )
+    clear_list( los->object_lists[ gen_nos[i] ] );
+  free( d.count );
+  free( d.first );
 }
 
 /* Appending a mark list implies cleaning up the gc marks (the prev() 
@@ -251,7 +376,7 @@ void los_append_and_clear_list_infer_gen( los_t *los, los_list_t *lst )
   p = next( h );
   while ( p != h ) {
     n = next( p );
-    gen_no = gen_of( p - HEADER_WORDS );
+    gen_no = gen_of( block( p ) );
     assert2( 0 <= gen_no && gen_no < los->generations );
     insert_at_end( p, los->object_lists[ gen_no ]);
     p = n;
@@ -341,7 +466,7 @@ static void set_generation_number( los_list_t *list, int gen_no, bool clear )
   this = next( header );
   prev = header;
   while (this != header) {
-    gclib_set_generation( this - HEADER_WORDS, size( this ), gen_no );
+    gclib_set_generation( block( this ), size( this ), gen_no );
     if (clear) 
       set_prev( this, prev );
     prev = this;
@@ -363,7 +488,7 @@ static void incr_generation_number_for( los_list_t *list, int fresh_gno )
   header = list->header;
   this = next( header );
   while (this != header) {
-    addr = this - HEADER_WORDS;
+    addr = block( this );
     gno = gen_of( addr );
     if ( gno >= fresh_gno ) {
       gclib_set_generation( addr, size( this ), gno+1 );
@@ -386,7 +511,7 @@ static void swap_generation_number_for( los_list_t *list, int gno1, int gno2 )
   header = list->header;
   this = next( header );
   while (this != header) {
-    addr = this - HEADER_WORDS;
+    addr = block( this );
     gno = gen_of( addr );
     if ( gno == gno1 ) {
       gclib_set_generation( addr, size( this ), gno2 );
@@ -438,7 +563,7 @@ static void dump_list( los_list_t *l, char *tag, int nbytes )
   consolemsg( "{LOS}   header at 0x%08x", l->header - HEADER_WORDS );
   fwd_n = fwd_size = 0;
   for ( p = next( l->header ) ; p != l->header ; p = next( p ) ) {
-    consolemsg( "{LOS}   > %d bytes at 0x%08x", size( p ), p - HEADER_WORDS );
+    consolemsg( "{LOS}   > %d bytes at 0x%08x", size( p ), block( p ) );
     fwd_n++;
     fwd_size += size( p );
   }
@@ -471,20 +596,20 @@ bool los_is_address_mapped( los_t *los, word *addr, bool noisy )
     do { 
       cursor = los_walk_list( los->object_lists[i], cursor );
       if (cursor != NULL) {
-	byte* start = (byte*)(cursor - HEADER_WORDS);
-	byte* finis = start + size(cursor);
-	if (((byte*)addr >= start) && ((byte*)addr < finis)) {
+	byte* first = (byte*)block( cursor );
+	byte* finis = first + size(cursor);
+	if (((byte*)addr >= first) && ((byte*)addr < finis)) {
 	  if (noisy)
 	    consolemsg("los_is_address_mapped los: 0x%08x addr: 0x%08x "
 		       "i: %d cursor: 0x%08x size: %d (range): [0x%08x,0x%08x) Y",
-		       los, addr, i, cursor, size(cursor), (void*)start, (void*)finis);
+		       los, addr, i, cursor, size(cursor), (void*)first, (void*)finis);
 	  
 	  assert(! ret); ret = TRUE;
 	} else {
 	  if (noisy)
 	    consolemsg("los_is_address_mapped los: 0x%08x addr: 0x%08x "
 		       "i: %d cursor: 0x%08x size: %d (range): [0x%08x,0x%08x) N",
-		       los, addr, i, cursor, size(cursor), (void*)start, (void*)finis);
+		       los, addr, i, cursor, size(cursor), (void*)first, (void*)finis);
 	}
       }
     } while (cursor != NULL);
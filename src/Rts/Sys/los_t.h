@@ -91,6 +91,22 @@ word *los_allocate( los_t *los, int nbytes, int gen_no );
      0 <= gen_no < los.generations
      */
 
+#define LOS_MAPPED_LEAD  8      /* Bytes before the mapped part */
+
+word *los_allocate_mapped( los_t *los, int nbytes, int gen_no,
+			   int fd, long long offset );
+  /* Like los_allocate(), but the object is placed so that its bytes
+     from LOS_MAPPED_LEAD on start a page, and those bytes are a private,
+     copy-on-write mapping of the open file fd from the given offset.
+     For a bytevector, the file's bytes thus start at index 4.  The
+     object is otherwise an ordinary large object; its pages are given
+     back ordinary memory when it is swept.  Returns NULL if the file
+     can't be mapped there, for instance if it is too short.
+
+     nbytes > LOS_MAPPED_LEAD
+     offset is a multiple of PAGESIZE
+     */
+
 bool los_mark( los_t *los, los_list_t *marked, word *w, int gen_no );
   /* Mark the block by moving it to the end of the 'marked' list, which
      should be a mark list, if it is not already on a mark list.  Returns
@@ -114,6 +130,15 @@ void los_sweep( los_t *los, int gen_no );
      0 <= gen_no < los.generations
      */
 
+void los_sweep_gens( los_t *los, int *gen_nos, int n, gc_workers_t *workers );
+  /* Like los_sweep() on each of the n generations in gen_nos.  The lists
+     are walked first, in parallel if workers is not 0, and then all the
+     blocks are freed together by gclib_free_blocks(), which returns
+     adjacent blocks to the operating system as one.
+
+     0 <= gen_nos[i] < los.generations, and the gen_nos are distinct
+     */
+
 void los_append_and_clear_list( los_t *los, los_list_t *l, int to_gen );
   /* Append the list to the list of to_gen, and clear the list.
      The generation numbers on the pages of the appended objects
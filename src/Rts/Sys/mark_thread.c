@@ -0,0 +1,244 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- background thread for snapshot marking.
+ *
+ * See mark_thread_t.h for the interface.
+ *
+ * The mark thread holds the mark lock while it runs a slice.  The
+ * mutator pauses it by raising pause_requested and taking the lock;
+ * the mark thread checks the flag between slices and waits on the
+ * condition variable, releasing the lock, until the flag is lowered.
+ *
+ * The handoff queue is a lock-free stack of blocks of SATB entries.
+ * The mutator is the only producer; the consumer (the mark thread, or
+ * the mutator while the mark thread is paused) takes the whole stack
+ * at once.  The mark thread is not woken when entries are queued, so
+ * the mutator's side of the SATB barrier never blocks; an idle mark
+ * thread picks them up when it is next resumed.
+ */
+
+#define GC_INTERNAL
+
+#include <string.h>
+#include "larceny.h"
+#include "gc_t.h"
+#include "smircy.h"
+#include "gc_workers_t.h"
+#include "mark_thread_t.h"
+
+#if defined(HAVE_PTHREADS)
+# include <pthread.h>
+#endif
+
+typedef struct handoff_block handoff_block_t;
+
+struct handoff_block {
+  handoff_block_t *next;
+  int count;
+  word entries[1];              /* Really count entries */
+};
+
+struct mark_thread {
+  gc_t *gc;
+  int slice_budget;
+  int depth;                    /* Pause nesting depth; mutator only */
+  bool complete;                /* Snapshot complete; written when paused */
+  handoff_block_t * volatile handoff;
+#if defined(HAVE_PTHREADS)
+  pthread_t thread;
+  pthread_mutex_t lock;         /* Held by whoever may touch the context */
+  pthread_cond_t cond;
+  volatile int pause_requested;
+  volatile int stop_requested;
+#endif
+};
+
+/* Pushes queued entries onto the marking context.  The caller holds
+   the mark lock. */
+
+static void drain_handoff( mark_thread_t *mt )
+{
+  handoff_block_t *b, *next;
+  gc_t *gc = mt->gc;
+
+  do {
+    b = mt->handoff;
+  } while (b != NULL && !gc_atomic_cas( &mt->handoff, b, NULL ));
+
+  for ( ; b != NULL ; b = next ) {
+    next = b->next;
+    if (gc->smircy != NULL && !mt->complete)
+      smircy_push_elems( gc->smircy, b->entries, b->entries + b->count );
+    free( b );
+  }
+}
+
+#if defined(HAVE_PTHREADS)
+static bool has_work( mark_thread_t *mt )
+{
+  gc_t *gc = mt->gc;
+
+  return (gc->smircy != NULL && !mt->complete
+          && (mt->handoff != NULL || !smircy_stack_empty_p( gc->smircy )));
+}
+
+static void *mark_thread_main( void *p )
+{
+  mark_thread_t *mt = (mark_thread_t*)p;
+  int marked, traced, words_marked, misc;
+
+  pthread_mutex_lock( &mt->lock );
+  while (!mt->stop_requested) {
+    while (!mt->stop_requested && (mt->pause_requested || !has_work( mt )))
+      pthread_cond_wait( &mt->cond, &mt->lock );
+    if (mt->stop_requested)
+      break;
+    drain_handoff( mt );
+    smircy_progress( mt->gc->smircy,
+                     mt->slice_budget, mt->slice_budget, mt->slice_budget,
+                     SMIRCY_MISC_BOUND,
+                     &marked, &traced, &words_marked, &misc );
+  }
+  pthread_mutex_unlock( &mt->lock );
+  return 0;
+}
+#endif
+
+mark_thread_t *create_mark_thread( gc_t *gc, int slice_budget )
+{
+#if defined(HAVE_PTHREADS)
+  mark_thread_t *mt;
+
+  mt = (mark_thread_t*)must_malloc( sizeof( mark_thread_t ) );
+  mt->gc = gc;
+  mt->slice_budget = slice_budget;
+  mt->depth = 0;
+  mt->complete = FALSE;
+  mt->handoff = NULL;
+  mt->pause_requested = 0;
+  mt->stop_requested = 0;
+  pthread_mutex_init( &mt->lock, 0 );
+  pthread_cond_init( &mt->cond, 0 );
+  if (pthread_create( &mt->thread, 0, mark_thread_main, mt ) != 0) {
+    consolemsg( "Could not create the mark thread; "
+                "marking incrementally." );
+    pthread_cond_destroy( &mt->cond );
+    pthread_mutex_destroy( &mt->lock );
+    free( mt );
+    return 0;
+  }
+  annoyingmsg( "Created mark thread; slice budget %d.", slice_budget );
+  return mt;
+#else
+  consolemsg( "Concurrent marking is not supported in this configuration; "
+              "marking incrementally." );
+  return 0;
+#endif
+}
+
+void mark_thread_pause( mark_thread_t *mt )
+{
+  if (mt->depth++ > 0)
+    return;
+#if defined(HAVE_PTHREADS)
+  mt->pause_requested = 1;
+  gc_memory_barrier();
+  pthread_mutex_lock( &mt->lock );
+#endif
+  drain_handoff( mt );
+}
+
+void mark_thread_resume( mark_thread_t *mt )
+{
+  assert( mt->depth > 0 );
+  if (--mt->depth > 0)
+    return;
+#if defined(HAVE_PTHREADS)
+  mt->pause_requested = 0;
+  pthread_cond_broadcast( &mt->cond );
+  pthread_mutex_unlock( &mt->lock );
+#endif
+}
+
+void mark_thread_stop( mark_thread_t *mt )
+{
+#if defined(HAVE_PTHREADS)
+  if (mt->depth == 0) {
+    mt->pause_requested = 1;
+    gc_memory_barrier();
+    pthread_mutex_lock( &mt->lock );
+  }
+  mt->stop_requested = 1;
+  pthread_cond_broadcast( &mt->cond );
+  pthread_mutex_unlock( &mt->lock );
+  pthread_join( mt->thread, 0 );
+  pthread_cond_destroy( &mt->cond );
+  pthread_mutex_destroy( &mt->lock );
+#endif
+  drain_handoff( mt );
+  free( mt );
+}
+
+bool mark_thread_paused_p( mark_thread_t *mt )
+{
+  return mt->depth > 0;
+}
+
+void mark_thread_lock( mark_thread_t *mt )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_lock( &mt->lock );
+#endif
+}
+
+void mark_thread_unlock( mark_thread_t *mt )
+{
+#if defined(HAVE_PTHREADS)
+  pthread_mutex_unlock( &mt->lock );
+#endif
+}
+
+void mark_thread_satb( mark_thread_t *mt, word *bot, word *top )
+{
+  gc_t *gc = mt->gc;
+  handoff_block_t *b, *head;
+  int count = top - bot;
+
+  if (count == 0 || gc->smircy == NULL || mt->complete)
+    return;
+
+  if (mt->depth > 0) {
+    smircy_push_elems( gc->smircy, bot, top );
+    return;
+  }
+
+  b = (handoff_block_t*)
+    must_malloc( sizeof( handoff_block_t ) + (count-1)*sizeof( word ) );
+  b->count = count;
+  memcpy( b->entries, bot, count*sizeof( word ) );
+  do {
+    head = mt->handoff;
+    b->next = head;
+  } while (!gc_atomic_cas( &mt->handoff, head, b ));
+}
+
+void mark_thread_begin_snapshot( mark_thread_t *mt )
+{
+  assert( mt->depth > 0 );
+  assert( mt->gc->smircy != NULL );
+  smircy_set_concurrent( mt->gc->smircy );
+  mt->complete = FALSE;
+}
+
+bool mark_thread_snapshot_complete_p( mark_thread_t *mt )
+{
+  assert( mt->depth > 0 );
+  drain_handoff( mt );
+  if (mt->gc->smircy != NULL && smircy_stack_empty_p( mt->gc->smircy ))
+    mt->complete = TRUE;
+  return mt->complete;
+}
+
+/* eof */
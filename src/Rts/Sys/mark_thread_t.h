@@ -0,0 +1,84 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- background thread for snapshot marking.
+ *
+ * With -concurrent-mark, the regional collector advances its snapshot
+ * marking context (gc->smircy) on a dedicated thread instead of in
+ * slices of the collector's pauses.
+ *
+ * The mark thread and the mutator share the heap, the marking context,
+ * the remembered set, and the region groups.  The mutator therefore
+ * pauses the mark thread around every entry into the collector that
+ * can touch them (collections, incremental work, remembered set
+ * buffer compaction, allocation).  Pauses are cheap when the mark
+ * thread is idle and bounded by the length of one marking slice
+ * otherwise.  The contexts that the mark thread advances must have
+ * been made concurrent with smircy_set_concurrent().
+ *
+ * The mutator hands the contents of its SATB buffer to the mark thread
+ * through a lock-free queue.  Entries on the queue are not known to the
+ * collector, so the mutator drains the queue into the marking context
+ * whenever it pauses the mark thread.
+ */
+
+#ifndef INCLUDED_MARK_THREAD_T_H
+#define INCLUDED_MARK_THREAD_T_H
+
+#include "config.h"
+#include "larceny-types.h"
+
+mark_thread_t *create_mark_thread( gc_t *gc, int slice_budget );
+  /* Creates and starts the mark thread for gc.  Each slice of marking
+     traces at most slice_budget objects, words, and arcs.  Returns 0
+     if threads are not supported.
+     */
+
+void mark_thread_pause( mark_thread_t *mt );
+void mark_thread_resume( mark_thread_t *mt );
+  /* Called by the mutator only.  Pauses nest; while the mark thread is
+     paused it does not touch the heap or the marking context.  When
+     the outermost pause returns, handed-off entries have been drained
+     into gc->smircy.
+     */
+
+void mark_thread_stop( mark_thread_t *mt );
+  /* Called by the mutator only, paused or not.  Waits for the current
+     marking slice to finish, then stops and joins the mark thread and
+     frees mt.  Entries still queued are pushed onto gc->smircy, which
+     the collector can go on advancing incrementally.
+     */
+
+bool mark_thread_paused_p( mark_thread_t *mt );
+  /* Called by the mutator only.  TRUE if the mark thread is paused.
+     */
+
+void mark_thread_lock( mark_thread_t *mt );
+void mark_thread_unlock( mark_thread_t *mt );
+  /* Called by other collector threads only; the mutator pauses instead.
+     Waits for the current marking slice to finish and keeps the mark
+     thread from starting another until mark_thread_unlock is called.
+     */
+
+void mark_thread_satb( mark_thread_t *mt, word *bot, word *top );
+  /* Called by the mutator only, with the contents of the SATB buffer.
+     If the mark thread is running the entries are queued for it
+     without blocking; if it is paused they are pushed onto gc->smircy.
+     Entries are dropped once the snapshot is complete.
+     */
+
+void mark_thread_begin_snapshot( mark_thread_t *mt );
+  /* requires: mark thread is paused.
+     Called when a new marking context has been installed in gc->smircy.
+     */
+
+bool mark_thread_snapshot_complete_p( mark_thread_t *mt );
+  /* requires: mark thread is paused and the SATB buffer has been
+     processed since the pause began.
+     Returns TRUE, and remembers the fact, if no marking work remains.
+     */
+
+#endif /* INCLUDED_MARK_THREAD_T_H */
+
+/* eof */
@@ -0,0 +1,786 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- mark-compact dynamic area.
+ *
+ * This is an alternative to the stop-and-copy dynamic area in
+ * old-heap.c for the generational collector.  Promotion is the same:
+ * live objects in the younger areas are copied into the area's
+ * semispace.  A full collection instead promotes everything into the
+ * area and then marks and slides the area in place, so the area never
+ * needs the copy reserve that a stop-and-copy collection of it would.
+ *
+ * A full collection has four phases.
+ *
+ *  - Mark.  The whole heap is marked from the roots with msgc-core,
+ *    giving one bit for the first doubleword of each live object.
+ *
+ *  - Plan.  The live objects of the area are assigned new addresses.
+ *    They keep their order and slide towards the start of the first
+ *    chunk of the semispace; an object that does not fit in what is
+ *    left of a chunk moves on to the next one.  The new addresses are
+ *    recorded in a block offset table with one entry per 256-byte
+ *    block of the heap, which is the part of the heap covered by one
+ *    word of the mark bitmap.  The entry holds the new address of the
+ *    first live object that starts in the block, and the objects that
+ *    start in a block are kept together, so the new address of any
+ *    live object is found from its block's entry and the sizes of the
+ *    live objects before it in the block.  Bytevector-like objects are
+ *    kept 16-byte aligned, as forward() in cheney.c keeps them, by two
+ *    words of padding where needed; the padding is determined by the
+ *    new address, so it is found the same way.
+ *
+ *  - Update.  Every pointer into the area held by a root, a live
+ *    object in the area, a large object of the area, or an object in
+ *    the static area is replaced by the new address of its referent.
+ *    Dead static objects may still point to dead objects in the area;
+ *    those pointers are replaced by #f so that the static area can be
+ *    scanned safely later.
+ *
+ *  - Move.  The live objects are slid to their new addresses in
+ *    address order, and the chunks that end up empty are freed.  Dead
+ *    large objects of the area are freed.
+ *
+ * Objects only ever move to lower addresses within a chunk or into an
+ * earlier chunk, so the move never overwrites an object that has not
+ * been moved yet.
+ *
+ * Large objects do not move, and the area is the oldest collected
+ * area, so when the collection is done nothing younger points into
+ * the area and its remembered set is cleared.
+ */
+
+#define GC_INTERNAL
+
+#include <string.h>
+#include "larceny.h"
+#include "memmgr.h"
+#include "gc.h"
+#include "gc_t.h"
+#include "gset_t.h"
+#include "region_group_t.h"
+#include "old_heap_t.h"
+#include "static_heap_t.h"
+#include "semispace_t.h"
+#include "los_t.h"
+#include "gclib.h"
+#include "msgc-core.h"
+#include "stats.h"
+#include "gc_mmu_log.h"
+#include "uremset_t.h"
+#include "bitmap.h"
+
+extern void mem_icache_flush( void *lo, void *limit );
+
+#if defined(BITS_32)
+# define BLOCK_SHIFT       8    /* log2 of bytes covered by a bitmap word */
+# define DW_IN_BLOCK       32   /* doublewords covered by a bitmap word */
+#else
+# error "Must define mark-compact block macros for non-32 bit systems."
+#endif
+
+typedef struct mc_data mc_data_t;
+typedef struct mc_env mc_env_t;
+
+struct mc_data {
+  stats_id_t  self;
+  int         gen_no;             /* Generation and heap number */
+  semispace_t *current_space;     /* Space to promote into and compact */
+
+  /* Policy */
+  int         size_bytes;         /* Initial size */
+  int         lower_limit;        /* 0 or lower limit on expandable area */
+  int         upper_limit;        /* 0 or upper limit on expandable area */
+  int         target_size;        /* Current size */
+  double      load_factor;
+  bool        must_clear_remset;  /* Clear remset after collection */
+
+  int         promoted_last_gc;   /* For policy use */
+
+  gen_stats_t gen_stats;          /* accumulates collections and time */
+  gc_stats_t  gc_stats;           /* accumulates words copied/moved */
+  gc_event_stats_t event_stats;   /* Instrumentation data */
+};
+
+/* State of one full collection */
+struct mc_env {
+  gc_t           *gc;
+  int            gen_no;
+  msgc_context_t *context;
+  word           *bitmap;         /* The context's mark bitmap */
+  word           *lowest;         /* Address covered by bitmap[0] */
+  int            first_block;     /* Bitmap index of fwd[0] */
+  int            nblocks;         /* Length of fwd */
+  word           **fwd;           /* Block offset table */
+};
+
+#define DATA(x)  ((mc_data_t*)((x)->data))
+
+static old_heap_t *allocate_heap( int gen_no, gc_t *gc );
+static void perform_collect( old_heap_t *heap );
+static void perform_promote( old_heap_t *heap );
+static int  compute_dynamic_size( old_heap_t *heap, int live, int los );
+static int  used_space( old_heap_t *heap );
+static void start_timers( stats_id_t *timer1, stats_id_t *timer2 );
+static void stop_timers( bool is_promotion,
+                         old_heap_t *heap,
+                         int bytes_copied, int bytes_moved,
+                         stats_id_t *timer1, stats_id_t *timer2 );
+
+old_heap_t *
+create_mc_dynamic_area( int gen_no, gc_t *gc, sc_info_t *info )
+{
+  old_heap_t *heap;
+  mc_data_t *data;
+
+  assert( info->size_bytes > 0 );
+
+  heap = allocate_heap( gen_no, gc );
+  data = DATA(heap);
+
+  data->current_space = create_semispace( GC_CHUNK_SIZE, gen_no );
+  data->size_bytes = roundup_page( info->size_bytes );
+  data->load_factor = info->load_factor;
+  data->lower_limit = info->dynamic_min;
+  data->upper_limit = info->dynamic_max;
+  data->target_size =
+    compute_dynamic_size( heap, data->size_bytes/data->load_factor, 0 );
+
+  heap->maximum = data->target_size;
+  heap->allocated = 0;
+
+  return heap;
+}
+
+static void collect( old_heap_t *heap, gc_type_t request )
+{
+  gc_t *gc = heap->collector;
+  mc_data_t *data = DATA(heap);
+  int alloc;
+
+  annoyingmsg( "Mark-compact area: garbage collection." );
+
+  alloc = gc_allocated_to_areas( gc, gset_range( 0, data->gen_no ));
+
+  supremely_annoyingmsg( "  alloc=%d  size=%d  used=%d",
+                         alloc, data->target_size, used_space( heap ) );
+
+  data->must_clear_remset = 1;
+  if (request == GCTYPE_PROMOTE &&
+      alloc <= data->target_size - used_space( heap ))
+    perform_promote( heap );
+  else {
+    perform_collect( heap );
+    ss_sync( data->current_space );
+    data->target_size =
+      compute_dynamic_size( heap,
+                            data->current_space->used,
+                            los_bytes_used( gc->los, data->gen_no ) );
+  }
+
+  annoyingmsg( "Collection finished." );
+}
+
+/* Marked objects */
+
+static int object_bytes( word *p )
+{
+  word w = *p;
+
+  if (ishdr( w ))
+    return roundup8( sizefield( w ) + 4 );
+  else
+    return 2*sizeof(word);
+}
+
+/* Returns the bitmap index of the block containing p. */
+static int block_of( mc_env_t *e, word *p )
+{
+  return (int)(((word)p - (word)e->lowest) >> BLOCK_SHIFT);
+}
+
+static word *block_start( mc_env_t *e, int k )
+{
+  return (word*)((word)e->lowest + ((word)k << BLOCK_SHIFT));
+}
+
+/* Returns the new address of the object at p if the previous live
+   object ends at dest.  A bytevector-like object gets two words of
+   padding if dest is only 2-word aligned, unless it is not moving,
+   so that no object ever moves up.
+   */
+static byte *place( byte *dest, word *p )
+{
+  word h = *p;
+
+  if (ishdr( h ) && header( h ) == BV_HDR &&
+      ((word)dest & 0xF) == 0x8 && dest != (byte*)p)
+    return dest + 2*sizeof(word);
+  return dest;
+}
+
+/* Returns the address where the live objects among the first n that
+   start in block k end after sliding, if the first of them goes to
+   dest or above.
+   */
+static byte *slide( mc_env_t *e, int k, int n, byte *dest )
+{
+  word bits = e->bitmap[k];
+  word *start = block_start( e, k );
+  int j;
+
+  for ( j = 0 ; j < n ; j++ )
+    if (bits & (1 << j))
+      dest = place( dest, start + 2*j ) + object_bytes( start + 2*j );
+  return dest;
+}
+
+/* Calls f on each marked object that starts in [bot,lim), in address
+   order.  Bit i of the bitmap is the doubleword at lowest+2*i.
+   */
+static void walk_marked( mc_env_t *e, word *bot, word *lim,
+                         void (*f)( mc_env_t *e, word *p, void *data ),
+                         void *data )
+{
+  int bit, lim_bit;
+
+  bit = (int)((bot - e->lowest) / 2);
+  lim_bit = (int)((lim - e->lowest + 1) / 2);
+  for ( bit = bitmap_next_set( e->bitmap, bit, lim_bit ) ;
+        bit < lim_bit ;
+        bit = bitmap_next_set( e->bitmap, bit+1, lim_bit ) )
+    f( e, e->lowest + 2*bit, data );
+}
+
+/* Plan */
+
+typedef struct {
+  semispace_t *ss;
+  int         dest_chunk;         /* Chunk being filled */
+  word        *dest;              /* Next free word in that chunk */
+  word        **new_top;          /* Top of each chunk after the move */
+} plan_t;
+
+static void plan_chunk( mc_env_t *e, plan_t *pl, int i )
+{
+  ss_chunk_t *src = &pl->ss->chunks[i];
+  int k, klim;
+  byte *end;
+
+  klim = block_of( e, src->top-1 ) + 1;
+  for ( k = block_of( e, src->bot ) ; k < klim ; k++ ) {
+    if (e->bitmap[k] == 0)
+      continue;
+
+    /* Keep the objects that start in this block together; moving on
+       from chunk dest_chunk at most reaches chunk i, where they fit at
+       or below where they are. */
+    end = slide( e, k, DW_IN_BLOCK, (byte*)pl->dest );
+    while (pl->dest_chunk < i &&
+           (pl->ss->chunks[pl->dest_chunk].bytes == 0 ||
+            end > (byte*)pl->ss->chunks[pl->dest_chunk].lim)) {
+      pl->dest_chunk++;
+      pl->dest = pl->ss->chunks[pl->dest_chunk].bot;
+      end = slide( e, k, DW_IN_BLOCK, (byte*)pl->dest );
+    }
+    assert( pl->dest_chunk < i || end <= (byte*)src->top );
+
+    e->fwd[ k - e->first_block ] = pl->dest;
+    pl->dest = (word*)end;
+    pl->new_top[ pl->dest_chunk ] = pl->dest;
+  }
+}
+
+/* Update */
+
+static word *forward( mc_env_t *e, word *p )
+{
+  int k = block_of( e, p );
+  int bit = (int)(((word)p - (word)block_start( e, k )) >> 3);
+  byte *dest = (byte*)e->fwd[ k - e->first_block ];
+
+  assert( e->bitmap[k] & (1 << bit) );
+  return (word*)place( slide( e, k, bit, dest ), p );
+}
+
+static bool points_into_area( mc_env_t *e, word w )
+{
+  return (isptr( w ) &&
+          gen_of( w ) == e->gen_no &&
+          !(attr_of( w ) & MB_LARGE_OBJECT));
+}
+
+/* A referent that is not marked can only be seen from a dead object. */
+static void update_loc( mc_env_t *e, word *loc )
+{
+  word w = *loc;
+
+  if (points_into_area( e, w )) {
+    if (msgc_object_marked_p( e->context, w ))
+      *loc = (word)forward( e, ptrof( w ) ) | tagof( w );
+    else
+      *loc = FALSE_CONST;
+  }
+}
+
+static void update_root( word *loc, void *data )
+{
+  update_loc( (mc_env_t*)data, loc );
+}
+
+static void update_object( mc_env_t *e, word *p, void *data )
+{
+  word w = *p;
+  int words, i;
+
+  if (ishdr( w )) {
+    if (header( w ) == BV_HDR)
+      return;
+    words = sizefield( w ) >> 2;
+    for ( i = 1 ; i <= words ; i++ )
+      update_loc( e, p+i );
+  }
+  else {
+    update_loc( e, p );
+    update_loc( e, p+1 );
+  }
+}
+
+static void *update_static_object( word *addr, int tag, void *accum )
+{
+  update_object( (mc_env_t*)accum, addr, 0 );
+  return accum;
+}
+
+static void update_los_list( mc_env_t *e, los_list_t *list, bool live_only )
+{
+  word *p;
+
+  for ( p = los_walk_list( list, NULL ) ; p != NULL ;
+        p = los_walk_list( list, p ) )
+    if (!live_only || msgc_object_marked_p( e->context, (word)p ))
+      update_object( e, p, 0 );
+}
+
+/* Move */
+
+/* Moving an object may overwrite its own old header, so forward()
+   cannot be used once a block has started to move; instead the new
+   addresses are recomputed with a running cursor.  The header of each
+   object is intact until the object itself is moved.
+   */
+static void move_chunk( mc_env_t *e, word *bot, word *lim )
+{
+  int k, klim, j, bytes;
+  word bits, h, *start, *p;
+  byte *dest, *to;
+
+  klim = block_of( e, lim-1 ) + 1;
+  for ( k = block_of( e, bot ) ; k < klim ; k++ ) {
+    bits = e->bitmap[k];
+    if (bits == 0)
+      continue;
+    start = block_start( e, k );
+    dest = (byte*)e->fwd[ k - e->first_block ];
+    for ( j = 0 ; j < DW_IN_BLOCK ; j++ ) {
+      if (!(bits & (1 << j)))
+        continue;
+      p = start + 2*j;
+      h = *p;
+      bytes = object_bytes( p );
+      to = place( dest, p );
+      if (to != dest) {
+        ((word*)dest)[0] = 0;
+        ((word*)dest)[1] = 0;
+      }
+      if (to != (byte*)p) {
+        memmove( to, p, bytes );
+        if (ishdr( h ) && header( h ) == BV_HDR && typetag( h ) == BVEC_SUBTAG)
+          mem_icache_flush( to, to + bytes );
+      }
+      dest = to + bytes;
+    }
+  }
+}
+
+static void sweep_large_objects( mc_env_t *e )
+{
+  los_t *los = e->gc->los;
+  los_list_t *list = los->object_lists[ e->gen_no ];
+  los_list_t *marked = create_los_list();
+  word *p, *next;
+
+  for ( p = los_walk_list( list, NULL ) ; p != NULL ; p = next ) {
+    next = los_walk_list( list, p );
+    if (msgc_object_marked_p( e->context, (word)p ))
+      los_mark( los, marked, p, e->gen_no );
+  }
+  los_sweep( los, e->gen_no );
+  los_append_and_clear_list( los, marked, e->gen_no );
+  los_free_list( marked );
+}
+
+static void mark_compact( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+  semispace_t *ss = data->current_space;
+  gc_t *gc = heap->collector;
+  mc_env_t e;
+  plan_t pl;
+  word *lo, *hi;
+  int i, marked=0, traced=0, words_marked=0;
+
+  ss_sync( ss );
+
+  e.gc = gc;
+  e.gen_no = data->gen_no;
+  e.context = msgc_begin( gc );
+  msgc_mark_objects_from_roots( e.context, &marked, &traced, &words_marked );
+  e.bitmap = msgc_bitmap( e.context, &e.lowest );
+
+  /* The block offset table covers the chunks of the area. */
+  lo = hi = 0;
+  for ( i = 0 ; i <= ss->current ; i++ ) {
+    if (ss->chunks[i].bytes == 0)
+      continue;
+    if (lo == 0 || ss->chunks[i].bot < lo) lo = ss->chunks[i].bot;
+    if (hi == 0 || ss->chunks[i].lim > hi) hi = ss->chunks[i].lim;
+  }
+  if (lo == 0) {
+    sweep_large_objects( &e );
+    msgc_end( e.context );
+    return;
+  }
+  e.first_block = block_of( &e, lo );
+  e.nblocks = block_of( &e, hi-1 ) + 1 - e.first_block;
+  e.fwd = (word**)must_malloc( e.nblocks*sizeof(word*) );
+
+  pl.ss = ss;
+  pl.dest_chunk = 0;
+  pl.dest = ss->chunks[0].bot;
+  pl.new_top = (word**)must_malloc( (ss->current+1)*sizeof(word*) );
+  for ( i = 0 ; i <= ss->current ; i++ ) {
+    pl.new_top[i] = ss->chunks[i].bot;
+    if (ss->chunks[i].bytes > 0 && ss->chunks[i].top > ss->chunks[i].bot)
+      plan_chunk( &e, &pl, i );
+  }
+
+  gc_enumerate_roots( gc, update_root, &e );
+  for ( i = 0 ; i <= ss->current ; i++ )
+    if (ss->chunks[i].bytes > 0 && ss->chunks[i].top > ss->chunks[i].bot)
+      walk_marked( &e, ss->chunks[i].bot, ss->chunks[i].top,
+                   update_object, 0 );
+  update_los_list( &e, gc->los->object_lists[ e.gen_no ], TRUE );
+  if (gc->static_area) {
+    static_heap_t *s = gc->static_area;
+    int sgen = s->data_area ? s->data_area->gen_no : -1;
+
+    if (s->data_area)
+      ss_enumerate( s->data_area, update_static_object, &e );
+    if (sgen >= 0)
+      update_los_list( &e, gc->los->object_lists[ sgen ], FALSE );
+  }
+
+  for ( i = 0 ; i <= ss->current ; i++ )
+    if (ss->chunks[i].bytes > 0 && ss->chunks[i].top > ss->chunks[i].bot)
+      move_chunk( &e, ss->chunks[i].bot, ss->chunks[i].top );
+  sweep_large_objects( &e );
+
+  /* Chunks past the last one filled are released; so are any chunks
+     before it that were skipped. */
+  for ( i = 0 ; i <= ss->current ; i++ )
+    if (ss->chunks[i].bytes > 0)
+      ss->chunks[i].top = (i <= pl.dest_chunk ? pl.new_top[i]
+                                              : ss->chunks[i].bot);
+  ss->current = pl.dest_chunk;
+  ss_free_unused_chunks( ss );
+  for ( i = ss->current-1 ; i >= 0 ; i-- )
+    if (ss->chunks[i].bytes > 0 && ss->chunks[i].top == ss->chunks[i].bot)
+      ss_free_block( ss, i );
+  ss_sync( ss );
+
+  free( pl.new_top );
+  free( e.fwd );
+  msgc_end( e.context );
+
+  supremely_annoyingmsg( "  Mark-compact: %d objects marked, %d words.",
+                         marked, words_marked );
+}
+
+static void perform_collect( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+  stats_id_t timer1, timer2;
+  int used_before;
+
+  annoyingmsg( "  Collecting generation %d in place.", data->gen_no );
+
+  start_timers( &timer1, &timer2 );
+
+  ss_sync( data->current_space );
+  used_before = data->current_space->used;
+
+  gc_phase_shift( heap->collector, gc_log_phase_misc_memmgr, gc_log_phase_majorgc );
+  gclib_stopcopy_promote_into( heap->collector, data->current_space );
+  mark_compact( heap );
+  gc_phase_shift( heap->collector, gc_log_phase_majorgc, gc_log_phase_misc_memmgr );
+
+  data->gen_stats.collections++;
+  stop_timers( FALSE, heap,
+               max( data->current_space->used - used_before, 0 ),
+               los_bytes_used( heap->collector->los, data->gen_no ),
+               &timer1, &timer2 );
+}
+
+static void perform_promote( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+  int used_before, tospace_before, los_before;
+  stats_id_t timer1, timer2;
+
+  annoyingmsg( "  Promoting into generation %d.", data->gen_no );
+
+  if (data->gen_no == 1)
+    gc_signal_minor_collection( heap->collector );
+
+  start_timers( &timer1, &timer2 );
+
+  used_before = used_space( heap );
+  ss_sync( data->current_space );
+  tospace_before = data->current_space->used;
+  los_before = los_bytes_used( heap->collector->los, data->gen_no );
+
+  gc_phase_shift( heap->collector, gc_log_phase_misc_memmgr, gc_log_phase_minorgc );
+  gclib_stopcopy_promote_into( heap->collector, data->current_space );
+  gc_phase_shift( heap->collector, gc_log_phase_minorgc, gc_log_phase_misc_memmgr );
+
+  data->promoted_last_gc = used_space( heap ) - used_before;
+
+  data->gen_stats.promotions++;
+  stop_timers( TRUE, heap,
+               data->current_space->used - tospace_before,
+               los_bytes_used(heap->collector->los, data->gen_no)-los_before,
+               &timer1, &timer2 );
+}
+
+static void start_timers( stats_id_t *timer1, stats_id_t *timer2 ) {
+  *timer1 = stats_start_timer( TIMER_ELAPSED );
+  *timer2 = stats_start_timer( TIMER_CPU );
+}
+
+static void stop_timers( bool is_promotion,
+                         old_heap_t *heap,
+                         int bytes_copied, int bytes_moved,
+                         stats_id_t *timer1, stats_id_t *timer2 ) {
+  int ms;
+  int ms_cpu;
+  mc_data_t *data = DATA(heap);
+
+  data->gc_stats.words_copied = bytes2words( bytes_copied );
+  data->gc_stats.words_moved = bytes2words( bytes_moved );
+
+  ms = stats_stop_timer( *timer1 );
+  ms_cpu = stats_stop_timer( *timer2 );
+  heap->collector->stat_last_ms_gc_cheney_pause = ms;
+  heap->collector->stat_last_ms_gc_cheney_pause_cpu = ms_cpu;
+  if (is_promotion) {
+    data->gen_stats.ms_promotion += ms;
+    data->gen_stats.ms_promotion_cpu += ms_cpu;
+    heap->collector->stat_last_gc_pause_ismajor = 0;
+  } else {
+    data->gen_stats.ms_collection += ms;
+    data->gen_stats.ms_collection_cpu += ms_cpu;
+    heap->collector->stat_last_gc_pause_ismajor = 1;
+  }
+  data->gc_stats.max_ms_cheney_collection =
+    max( data->gc_stats.max_ms_cheney_collection, ms );
+  data->gc_stats.max_ms_cheney_collection_cpu =
+    max( data->gc_stats.max_ms_cheney_collection_cpu, ms_cpu );
+#if GC_EVENT_COUNTERS
+  data->event_stats.copied_by_gc += bytes2words( bytes_copied );
+  data->event_stats.moved_by_gc  += bytes2words( bytes_moved );
+#endif
+}
+
+static void before_collection( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+
+  data->must_clear_remset = 0;
+  heap->maximum = data->target_size;
+  heap->allocated = used_space( heap );
+}
+
+static void after_collection( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+
+  if (data->must_clear_remset)
+    urs_clear( heap->collector->the_remset, data->gen_no );
+
+  heap->allocated = used_space( heap );
+  annoyingmsg( "  Generation %d: Size=%d, Live=%d, Remset live=%d.",
+               data->gen_no, data->target_size, heap->allocated,
+               urs_live_count( heap->collector->the_remset, data->gen_no ));
+}
+
+static void stats( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+
+  ss_sync( data->current_space );
+
+  data->gen_stats.target = bytes2words( data->target_size );
+  data->gen_stats.allocated =
+    bytes2words(data->current_space->allocated +
+                los_bytes_used( heap->collector->los, data->gen_no ));
+  data->gen_stats.used = bytes2words(used_space( heap ));
+
+  stats_add_gen_stats( data->self, &data->gen_stats );
+  stats_add_gc_stats( &data->gc_stats );
+  stats_set_gc_event_stats( &data->event_stats );
+  urs_checkpoint_stats( heap->collector->the_remset, data->gen_no );
+
+  memset( &data->gen_stats, 0, sizeof( gen_stats_t ) );
+  memset( &data->gc_stats, 0, sizeof( gc_stats_t ) );
+}
+
+static word *data_load_area( old_heap_t *heap, int nbytes )
+{
+  mc_data_t *data = DATA( heap );
+  int n;
+
+  assert( nbytes > 0 );
+  assert( nbytes % BYTE_ALIGNMENT == 0 );
+
+  n = ss_allocate_and_insert_block( data->current_space, nbytes );
+  return data->current_space->chunks[ n ].bot;
+}
+
+/* Internal */
+
+static int compute_dynamic_size( old_heap_t *heap, int D, int Q )
+{
+  static_heap_t *s = heap->collector->static_area;
+  int S = (s ? s->data_area->allocated : 0);
+  double L = DATA(heap)->load_factor;
+
+  return gc_compute_dynamic_size( heap->collector,
+                                  D, S, Q, L,
+                                  DATA(heap)->lower_limit,
+                                  DATA(heap)->upper_limit );
+}
+
+static int used_space( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+
+  ss_sync( data->current_space );
+  return data->current_space->used +
+           los_bytes_used( heap->collector->los, data->gen_no );
+}
+
+static void set_gen_no( old_heap_t *heap, int gen_no )
+{
+  DATA(heap)->gen_no = gen_no;
+  ss_set_gen_no( DATA(heap)->current_space, gen_no );
+}
+
+static semispace_t *current_space( old_heap_t *heap )
+{
+  return DATA(heap)->current_space;
+}
+
+static void assimilate( old_heap_t *heap, semispace_t *ss )
+{
+  ss_assimilate( DATA(heap)->current_space, ss );
+}
+
+static void *enumerate( old_heap_t *heap,
+                        void *(*visitor)( word *addr, int tag, void *accum ),
+                        void *accum_init )
+{
+  void *accum = accum_init;
+  los_list_t *list = heap->collector->los->object_lists[ DATA(heap)->gen_no ];
+  word *cursor;
+
+  accum = ss_enumerate( DATA(heap)->current_space, visitor, accum );
+  for ( cursor = los_walk_list( list, NULL ) ; cursor != NULL ;
+        cursor = los_walk_list( list, cursor ) ) {
+    word w = *cursor;
+    if (header(w) == BV_HDR)
+      accum = visitor( cursor, BVEC_TAG, accum );
+    else if (header(w) == VEC_HDR)
+      accum = visitor( cursor, VEC_TAG, accum );
+    else if (header(w) == header(PROC_HDR))
+      accum = visitor( cursor, PROC_TAG, accum );
+  }
+  return accum;
+}
+
+static bool is_address_mapped( old_heap_t *heap, word *addr, bool noisy )
+{
+  return ss_is_address_mapped( DATA(heap)->current_space, addr, noisy );
+}
+
+static void synchronize( old_heap_t *heap )
+{
+  mc_data_t *data = DATA(heap);
+
+  heap->maximum = data->target_size;
+  ss_sync( data->current_space );
+  heap->allocated = data->current_space->used +
+    los_bytes_used_include_marklists( heap->collector->los, data->gen_no );
+}
+
+static old_heap_t *allocate_heap( int gen_no, gc_t *gc )
+{
+  old_heap_t *heap;
+  mc_data_t *data;
+
+  data = (mc_data_t*)must_malloc( sizeof( mc_data_t ) );
+  heap = create_old_heap_t( "mc/variable",
+                            HEAPCODE_OLD_2SPACE,
+                            0,                    /* initialize */
+                            collect,
+                            0,                    /* collect_into */
+                            before_collection,
+                            after_collection,
+                            stats,
+                            data_load_area,
+                            0,                    /* load_prepare */
+                            0,                    /* load_data */
+                            0,                    /* set_policy */
+                            set_gen_no,
+                            current_space,
+                            assimilate,
+                            enumerate,
+                            is_address_mapped,
+                            synchronize,
+                            data );
+  heap->collector = gc;
+  {
+    static int total_gens = 0;
+    data->self = stats_new_generation( gen_no, total_gens++ );
+  }
+  data->gen_no = gen_no;
+  data->promoted_last_gc = 0;
+  data->load_factor = 0.0;
+  data->target_size = 0;
+  data->must_clear_remset = 0;
+  memset( &data->gen_stats, 0, sizeof( gen_stats_t ) );
+  memset( &data->gc_stats, 0, sizeof( gc_stats_t ) );
+  memset( &data->event_stats, 0, sizeof( gc_event_stats_t ) );
+
+  heap->group = region_group_nonrrof;
+  heap->prev_in_group = NULL;
+  heap->next_in_group = NULL;
+
+  heap->incoming_words.summarizer = 0;
+  heap->incoming_words.marker = 0;
+
+  return heap;
+}
+
+/* eof */
@@ -40,6 +40,12 @@ const char *larceny_gc_technology = "precise";
 #include "uremset_array_t.h"
 #include "uremset_debug_t.h"
 #include "uremset_extbmp_t.h"
+#include "uremset_cards_t.h"
+#include "pretenure_t.h"
+#include "gc_workers_t.h"
+#include "mark_thread_t.h"
+#include "summ_thread_t.h"
+#include "bitmap.h"
 #include "math.h"
 
 #include "memmgr_flt.h"
@@ -89,6 +95,7 @@ gc_t *create_gc( gc_param_t *info, int *generations )
            info->is_regional_system) == 1 );
 
   gclib_init();
+  bitmap_init();
   gc = alloc_gc_structure( info->globals, info );
 
   /* Number of generations includes static heap, if any */
@@ -321,11 +328,16 @@ static int initialize( gc_t *gc )
       return 0;
 
   if (data->is_partitioned_system) {
+#if GCLIB_SPARSE_TABLE
+    wb_setup( (gclib_desc_t*)gclib_dir_g,
+              (byte*)0,
+#else
     wb_setup( gclib_desc_g,
 #if GCLIB_LARGE_TABLE
               (byte*)0,
 #else
               (byte*)gclib_pagebase,
+#endif
 #endif
               data->generations,
               data->globals,
@@ -584,6 +596,8 @@ static void smircy_start( gc_t *gc )
   }
   gc->smircy = smircy_begin_opt( gc, gc->gno_count, 
                                  DATA(gc)->rrof_alloc_mark_bmp_once );
+  if (DATA(gc)->mark_thread != NULL)
+    mark_thread_begin_snapshot( DATA(gc)->mark_thread );
   assert( DATA(gc)->globals[G_CONCURRENT_MARK] == 0 );
   DATA(gc)->globals[G_CONCURRENT_MARK] = 1;
   { int i; 
@@ -1013,6 +1027,26 @@ static void summarization_step( gc_t *gc, bool about_to_major )
   SUMMMTX_VERIFICATION_POINT(gc);
 }
 
+/* One slice of the summarization thread; see summ_thread_t.h.  Returns
+ * FALSE if no summarization wave is in progress. */
+static bool summarization_slice( gc_t *gc )
+{
+  bool progress, completed_cycle;
+
+  if (DATA(gc)->summaries == NULL)
+    return FALSE;
+
+  progress = sm_construction_concurrent( DATA(gc)->summaries,
+                                         DATA(gc)->rrof_next_region,
+                                         nonempty_region_count( gc ),
+                                         &completed_cycle );
+  if (completed_cycle) {
+    annoyingmsg( "COMPLETED SUMMARIZATION CYCLE (on summarization thread)" );
+    rrof_completed_summarization_cycle( gc );
+  }
+  return progress;
+}
+
 static void initiate_refinement_during_summarization( gc_t *gc )
 {
   { 
@@ -1072,6 +1106,16 @@ typedef enum {
   smircy_step_dont_refine, smircy_step_can_refine, smircy_step_must_refine
 } smircy_step_finish_mode_t;
 
+/* With a mark thread the mark stack can run empty while SATB entries
+ * are still queued for it, so ask the mark thread. */
+static bool smircy_snapshot_complete_p( gc_t *gc )
+{
+  if (DATA(gc)->mark_thread != NULL)
+    return mark_thread_snapshot_complete_p( DATA(gc)->mark_thread );
+  else
+    return smircy_stack_empty_p( gc->smircy );
+}
+
 static void smircy_step( gc_t *gc, smircy_step_finish_mode_t finish_mode ) 
 {
   stats_id_t timer1, timer2;
@@ -1115,14 +1159,16 @@ static void smircy_step( gc_t *gc, smircy_step_finish_mode_t finish_mode )
     /* See also the help message in larceny.c */
     bound = 5 * bound;
 #endif
-    smircy_progress( gc->smircy, bound, bound, bound, SMIRCY_MISC_BOUND,
-                     &marked_recv, &traced_recv, &words_marked_recv,
-                     &misc_recv );
+    /* The mark thread, if any, does the marking. */
+    if (DATA(gc)->mark_thread == NULL)
+      smircy_progress( gc->smircy, bound, bound, bound, SMIRCY_MISC_BOUND,
+                       &marked_recv, &traced_recv, &words_marked_recv,
+                       &misc_recv );
   }
 
   SMIRCY_VERIFICATION_POINT(gc);
 
-  if (smircy_stack_empty_p( gc->smircy )) {
+  if (smircy_snapshot_complete_p( gc )) {
     int words_marked;
     words_marked = smircy_words_marked( gc->smircy );
 
@@ -1137,7 +1183,7 @@ static void smircy_step( gc_t *gc, smircy_step_finish_mode_t finish_mode )
 
   if ((finish_mode == smircy_step_must_refine) 
       || ((finish_mode == smircy_step_can_refine) 
-          && smircy_stack_empty_p( gc->smircy ))) {
+          && smircy_snapshot_complete_p( gc ))) {
   start_timers( &timer1, &timer2 );
 #if INCREMENTAL_REFINE_DURING_SUMZ
     initiate_refinement( gc );
@@ -1178,6 +1224,8 @@ static void initialize_summaries( gc_t *gc, bool about_to_major )
                         DATA(gc)->rrof_sumz_params.coverage_inv,
                         DATA(gc)->rrof_sumz_params.budget_inv,
                         DATA(gc)->rrof_sumz_params.max_retries );
+  if (DATA(gc)->summ_thread != NULL)
+    sm_set_concurrent( DATA(gc)->summaries );
 
   DATA(gc)->mutator_effort.satb_ssb_entries_flushed_this.sumz_cycle = 0;
   DATA(gc)->mutator_effort.rrof_ssb_entries_flushed_this.sumz_cycle = 0;
@@ -2224,7 +2272,8 @@ static void incremental_rgnl_activity( gc_t *gc )
   stats_id_t timer1, timer2;
   bool summarization_active;
 
-  if (DATA(gc)->summaries == NULL)
+  /* The summarization thread does this work, if there is one. */
+  if (DATA(gc)->summaries == NULL || DATA(gc)->summ_thread != NULL)
     return;
 
   before_incremental( gc );
@@ -2409,6 +2458,9 @@ static void before_collection( gc_t *gc )
   if (gc->satb_ssb != NULL) 
     process_seqbuf( gc, gc->satb_ssb );
 
+  if (gc->pretenure != NULL)
+    pretenure_before_collection( gc->pretenure );
+
   DATA(gc)->rrof_currently_minor_gc = FALSE;
 
   yh_before_collection( gc->young_area );
@@ -2435,6 +2487,10 @@ static void after_collection( gc_t *gc )
 {
   int e;
 
+  /* Before the nursery is reused for the stack */
+  if (gc->pretenure != NULL)
+    pretenure_after_collection( gc->pretenure );
+
   DATA(gc)->generations = DATA(gc)->generations_after_gc;
 
   DATA(gc)->mutator_effort.forcing_collector_to_progress = FALSE;
@@ -2733,6 +2789,20 @@ static void enumerate_hdr_address_ranges( gc_t *gc,
                     t1 - t0, iterations ); /* FIXME */
     }
   }
+  else if (gno-1 == DATA(gc)->ephemeral_area_count &&
+           DATA(gc)->dynamic_area != NULL &&
+           !DATA(gc)->use_np_collector) {
+    word *p;
+
+    ss_enumerate_hdr_ranges( oh_current_space( DATA(gc)->dynamic_area ), 
+                             f, d );
+    p = NULL;
+    do {
+      p = los_walk_list( gc->los->object_lists[gno], p );
+      if (p != NULL) 
+        f( p, p+1, d );
+    } while (p != NULL);
+  }
   {
     if (gc->static_area != NULL && 
         (gno == DATA(gc)->static_generation)) {
@@ -2949,6 +3019,8 @@ static int compact_all_ssbs( gc_t *gc )
     top = *gc->ssb[i]->top;
     overflowed = process_seqbuf( gc, gc->ssb[i] ) || overflowed;
   }
+  if (DATA(gc)->use_card_marking)
+    overflowed = uremset_cards_scan( gc->the_remset ) || overflowed;
 
   if (force_progress) {
     force_collector_to_make_progress( gc );
@@ -2962,8 +3034,35 @@ static void np_remset_ptrs( gc_t *gc, word ***ssbtop, word ***ssblim )
   assert(0);
 }
 
+/* The threads are stopped and joined before the heap is dumped, after
+ * which the collector marks and summarizes incrementally, and when the
+ * process exits.  The summarization thread is stopped first, as it
+ * takes the mark thread's lock.
+ */
+
+static gc_t *gc_with_threads = 0;
+
+static void stop_collector_threads( gc_t *gc )
+{
+  if (DATA(gc)->summ_thread != NULL) {
+    summ_thread_stop( DATA(gc)->summ_thread );
+    DATA(gc)->summ_thread = NULL;
+  }
+  if (DATA(gc)->mark_thread != NULL) {
+    mark_thread_stop( DATA(gc)->mark_thread );
+    DATA(gc)->mark_thread = NULL;
+  }
+}
+
+static void stop_collector_threads_at_exit( void )
+{
+  if (gc_with_threads != 0)
+    stop_collector_threads( gc_with_threads );
+}
+
 static int dump_image( gc_t *gc, const char *filename, bool compact )
 {
+  stop_collector_threads( gc );
   if (DATA(gc)->is_partitioned_system) 
     return dump_generational_system( gc, filename, compact );
   else
@@ -3002,9 +3101,16 @@ static int dump_stopcopy_system( gc_t *gc, const char *filename, bool compact )
   if (compact)
     compact_all_areas( gc );
 
-  type = (gc->static_area ? HEAP_SPLIT : HEAP_SINGLE);
+  if (!gc->static_area)
+    type = HEAP_SINGLE;
+  else if (DATA(gc)->dump_mapped_heap)
+    type = HEAP_MAPPED;
+  else
+    type = HEAP_SPLIT;
   heap = create_heapio();
   if ((r = hio_create( heap, filename, type )) < 0) goto fail;
+  if (gc->workers)
+    hio_dump_workers( heap, gc->workers );
 
   /* Dump an existing text area as the text area, and the existing data
      and young areas together as the data area.  Therefore, when the
@@ -3212,6 +3318,7 @@ static void expand_remset_gnos( gc_t *gc, int fresh_gno )
                    &new_ssb_bot[fresh_gno], &new_ssb_top[fresh_gno], 
                    &new_ssb_lim[fresh_gno], ssb_process_rrof, 
                    /* XXX */(void*) fresh_gno );
+  seqbuf_set_batched( new_ssb[fresh_gno], TRUE );
   for( i = fresh_gno+1; i < new_gno_count; i++ ) {
     new_ssb[i] = gc->ssb[i-1];
     seqbuf_swap_in_ssb( gc->ssb[i-1], 
@@ -3663,7 +3770,9 @@ static int ssb_process_satb( gc_t *gc, word *bot, word *top, void *ep_data ) {
 #endif
     }
   }
-  if (gc->smircy != NULL) {
+  if (DATA(gc)->mark_thread != NULL) {
+    mark_thread_satb( DATA(gc)->mark_thread, bot, top );
+  } else if (gc->smircy != NULL) {
     if (! smircy_stack_empty_p( gc->smircy )) {
       smircy_push_elems( gc->smircy, bot, top );
     }
@@ -3677,14 +3786,10 @@ static int ssb_process_rrof( gc_t *gc, word *bot, word *top, void *ep_data )
   int g_rhs;
   word *p, *q, w;
 
-  /* XXX this is not really right; there may be duplicate entries in
-   * the SSB, and in principle we are supposed to only count the
-   * number of distinct locations assigned.
-   * 
-   * But I do not carry enough information around to know about all
-   * duplicate entries... at best for now I can count locations added
-   * for a *subset* of the regions (via the summary set addittions)
-   * and/or I can count the *objects* added to the remembered set...
+  /* We are supposed to count only the number of distinct locations
+   * assigned.  The batch is deduplicated (see seqbuf_set_batched), so
+   * this is right within one batch; a location that is assigned again
+   * after its buffer was processed is still counted twice.
    */
 
   update_rrof_flush_counts( gc, (top - bot) );
@@ -3807,6 +3912,11 @@ static int allocate_generational_system( gc_t *gc, gc_param_t *info )
     panic_exit( "ROF collector not compiled in" );
 #endif
   }
+  else if (info->use_mark_compact) {
+    DATA(gc)->dynamic_area = 
+      create_mc_dynamic_area( gen_no, gc, &info->dynamic_sc_info );
+    gen_no += 1;
+  }
   else {
     DATA(gc)->dynamic_area = 
       create_sc_area( gen_no, gc, &info->dynamic_sc_info, OHTYPE_DYNAMIC );
@@ -3841,9 +3951,26 @@ static int allocate_generational_system( gc_t *gc, gc_param_t *info )
     gc->the_remset = alloc_uremset_array( gc, info );
   } else if (info->chose_rbitsrep) {
     gc->the_remset = alloc_uremset_extbmp( gc, info );
+  } else if (info->chose_rbucketrep) {
+    rs_use_bucketed_tables( TRUE );
+    gc->the_remset = alloc_uremset_array( gc, info );
   } else {
     gc->the_remset = alloc_uremset_array( gc, info );
   }
+  if (info->use_card_marking) {
+    gc->the_remset = alloc_uremset_cards( gc->the_remset );
+    data->use_card_marking = TRUE;
+  }
+  if (info->pretenure_percent > 0) {
+    old_heap_t *target = (data->ephemeral_area_count > 0 ?
+                          data->ephemeral_area[ 0 ] : data->dynamic_area);
+    if (target != 0 && target->current_space != 0) {
+      gc->pretenure = create_pretenure( gc, target, info->pretenure_percent );
+      data->globals[ G_PRETENURE ] = 1;
+    }
+    else
+      consolemsg( "Pretenuring is not supported by this dynamic area." );
+  }
 
   data->ssb_bot = (word**)must_malloc( sizeof(word*)*gc->gno_count );
   data->ssb_top = (word**)must_malloc( sizeof(word*)*gc->gno_count );
@@ -3859,6 +3986,7 @@ static int allocate_generational_system( gc_t *gc, gc_param_t *info )
       create_seqbuf( DATA(gc)->ssb_entry_count, 
                      &data->ssb_bot[i], &data->ssb_top[i], &data->ssb_lim[i],
                      ssb_process_gen, 0 );
+    seqbuf_set_batched( gc->ssb[i], TRUE );
   }
   gc->satb_ssb = NULL;
 
@@ -4020,6 +4148,9 @@ static int allocate_regional_system( gc_t *gc, gc_param_t *info )
       gc->the_remset = alloc_uremset_array( gc, info );
     } else if (info->chose_rbitsrep) {
       gc->the_remset = alloc_uremset_extbmp( gc, info );
+    } else if (info->chose_rbucketrep) {
+      rs_use_bucketed_tables( TRUE );
+      gc->the_remset = alloc_uremset_array( gc, info );
     } else {
       gc->the_remset = alloc_uremset_extbmp( gc, info );
     }
@@ -4038,6 +4169,7 @@ static int allocate_regional_system( gc_t *gc, gc_param_t *info )
         create_seqbuf( DATA(gc)->ssb_entry_count, 
                        &data->ssb_bot[i], &data->ssb_top[i], &data->ssb_lim[i],
                        ssb_process_rrof, 0 );
+      seqbuf_set_batched( gc->ssb[i], TRUE );
     }
     gc->satb_ssb = create_seqbuf( DATA(gc)->ssb_entry_count, 
                                   &data->satb_ssb_bot, 
@@ -4068,6 +4200,17 @@ static int allocate_regional_system( gc_t *gc, gc_param_t *info )
     if (0) consolemsg("initial mark countdown: %d", countdown_to_first_mark );
   }
   data->rrof_alloc_mark_bmp_once = info->alloc_mark_bmp_once;
+  data->mark_thread = 0;
+  if (info->concurrent_mark)
+    data->mark_thread = create_mark_thread( gc, CONCURRENT_MARK_SLICE );
+  data->summ_thread = 0;
+  if (info->concurrent_summarize)
+    data->summ_thread = 
+      create_summ_thread( gc, summarization_slice, data->mark_thread );
+  if (data->mark_thread != NULL || data->summ_thread != NULL) {
+    gc_with_threads = gc;
+    atexit( stop_collector_threads_at_exit );
+  }
 
   data->oracle_countdown = info->oracle_countdown;
 
@@ -4133,6 +4276,100 @@ static void check_invariants_between_fwd_and_free( gc_t *gc, int gen_no )
   return;
 }
 
+/* With -concurrent-mark or -concurrent-summarize, the entry points by
+ * which the mutator reaches the parts of the collector that the
+ * background threads also use (the heap and page table, the remembered
+ * set, the region groups, the mark context, and the summaries) pause
+ * those threads.  The summarization thread is paused first; see
+ * summ_thread.c.
+ */
+
+static void pause_collector_threads( gc_t *gc )
+{
+  if (DATA(gc)->summ_thread != NULL)
+    summ_thread_pause( DATA(gc)->summ_thread );
+  if (DATA(gc)->mark_thread != NULL)
+    mark_thread_pause( DATA(gc)->mark_thread );
+}
+
+static void resume_collector_threads( gc_t *gc )
+{
+  if (DATA(gc)->mark_thread != NULL)
+    mark_thread_resume( DATA(gc)->mark_thread );
+  if (DATA(gc)->summ_thread != NULL)
+    summ_thread_resume( DATA(gc)->summ_thread );
+}
+
+static word *allocate_concurrent( gc_t *gc, int nbytes, bool no_gc, 
+                                  bool atomic )
+{
+  word *p;
+
+  pause_collector_threads( gc );
+  p = allocate( gc, nbytes, no_gc, atomic );
+  resume_collector_threads( gc );
+  return p;
+}
+
+static void collect_rgnl_concurrent( gc_t *gc, int rgn, int bytes_needed, 
+                                     gc_type_t request )
+{
+  pause_collector_threads( gc );
+  collect_rgnl( gc, rgn, bytes_needed, request );
+  resume_collector_threads( gc );
+}
+
+static void incremental_rgnl_concurrent( gc_t *gc )
+{
+  pause_collector_threads( gc );
+  incremental_rgnl( gc );
+  resume_collector_threads( gc );
+}
+
+static int compact_all_ssbs_concurrent( gc_t *gc )
+{
+  int overflowed;
+
+  pause_collector_threads( gc );
+  overflowed = compact_all_ssbs( gc );
+  resume_collector_threads( gc );
+  return overflowed;
+}
+
+/* The static area and the load areas take their memory from the page
+ * allocator, which can replace the page table under the threads. */
+
+static word *allocate_nonmoving_concurrent( gc_t *gc, int nbytes, 
+                                            bool atomic )
+{
+  word *p;
+
+  pause_collector_threads( gc );
+  p = allocate_nonmoving( gc, nbytes, atomic );
+  resume_collector_threads( gc );
+  return p;
+}
+
+static word *data_load_area_concurrent( gc_t *gc, int size_bytes )
+{
+  word *p;
+
+  pause_collector_threads( gc );
+  p = data_load_area( gc, size_bytes );
+  resume_collector_threads( gc );
+  return p;
+}
+
+static word *text_load_area_concurrent( gc_t *gc, int size_bytes )
+{
+  word *p;
+
+  pause_collector_threads( gc );
+  p = text_load_area( gc, size_bytes );
+  resume_collector_threads( gc );
+  return p;
+}
+
 /*     Allocates and initializes the gc structure.
  *     Collector-specific initialization comes later.
  */
@@ -4146,12 +4383,31 @@ static gc_t *alloc_gc_structure( word *globals, gc_param_t *info )
   void (*my_collect)( gc_t *gc, int rgn, int bytes_needed, gc_type_t request );
   void (*my_incremental)( gc_t *gc );
   void (*my_check_remset_invs)( gc_t *gc, word src, word tgt );
+  word *(*my_allocate)( gc_t *gc, int nbytes, bool no_gc, bool atomic );
+  int (*my_compact_all_ssbs)( gc_t *gc );
+  word *(*my_allocate_nonmoving)( gc_t *gc, int nbytes, bool atomic );
+  word *(*my_data_load_area)( gc_t *gc, int size_bytes );
+  word *(*my_text_load_area)( gc_t *gc, int size_bytes );
   
+  my_allocate = allocate;
+  my_compact_all_ssbs = compact_all_ssbs;
+  my_allocate_nonmoving = allocate_nonmoving;
+  my_data_load_area = data_load_area;
+  my_text_load_area = text_load_area;
   if (info->is_regional_system) {
     my_find_space = find_space_rgnl;
     my_collect = collect_rgnl;
     my_incremental = incremental_rgnl;
     my_check_remset_invs = check_remset_invs_rgnl;    
+    if (info->concurrent_mark || info->concurrent_summarize) {
+      my_allocate = allocate_concurrent;
+      my_collect = collect_rgnl_concurrent;
+      my_incremental = incremental_rgnl_concurrent;
+      my_compact_all_ssbs = compact_all_ssbs_concurrent;
+      my_allocate_nonmoving = allocate_nonmoving_concurrent;
+      my_data_load_area = data_load_area_concurrent;
+      my_text_load_area = text_load_area_concurrent;
+    }
   } else {
     my_find_space = find_space_expanding;
     my_collect = collect_generational;
@@ -4164,6 +4420,8 @@ static gc_t *alloc_gc_structure( word *globals, gc_param_t *info )
   data->globals = globals;
   data->is_partitioned_system = 0;
   data->shrink_heap = 0;
+  data->use_card_marking = FALSE;
+  data->dump_mapped_heap = info->dump_mapped_heap;
   data->in_gc = 0;
   data->handles = (word*)must_malloc( sizeof(word)*10 );
   data->nhandles = 10;
@@ -4280,20 +4538,20 @@ static gc_t *alloc_gc_structure( word *globals, gc_param_t *info )
     create_gc_t( "*invalid*",
                  (void*)data,
                  initialize, 
-                 allocate,
-                 allocate_nonmoving,
+                 my_allocate,
+                 my_allocate_nonmoving,
                  make_room,
                  my_collect,
                  my_incremental,
                  set_policy,
-                 data_load_area,
-                 text_load_area,
+                 my_data_load_area,
+                 my_text_load_area,
                  iflush,
                  creg_get,
                  creg_set,
                  stack_overflow,
                  stack_underflow,
-                 compact_all_ssbs,
+                 my_compact_all_ssbs,
 #if defined(SIMULATE_NEW_BARRIER)
                  isremembered,
 #endif
@@ -4322,6 +4580,9 @@ static gc_t *alloc_gc_structure( word *globals, gc_param_t *info )
                  check_invariants_between_fwd_and_free
                  );
   ret->scan_update_remset = info->is_regional_system;
+  ret->scan_prefetch = info->prefetch_scan;
+  if (info->gc_threads > 1)
+    ret->workers = create_gc_workers( info->gc_threads );
 
   zeroed_promotion_counts( ret );
 
@@ -94,6 +94,14 @@ ohsc_data_area( old_heap_t *heap );
      (It is not necessarily legal to expand the returned space.)
      */
 
+/* In mc-heap.c */
+
+old_heap_t *
+create_mc_dynamic_area( int gen_no, gc_t *gc, sc_info_t *info );
+  /* Create a dynamic area that is collected by mark-compact rather
+     than by copying.  For the generational system only.
+     */
+
 /* In np-sc-heap.c */
 
 old_heap_t *
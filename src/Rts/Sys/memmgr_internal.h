@@ -19,6 +19,8 @@ struct gc_data {
   bool fixed_ephemeral_area;    /* True iff ephemeral_area_count is invariant */
   bool remset_undirected;       /* Regional (vs gen'l directed remsets) */
   bool mut_activity_bounded;    /* True for RROF alone (for now). */
+  bool use_card_marking;        /* True if the barrier marks cards */
+  bool dump_mapped_heap;        /* True if split heaps are dumped mapped */
 
   int  dynamic_min;		/* 0 or lower limit of expandable area */
   int  dynamic_max;		/* 0 or upper limit of expandable area */
@@ -105,6 +107,12 @@ struct gc_data {
     /* Allocate one bitmap to cover *entire* addr range at outset. 
      * (band-aid for hack of expanding bitmap on the fly during 
      *  cheney object forwards). */
+  mark_thread_t *mark_thread;
+    /* In RROF collector with -concurrent-mark, the thread that advances
+     * the snapshot mark; 0 if marking is incremental. */
+  summ_thread_t *summ_thread;
+    /* In RROF collector with -concurrent-summarize, the thread that
+     * constructs summaries; 0 if summarization is incremental. */
   int rrof_refine_mark_period;
   int rrof_refine_mark_countdown;
     /* In RROF collector, #nursery evacuations until refine remset via mark.
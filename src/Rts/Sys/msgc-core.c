@@ -20,6 +20,7 @@
 #include "static_heap_t.h" /* for sh_is_address_mapped */
 #include "remset_t.h"
 #include "uremset_t.h"
+#include "bitmap.h"
 
 #define LARGE_OBJECT_LIMIT 1024 /* elements */
 
@@ -491,6 +492,12 @@ bool msgc_object_marked_p( msgc_context_t *context, word obj )
   return (context->bitmap[ word_idx ] & bit);
 }
 
+word *msgc_bitmap( msgc_context_t *context, word **lowest_recv )
+{
+  *lowest_recv = context->lowest_heap_address;
+  return context->bitmap;
+}
+
 void msgc_mark_range( msgc_context_t *context, void *bot, void *lim )
 {
   unsigned bit_idx_lo, word_idx_lo, bit_idx_hi, word_idx_hi;
@@ -572,7 +579,7 @@ msgc_context_t *msgc_begin_range( gc_t *gc, caddr_t lowest, caddr_t highest )
   context->stopped_on_obj = 0x0;
   context->stopped_on_src = 0x0;
 
-  memset( context->bitmap, 0, context->words_in_bitmap*sizeof(word) );
+  bitmap_clear( context->bitmap, 0, context->words_in_bitmap*BITS_IN_WORD );
   context->stack.seg = 0;
   context->stack.stkp = 0;
   context->stack.stkbot = 0;
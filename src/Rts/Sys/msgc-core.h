@@ -90,6 +90,15 @@ extern bool msgc_object_marked_p( msgc_context_t *context, word obj );
      arbitrary address) in the heap.  Returns TRUE iff the object
      is marked in the bitmap.
      */
+
+extern word *msgc_bitmap( msgc_context_t *context, word **lowest_recv );
+  /* Returns the mark bitmap and stores the address it starts at in
+     *lowest_recv.  Bit i of word k covers the doubleword at
+     lowest + 8*(32*k+i), and is set iff an object starting there is
+     marked.  The bitmap is valid until msgc_end() and may be read by
+     clients that need to visit the marked objects in a range in
+     address order.
+     */
      
 extern void msgc_end( msgc_context_t *context );
   /* Free the context data structure and any resources it uses.
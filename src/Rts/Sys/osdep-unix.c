@@ -9,6 +9,8 @@
  *  getrusage      not available everywhere?
  */
 
+#define _LARGEFILE64_SOURCE 1	/* For mapping files of 2GB and more */
+
 #include "config.h"
 
 #if defined(UNIX)		/* This file in effect only on Unix systems */
@@ -19,6 +21,11 @@
 #include <sys/stat.h>
 #include <sys/utsname.h>
 #include <sys/mman.h>		/* For mmap() and munmap() */
+#include <sys/wait.h>
+#include <signal.h>
+#if defined(LINUX)
+#include <sys/syscall.h>	/* For mbind() */
+#endif
 #include <limits.h>
 #include <unistd.h>
 #include <time.h>
@@ -88,6 +95,79 @@ void osdep_poll_startup_events( void )
   /* Nothing now, and probably nothing ever. */
 }
 
+static pid_t *worker_pids = 0;  /* Workers still running, or 0 */
+static int worker_count = 0;
+
+static void forward_signal( int sig )
+{
+  int i;
+
+  for ( i=0 ; i < worker_count ; i++ )
+    if (worker_pids[i] != 0)
+      kill( worker_pids[i], sig );
+}
+
+int osdep_prefork( int workers )
+{
+  int i, n, status, result;
+  pid_t pid;
+  char buf[ 32 ];
+
+  worker_pids = (pid_t*)must_malloc( sizeof( pid_t )*workers );
+  worker_count = workers;
+  for ( i=0 ; i < workers ; i++ )
+    worker_pids[i] = 0;
+
+  fflush( stdout );
+  fflush( stderr );
+  for ( i=0 ; i < workers ; i++ ) {
+    pid = fork();
+    if (pid == -1) {
+      consolemsg( "fork: %s: started %d of %d workers.",
+                  strerror( errno ), i, workers );
+      break;
+    }
+    if (pid == 0) {
+      free( worker_pids );
+      worker_pids = 0;
+      worker_count = 0;
+      sprintf( buf, "%d", i );
+      setenv( "LARCENY_WORKER", buf, 1 );
+      return i;
+    }
+    worker_pids[i] = pid;
+  }
+  if (i == 0)
+    panic_exit( "Unable to fork any workers." );
+
+  signal( SIGINT, forward_signal );
+  signal( SIGTERM, forward_signal );
+  signal( SIGHUP, forward_signal );
+  annoyingmsg( "Started %d workers.", i );
+
+  result = 0;
+  for ( n=i ; n > 0 ; ) {
+    pid = wait( &status );
+    if (pid == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    for ( i=0 ; i < worker_count ; i++ )
+      if (worker_pids[i] == pid)
+        worker_pids[i] = 0;
+    n--;
+    if (result == 0) {
+      if (WIFEXITED( status ))
+        result = WEXITSTATUS( status );
+      else if (WIFSIGNALED( status ))
+        result = 128 + WTERMSIG( status );
+    }
+  }
+  exit( result );
+  return -1;
+}
+
 void osdep_openfile( w_fn, w_flags, w_mode )
 word w_fn, w_flags, w_mode;
 {
@@ -95,6 +175,7 @@ word w_fn, w_flags, w_mode;
   int flags = nativeint( w_flags );
   int mode = nativeint( w_mode );
   int newflags = 0;
+  int fd;
 
   if (flags & 0x01) newflags |= O_RDONLY;
   if (flags & 0x02) newflags |= O_WRONLY;
@@ -112,7 +193,13 @@ word w_fn, w_flags, w_mode;
     globals[ G_RESULT ] = fixnum( -1 );
     return;
   }
-  globals[ G_RESULT ] = fixnum( open( fn, newflags, mode ) );
+  fd = open( fn, newflags, mode );
+#if OSDEP_URING
+  /* Appending writes can't be done behind, as they could be reordered. */
+  if (fd >= 0 && (flags & 0x03) != 0x03 && !(flags & 0x04))
+    osdep_uring_attach( fd, (flags & 0x02) != 0 );
+#endif
+  globals[ G_RESULT ] = fixnum( fd );
 }
 
 void osdep_unlinkfile( w_fn )
@@ -129,12 +216,28 @@ word w_fn;
 void osdep_closefile( w_fd )
 word w_fd;
 {
-  globals[ G_RESULT ] = fixnum( close( nativeint( w_fd ) ) );
+  int fd = nativeint( w_fd );
+#if OSDEP_URING
+  if (osdep_uring_handles( fd ) && osdep_uring_detach( fd ) == -1) {
+    close( fd );
+    globals[ G_RESULT ] = fixnum( -1 );
+    return;
+  }
+#endif
+  globals[ G_RESULT ] = fixnum( close( fd ) );
 }
 
 void osdep_readfile( w_fd, w_buf, w_cnt )
 word w_fd, w_buf, w_cnt;
 {
+#if OSDEP_URING
+  if (osdep_uring_handles( nativeint( w_fd ) )) {
+    globals[ G_RESULT ] = fixnum( osdep_uring_read( nativeint( w_fd ),
+                                                    string_data( w_buf ),
+                                                    nativeint( w_cnt ) ) );
+    return;
+  }
+#endif
   globals[ G_RESULT ] = fixnum( read( nativeint( w_fd ),
 				    string_data( w_buf ),
 				    nativeint( w_cnt ) ) );
@@ -143,6 +246,15 @@ word w_fd, w_buf, w_cnt;
 void osdep_writefile( w_fd, w_buf, w_cnt, w_offset )
 word w_fd, w_buf, w_cnt, w_offset;
 {
+#if OSDEP_URING
+  if (osdep_uring_handles( nativeint( w_fd ) )) {
+    globals[ G_RESULT ] =
+      fixnum( osdep_uring_write( nativeint( w_fd ),
+                                 string_data(w_buf)+nativeint(w_offset),
+                                 nativeint( w_cnt ) ) );
+    return;
+  }
+#endif
   globals[ G_RESULT ] = fixnum( write( nativeint( w_fd ),
 				     string_data(w_buf)+nativeint(w_offset),
 				     nativeint( w_cnt ) ) );
@@ -162,6 +274,14 @@ word w_fd, w_offset, w_whence;
   else if ( whence_code == 2 )
     whence = SEEK_END;
   else assert( 0 );
+#if OSDEP_URING
+  if (osdep_uring_handles( nativeint( w_fd ) )) {
+    globals[ G_RESULT ] = fixnum( osdep_uring_seek( nativeint( w_fd ),
+                                                    nativeint( w_offset ),
+                                                    whence ) );
+    return;
+  }
+#endif
   globals[ G_RESULT ] = fixnum( lseek( nativeint( w_fd ),
                                        nativeint( w_offset ),
                                        whence ));
@@ -425,10 +545,218 @@ static int  pagesize = -1;	/* operating system's page size */
 static void *addr_hint = 0;	/* address of the first returned block */
 static int  fragmentation;	/* current fragmentation */
 static int  initialized;
+static int  block_prot = (PROT_READ | PROT_WRITE | PROT_EXEC);
+				/* protection of new and cached blocks */
 
 static hrtime_t mmap_time;
 static hrtime_t munmap_time;
 
+#if OSDEP_HEAP_ARENA
+/* On Linux the blocks may instead be carved out of one range of
+   address space that is reserved at startup (osdep_use_heap_arena).
+   
+   The arena is committed from the bottom up in 2MB chunks, and each
+   chunk is advised to be backed by a transparent huge page and bound
+   to the selected NUMA nodes, if any, before it is touched.  Free
+   space is kept as an address-ordered list of extents, allocated
+   first-fit, so that the live blocks stay packed toward the bottom
+   and share huge pages.  Freed memory stays mapped, but every whole
+   chunk that becomes free is given back with MADV_DONTNEED; partial
+   chunks are kept, as giving them back would split the huge page.
+   Requests that do not fit in the arena go to mmap() as before.
+   */
+
+#define ARENA_CHUNK       (2*1024*1024)
+#define ARENA_MAX_NODES   64
+#define ARENA_MASK_BITS   (8*sizeof(unsigned long))
+#define ARENA_MASK_WORDS  (ARENA_MAX_NODES/ARENA_MASK_BITS)
+
+#ifndef MPOL_BIND
+# define MPOL_BIND        2
+#endif
+#ifndef MPOL_INTERLEAVE
+# define MPOL_INTERLEAVE  3
+#endif
+
+typedef struct {
+  byte *bot;
+  byte *top;
+} extent_t;
+
+static struct {
+  byte     *bot;		/* lowest address, or 0 if there is no arena */
+  byte     *top;
+  byte     *committed;		/* [bot,committed) is committed */
+  extent_t *free;		/* free extents by increasing address */
+  int      nfree;
+  int      maxfree;
+  int      numa_mode;		/* 0, MPOL_BIND, or MPOL_INTERLEAVE */
+  unsigned long nodemask[ ARENA_MASK_WORDS ];  /* as for mbind() */
+  int      nnodes;		/* nodes set in nodemask */
+} arena;
+
+static void arena_set_node( int node )
+{
+  arena.nodemask[ node/ARENA_MASK_BITS ] |= 1UL << (node % ARENA_MASK_BITS);
+  arena.nnodes++;
+}
+
+static void arena_bind( byte *p, int bytes )
+{
+#if defined(SYS_mbind)
+  /* The kernel reads maxnode-1 bits of the mask, hence the +1. */
+  if (arena.numa_mode != 0 &&
+      syscall( SYS_mbind, p, (unsigned long)bytes, arena.numa_mode,
+               arena.nodemask, (unsigned long)ARENA_MAX_NODES+1, 0 ) == -1) {
+    annoyingmsg( "Heap arena: mbind: %s; NUMA policy disabled.",
+                 strerror( errno ) );
+    arena.numa_mode = 0;
+  }
+#endif
+}
+
+static void arena_commit( byte *limit )
+{
+  byte *p;
+
+  while (arena.committed < limit) {
+    p = arena.committed;
+    while (mprotect( p, ARENA_CHUNK, block_prot ) == -1)
+      memfail( MF_HEAP, "mprotect: %s: failed to commit %d bytes.",
+               strerror( errno ), ARENA_CHUNK );
+#if defined(MADV_HUGEPAGE)
+    madvise( p, ARENA_CHUNK, MADV_HUGEPAGE );
+#endif
+    arena_bind( p, ARENA_CHUNK );
+    arena.committed = p + ARENA_CHUNK;
+  }
+}
+
+/* Returns 0 if there is no free extent large enough. */
+static void *arena_alloc( int bytes )
+{
+  int i;
+  byte *p;
+
+  for ( i=0 ; i < arena.nfree ; i++ )
+    if (arena.free[i].top - arena.free[i].bot >= bytes)
+      break;
+  if (i == arena.nfree)
+    return 0;
+
+  p = arena.free[i].bot;
+  arena.free[i].bot += bytes;
+  if (arena.free[i].bot == arena.free[i].top) {
+    memmove( &arena.free[i], &arena.free[i+1], 
+             (arena.nfree-i-1)*sizeof(extent_t) );
+    arena.nfree--;
+  }
+  if (p + bytes > arena.committed)
+    arena_commit( (byte*)roundup( (word)(p + bytes), ARENA_CHUNK ) );
+  return p;
+}
+
+static void arena_free( byte *p, int bytes )
+{
+  byte *top = p + bytes;
+  byte *lo, *hi;
+  int i;
+
+  for ( i=0 ; i < arena.nfree && arena.free[i].top < p ; i++ )
+    ;
+  assert( i == arena.nfree || arena.free[i].bot >= top ||
+          arena.free[i].top == p );
+
+  if (i < arena.nfree && arena.free[i].top == p) {
+    arena.free[i].top = top;                    /* Extend below */
+    if (i+1 < arena.nfree && arena.free[i+1].bot == top) {
+      arena.free[i].top = arena.free[i+1].top;  /* Join above */
+      memmove( &arena.free[i+1], &arena.free[i+2],
+               (arena.nfree-i-2)*sizeof(extent_t) );
+      arena.nfree--;
+    }
+  }
+  else if (i < arena.nfree && arena.free[i].bot == top)
+    arena.free[i].bot = p;                      /* Extend above */
+  else {
+    if (arena.nfree == arena.maxfree) {
+      arena.maxfree *= 2;
+      arena.free = (extent_t*)must_realloc( arena.free,
+                                            arena.maxfree*sizeof(extent_t) );
+    }
+    memmove( &arena.free[i+1], &arena.free[i],
+             (arena.nfree-i)*sizeof(extent_t) );
+    arena.free[i].bot = p;
+    arena.free[i].top = top;
+    arena.nfree++;
+  }
+
+  /* The whole chunks of the free extent that the block touches. */
+  lo = (byte*)max( roundup( (word)arena.free[i].bot, ARENA_CHUNK ),
+                   (word)p & ~(ARENA_CHUNK-1) );
+  hi = (byte*)min( (word)arena.free[i].top & ~(ARENA_CHUNK-1),
+                   roundup( (word)top, ARENA_CHUNK ) );
+  hi = min( hi, arena.committed );
+  if (lo < hi)
+    madvise( lo, hi-lo, MADV_DONTNEED );
+}
+
+void osdep_use_heap_arena( int bytes, int numa_node, int numa_interleave )
+{
+  byte *p, *bot;
+  int i;
+  char buf[ 64 ];
+
+  assert( arena.bot == 0 && !initialized );
+
+  bytes = roundup( bytes, ARENA_CHUNK );
+  p = mmap( 0, bytes+ARENA_CHUNK, PROT_NONE, 
+            (MAP_PRIVATE | MAP_ANON | MAP_NORESERVE), -1, 0 );
+  if (p == MAP_FAILED) {
+    consolemsg( "Heap arena: mmap: %s: failed to reserve %d bytes.",
+                strerror( errno ), bytes );
+    return;
+  }
+  bot = (byte*)roundup( (word)p, ARENA_CHUNK );
+  if (bot > p)
+    munmap( p, bot-p );
+  munmap( bot+bytes, (p+ARENA_CHUNK) - bot );
+
+  arena.bot = arena.committed = bot;
+  arena.top = bot + bytes;
+  arena.maxfree = 16;
+  arena.free = (extent_t*)must_malloc( arena.maxfree*sizeof(extent_t) );
+  arena.free[0].bot = arena.bot;
+  arena.free[0].top = arena.top;
+  arena.nfree = 1;
+
+  arena.numa_mode = 0;
+  memset( arena.nodemask, 0, sizeof( arena.nodemask ) );
+  arena.nnodes = 0;
+  if (numa_node >= 0 && numa_node < ARENA_MAX_NODES) {
+    arena.numa_mode = MPOL_BIND;
+    arena_set_node( numa_node );
+  }
+  else if (numa_interleave) {
+    for ( i=0 ; i < ARENA_MAX_NODES ; i++ ) {
+      sprintf( buf, "/sys/devices/system/node/node%d", i );
+      if (access( buf, F_OK ) == 0)
+        arena_set_node( i );
+    }
+    if (arena.nnodes > 0)
+      arena.numa_mode = MPOL_INTERLEAVE;
+  }
+
+  annoyingmsg( "Heap arena: %d bytes at 0x%08lx, NUMA policy %d on %d nodes.",
+               bytes, (unsigned long)bot, arena.numa_mode, arena.nnodes );
+}
+
+static int in_arena( void *block )
+{
+  return (byte*)block >= arena.bot && (byte*)block < arena.top;
+}
+#endif /* OSDEP_HEAP_ARENA */
+
 static void* alloc_block( int bytes )
 {
   void *addr;
@@ -439,6 +767,11 @@ static void* alloc_block( int bytes )
   fragmentation += roundup( bytes, pagesize ) - bytes;
   assert( fragmentation >= 0 );
 
+#if OSDEP_HEAP_ARENA
+  if (arena.bot != 0 && (addr = arena_alloc( bytes )) != 0)
+    return addr;
+#endif
+
 again:
 
   /* mmap /dev/zero is unsupported on MacOS X, according to Stevens
@@ -453,7 +786,7 @@ again:
 
   addr = mmap( 0,
 	       bytes,
-	       (PROT_READ | PROT_WRITE | PROT_EXEC), 
+	       block_prot, 
 	       (MAP_PRIVATE | MAP_ANON), 
 	       -1, 
 	       0 );
@@ -466,14 +799,38 @@ again:
   return addr;
 }
 
+static void unmap_block( void *block, int bytes )
+{
+  if (munmap( block, bytes ) == -1)
+    panic_abort( "munmap: %s: failed to unmap %d bytes.", 
+		 strerror(errno), bytes );
+}
+
 static void free_block( void *block, int bytes )
 {
   fragmentation -= roundup( bytes, pagesize ) - bytes;
   assert( fragmentation >= 0 );
 
-  if (munmap( block, bytes ) == -1)
-    panic_abort( "munmap: %s: failed to unmap %d bytes.", 
-		 strerror(errno), bytes );
+#if OSDEP_HEAP_ARENA
+  if (arena.bot != 0) {
+    /* A merged block may run into the arena from below, past it into
+       a mapped block, or both; only the parts outside are unmapped,
+       so that the reservation stays whole. */
+    byte *bot = (byte*)block, *top = (byte*)block + bytes;
+    byte *lo = max( bot, arena.bot ), *hi = min( top, arena.top );
+
+    if (lo < hi) {
+      arena_free( lo, hi-lo );
+      if (bot < lo)
+        unmap_block( bot, lo-bot );
+      if (hi < top)
+        unmap_block( hi, top-hi );
+      return;
+    }
+  }
+#endif
+
+  unmap_block( block, bytes );
 }
 
 void *osdep_alloc_aligned( int bytes )
@@ -552,6 +909,10 @@ void osdep_free_aligned( void *block, int bytes )
  
   assert( bytes % 4096 == 0 );
 
+  /* The caches hold blocks with the protection of new blocks. */
+  if (block_prot != (PROT_READ | PROT_WRITE | PROT_EXEC))
+    osdep_protect_aligned( block, bytes, OSDEP_PROT_RW );
+
 #if RETURN_MEMORY_TO_OS
   if (bytes > GC_CHUNK_SIZE) 
     free_block( block, bytes );
@@ -615,6 +976,90 @@ int osdep_fragmentation( void )
   return fragmentation;
 }
 
+#if defined(LINUX)
+typedef struct stat64 lfs_stat_t;
+# define lfs_fstat( fd, st )  fstat64( fd, st )
+# define lfs_mmap             mmap64
+# define LFS_O_LARGEFILE      O_LARGEFILE
+#else
+typedef struct stat lfs_stat_t;
+# define lfs_fstat( fd, st )  fstat( fd, st )
+# define lfs_mmap             mmap
+# define LFS_O_LARGEFILE      0
+#endif
+
+int osdep_map_file( void *block, int bytes, int fd, long long offset )
+{
+  void *addr;
+  lfs_stat_t st;
+
+  assert( (word)block % 4096 == 0 && offset % 4096 == 0 );
+
+#if OSDEP_HEAP_ARENA
+  /* Arena memory keeps its huge pages and NUMA policy. */
+  if (arena.bot != 0 && in_arena( block ))
+    return 0;
+#endif
+  if (lfs_fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode ) ||
+      offset + bytes > st.st_size)
+    return 0;
+  addr = lfs_mmap( block, roundup( bytes, 4096 ), block_prot,
+                   (MAP_PRIVATE | MAP_FIXED), fd, offset );
+  if (addr == MAP_FAILED) {
+    annoyingmsg( "mmap: %s: failed to map %d bytes of file.",
+                 strerror( errno ), bytes );
+    return 0;
+  }
+  return 1;
+}
+
+void osdep_unmap_file( void *block, int bytes )
+{
+  bytes = roundup( bytes, 4096 );
+  if (mmap( block, bytes, block_prot,
+            (MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED), -1, 0 ) == MAP_FAILED)
+    panic_abort( "mmap: %s: failed to unmap %d bytes of file.",
+                 strerror( errno ), bytes );
+}
+
+int osdep_open_mapped( const char *fn, long long *size )
+{
+  lfs_stat_t st;
+  int fd;
+
+  fd = open( fn, O_RDONLY | LFS_O_LARGEFILE );
+  if (fd == -1)
+    return -1;
+  if (lfs_fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode )) {
+    close( fd );
+    return -1;
+  }
+  *size = st.st_size;
+  return fd;
+}
+
+void osdep_use_wxorx( void )
+{
+  assert( !initialized );
+  block_prot = (PROT_READ | PROT_WRITE);
+}
+
+void osdep_protect_aligned( void *block, int bytes, int prot )
+{
+  static int prots[] = { (PROT_READ | PROT_WRITE),
+                         (PROT_READ | PROT_EXEC),
+                         (PROT_READ | PROT_WRITE | PROT_EXEC) };
+
+  assert( (word)block % 4096 == 0 && bytes % 4096 == 0 );
+  assert( prot >= OSDEP_PROT_RW && prot <= OSDEP_PROT_RWX );
+
+  if (block_prot == (PROT_READ | PROT_WRITE | PROT_EXEC))
+    return;
+  if (mprotect( block, bytes, prots[ prot ] ) == -1)
+    panic_abort( "mprotect: %s: failed to protect %d bytes.",
+                 strerror( errno ), bytes );
+}
+
 #endif /* !USE_GENERIC_ALLOCATOR */
 
 unsigned osdep_realclock( void )
@@ -0,0 +1,504 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Operating-system dependent functionality -- batched file I/O with
+ * io_uring on Linux.
+ *
+ * See osdep.h for the interface; osdep-unix.c hands regular files
+ * opened for reading only or for writing only to this file when the
+ * -io-uring option is given.
+ *
+ * Each such file gets a stream of URING_DEPTH buffers.  A reading
+ * stream keeps all its buffers in flight ahead of the caller, each at
+ * an explicit file offset, and submits a buffer again as soon as the
+ * caller has consumed it.  A writing stream copies the caller's bytes
+ * into buffers that are not in flight and submits them before the
+ * write returns, full or not, so that a write is never held back; it
+ * waits only when every buffer is in flight.  The buffers belong to
+ * the run-time system and are registered with the kernel once, so the
+ * kernel reads into and writes from them directly.
+ *
+ * The ring is used by the Scheme thread only and has no locks.  The
+ * liburing library is not used; the system calls are made directly.
+ * If the ring cannot be set up, or all streams are in use, files are
+ * read and written as before.
+ */
+
+#include "config.h"
+
+#if defined(LINUX)              /* This file in effect only on Linux */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#if defined(__NR_io_uring_setup)
+# include <linux/io_uring.h>
+# define HAVE_IO_URING 1
+#endif
+
+#include "larceny.h"
+
+#if HAVE_IO_URING
+
+#define URING_STREAMS    16             /* Files handled at once */
+#define URING_DEPTH      4              /* Buffers per stream */
+#define URING_BUFSIZE    (64*1024)      /* Bytes per buffer */
+#define URING_ENTRIES    (URING_STREAMS*URING_DEPTH)
+#define URING_MAX_FD     4096           /* Higher descriptors are not handled */
+
+#define B_FREE           0
+#define B_INFLIGHT       1              /* Submitted to the kernel */
+#define B_READY          2              /* Read completed */
+
+typedef struct ubuf ubuf_t;
+typedef struct ustream ustream_t;
+
+struct ubuf {
+  int          state;
+  int          len;             /* Bytes read or written, or -errno */
+  int          used;            /* Bytes the caller has read */
+  long long    off;             /* File offset of the first byte */
+  struct iovec iov;             /* The buffer's memory */
+};
+
+struct ustream {
+  int       fd;                 /* -1 if the stream is free */
+  bool      writing;
+  int       head;               /* Buffer the caller reads */
+  int       inflight;           /* Buffers submitted to the kernel */
+  int       error;              /* -errno of a failed write, or 0 */
+  long long pos;                /* The caller's file position */
+  long long next;               /* Offset of the next read ahead */
+  ubuf_t    buf[ URING_DEPTH ];
+};
+
+static struct {
+  int                 fd;
+  bool                fixed;    /* Buffers are registered */
+  unsigned            *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned            *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  int                 queued;   /* Entries not yet passed to the kernel */
+  ustream_t           streams[ URING_STREAMS ];
+  signed char         by_fd[ URING_MAX_FD ];  /* Stream number + 1, or 0 */
+} ring;
+
+static bool ring_ready = FALSE;
+
+static void flush_all( void );
+
+bool osdep_uring_init( void )
+{
+  struct io_uring_params p;
+  struct iovec iov[ URING_ENTRIES ];
+  size_t sq_size, cq_size;
+  void *sq, *cq;
+  byte *mem;
+  int fd, i, j;
+
+  memset( &p, 0, sizeof( p ) );
+  fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &p );
+  if (fd < 0)
+    return FALSE;
+
+  sq_size = p.sq_off.array + p.sq_entries*sizeof( unsigned );
+  cq_size = p.cq_off.cqes + p.cq_entries*sizeof( struct io_uring_cqe );
+  sq = mmap( 0, sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+             fd, IORING_OFF_SQ_RING );
+  cq = mmap( 0, cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+             fd, IORING_OFF_CQ_RING );
+  ring.sqes = (struct io_uring_sqe*)
+    mmap( 0, p.sq_entries*sizeof( struct io_uring_sqe ),
+          PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+          fd, IORING_OFF_SQES );
+  if (sq == MAP_FAILED || cq == MAP_FAILED || ring.sqes == MAP_FAILED) {
+    close( fd );
+    return FALSE;
+  }
+  ring.fd = fd;
+  ring.sq_head = (unsigned*)((char*)sq + p.sq_off.head);
+  ring.sq_tail = (unsigned*)((char*)sq + p.sq_off.tail);
+  ring.sq_mask = (unsigned*)((char*)sq + p.sq_off.ring_mask);
+  ring.sq_array = (unsigned*)((char*)sq + p.sq_off.array);
+  ring.cq_head = (unsigned*)((char*)cq + p.cq_off.head);
+  ring.cq_tail = (unsigned*)((char*)cq + p.cq_off.tail);
+  ring.cq_mask = (unsigned*)((char*)cq + p.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe*)((char*)cq + p.cq_off.cqes);
+  ring.queued = 0;
+
+  mem = (byte*)osdep_alloc_aligned( URING_ENTRIES*URING_BUFSIZE );
+  for ( i = 0 ; i < URING_STREAMS ; i++ ) {
+    ring.streams[i].fd = -1;
+    for ( j = 0 ; j < URING_DEPTH ; j++ ) {
+      ubuf_t *b = &ring.streams[i].buf[j];
+      b->state = B_FREE;
+      b->iov.iov_base = mem + (i*URING_DEPTH + j)*URING_BUFSIZE;
+      b->iov.iov_len = URING_BUFSIZE;
+      iov[ i*URING_DEPTH + j ] = b->iov;
+    }
+  }
+  memset( ring.by_fd, 0, sizeof( ring.by_fd ) );
+
+  /* Registration pins the buffers and may fail against RLIMIT_MEMLOCK;
+     the buffers are then passed with each request instead. */
+  ring.fixed =
+    syscall( __NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+             iov, URING_ENTRIES ) == 0;
+
+  annoyingmsg( "io_uring: %d streams of %d buffers of %dKB, %s.",
+               URING_STREAMS, URING_DEPTH, URING_BUFSIZE/1024,
+               ring.fixed ? "registered" : "not registered" );
+  atexit( flush_all );
+  ring_ready = TRUE;
+  return TRUE;
+}
+
+static ustream_t *stream_of( int fd )
+{
+  if (!ring_ready || fd < 0 || fd >= URING_MAX_FD || ring.by_fd[fd] == 0)
+    return 0;
+  return &ring.streams[ ring.by_fd[fd]-1 ];
+}
+
+/* Queues a read or write of buffer b of stream s.  The request is
+   passed to the kernel by the next call to enter(). */
+static void queue( ustream_t *s, ubuf_t *b, int len )
+{
+  unsigned tail = *ring.sq_tail;
+  unsigned i = tail & *ring.sq_mask;
+  struct io_uring_sqe *sqe = &ring.sqes[i];
+  int k = b - s->buf;
+  int n = s - ring.streams;
+
+  memset( sqe, 0, sizeof( *sqe ) );
+  sqe->fd = s->fd;
+  sqe->off = b->off;
+  if (ring.fixed) {
+    sqe->opcode = s->writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->addr = (unsigned long)b->iov.iov_base;
+    sqe->len = len;
+    sqe->buf_index = n*URING_DEPTH + k;
+  }
+  else {
+    b->iov.iov_len = len;
+    sqe->opcode = s->writing ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->addr = (unsigned long)&b->iov;
+    sqe->len = 1;
+  }
+  sqe->user_data = n*URING_DEPTH + k;
+  ring.sq_array[i] = i;
+  __atomic_store_n( ring.sq_tail, tail+1, __ATOMIC_RELEASE );
+  ring.queued++;
+
+  b->state = B_INFLIGHT;
+  s->inflight++;
+}
+
+/* Passes the queued requests to the kernel and, if wait is nonzero,
+   waits for at least one completion. */
+static void enter( int wait )
+{
+  int r;
+
+  do {
+    r = syscall( __NR_io_uring_enter, ring.fd, ring.queued, wait,
+                 wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    panic_exit( "io_uring_enter failed: %s", strerror( errno ) );
+  ring.queued -= r;
+}
+
+static void reap( void )
+{
+  unsigned head = *ring.cq_head;
+
+  while (head != __atomic_load_n( ring.cq_tail, __ATOMIC_ACQUIRE )) {
+    struct io_uring_cqe *cqe = &ring.cqes[ head & *ring.cq_mask ];
+    ustream_t *s = &ring.streams[ cqe->user_data / URING_DEPTH ];
+    ubuf_t *b = &s->buf[ cqe->user_data % URING_DEPTH ];
+
+    s->inflight--;
+    if (s->writing) {
+      if (cqe->res != b->len && s->error == 0)
+        s->error = cqe->res < 0 ? cqe->res : -EIO;
+      b->state = B_FREE;
+    }
+    else {
+      b->len = cqe->res;
+      b->used = 0;
+      b->state = B_READY;
+    }
+    head++;
+  }
+  __atomic_store_n( ring.cq_head, head, __ATOMIC_RELEASE );
+}
+
+static void await( ustream_t *s, ubuf_t *b )
+{
+  while (b->state == B_INFLIGHT) {
+    enter( 1 );
+    reap();
+  }
+}
+
+static void drain( ustream_t *s )
+{
+  while (s->inflight > 0) {
+    enter( 1 );
+    reap();
+  }
+}
+
+/* Forgets what has been read ahead and starts reading ahead at pos. */
+static void restart_reads( ustream_t *s, long long pos )
+{
+  int i;
+
+  drain( s );
+  s->pos = s->next = pos;
+  s->head = 0;
+  for ( i = 0 ; i < URING_DEPTH ; i++ ) {
+    s->buf[i].off = s->next;
+    s->next += URING_BUFSIZE;
+    queue( s, &s->buf[i], URING_BUFSIZE );
+  }
+  enter( 0 );
+}
+
+/* Returns a buffer of writing stream s that is not in flight, and
+   waits for a write to complete only if every buffer is in flight. */
+static ubuf_t *free_buffer( ustream_t *s )
+{
+  int i;
+
+  for (;;) {
+    for ( i = 0 ; i < URING_DEPTH ; i++ )
+      if (s->buf[i].state == B_FREE)
+        return &s->buf[i];
+    enter( 1 );
+    reap();
+  }
+}
+
+/* Waits for all the writes of a writing stream.  Returns -errno of a
+   failed write, or 0. */
+static int flush( ustream_t *s )
+{
+  int r;
+
+  drain( s );
+  r = s->error;
+  s->error = 0;
+  return r;
+}
+
+static void flush_all( void )
+{
+  int i;
+
+  for ( i = 0 ; i < URING_STREAMS ; i++ )
+    if (ring.streams[i].fd >= 0 && ring.streams[i].writing)
+      flush( &ring.streams[i] );
+}
+
+void osdep_uring_attach( int fd, bool writing )
+{
+  struct stat st;
+  ustream_t *s = 0;
+  long long pos;
+  int i;
+
+  if (!ring_ready || fd < 0 || fd >= URING_MAX_FD)
+    return;
+  if (fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode ))
+    return;
+  for ( i = 0 ; i < URING_STREAMS && s == 0 ; i++ )
+    if (ring.streams[i].fd == -1)
+      s = &ring.streams[i];
+  if (s == 0)
+    return;
+  if ((pos = lseek( fd, 0, SEEK_CUR )) == -1)
+    return;
+
+  s->fd = fd;
+  s->writing = writing;
+  s->error = 0;
+  s->inflight = 0;
+  s->head = 0;
+  ring.by_fd[fd] = s - ring.streams + 1;
+  if (writing)
+    s->pos = pos;
+  else
+    restart_reads( s, pos );
+}
+
+bool osdep_uring_handles( int fd )
+{
+  return stream_of( fd ) != 0;
+}
+
+int osdep_uring_read( int fd, void *dest, int n )
+{
+  ustream_t *s = stream_of( fd );
+  ubuf_t *b = &s->buf[ s->head ];
+  int k;
+
+  if (s->writing)
+    return read( fd, dest, n );       /* Fails, as it should */
+  await( s, b );
+  if (b->len <= 0) {
+    k = b->len;
+    restart_reads( s, s->pos );
+    if (k == 0)
+      return 0;
+    errno = -k;
+    return -1;
+  }
+
+  k = min( n, b->len - b->used );
+  memcpy( dest, (byte*)b->iov.iov_base + b->used, k );
+  b->used += k;
+  s->pos += k;
+  if (b->used == b->len) {
+    if (b->len < URING_BUFSIZE)
+      /* Short read: the buffers beyond it were read past the end. */
+      restart_reads( s, s->pos );
+    else {
+      b->off = s->next;
+      s->next += URING_BUFSIZE;
+      queue( s, b, URING_BUFSIZE );
+      enter( 0 );
+      s->head = (s->head + 1) % URING_DEPTH;
+    }
+  }
+  return k;
+}
+
+int osdep_uring_write( int fd, void *src, int n )
+{
+  ustream_t *s = stream_of( fd );
+  int done = 0;
+
+  if (!s->writing)
+    return write( fd, src, n );       /* Fails, as it should */
+  reap();
+  while (done < n) {
+    ubuf_t *b = free_buffer( s );
+    int k;
+
+    if (s->error != 0) {
+      if (done > 0)
+        enter( 0 );
+      errno = -s->error;
+      s->error = 0;
+      return done > 0 ? done : -1;
+    }
+    k = min( n - done, URING_BUFSIZE );
+    memcpy( b->iov.iov_base, (byte*)src + done, k );
+    b->len = k;
+    b->off = s->pos;
+    queue( s, b, k );
+    s->pos += k;
+    done += k;
+  }
+  enter( 0 );
+  return done;
+}
+
+long long osdep_uring_seek( int fd, long long offset, int whence )
+{
+  ustream_t *s = stream_of( fd );
+  long long pos;
+  int r;
+
+  if (s->writing && (r = flush( s )) != 0) {
+    errno = -r;
+    return -1;
+  }
+  if (whence == SEEK_CUR && offset == 0)
+    return s->pos;
+
+  drain( s );
+  if (whence == SEEK_CUR)
+    offset += s->pos;
+  if ((pos = lseek( fd, offset, whence == SEEK_CUR ? SEEK_SET : whence ))
+      == -1)
+    return -1;
+  if (s->writing)
+    s->pos = pos;
+  else
+    restart_reads( s, pos );
+  return pos;
+}
+
+int osdep_uring_detach( int fd )
+{
+  ustream_t *s = stream_of( fd );
+  int r = 0;
+
+  if (s->writing)
+    r = flush( s );
+  else
+    drain( s );
+  /* Leave the descriptor at the caller's position. */
+  lseek( fd, s->pos, SEEK_SET );
+  s->fd = -1;
+  ring.by_fd[fd] = 0;
+  if (r != 0) {
+    errno = -r;
+    return -1;
+  }
+  return 0;
+}
+
+#else  /* !HAVE_IO_URING */
+
+bool osdep_uring_init( void )
+{
+  return FALSE;
+}
+
+void osdep_uring_attach( int fd, bool writing )
+{
+}
+
+bool osdep_uring_handles( int fd )
+{
+  return FALSE;
+}
+
+int osdep_uring_read( int fd, void *dest, int n )
+{
+  return read( fd, dest, n );
+}
+
+int osdep_uring_write( int fd, void *src, int n )
+{
+  return write( fd, src, n );
+}
+
+long long osdep_uring_seek( int fd, long long offset, int whence )
+{
+  return lseek( fd, offset, whence );
+}
+
+int osdep_uring_detach( int fd )
+{
+  return 0;
+}
+
+#endif /* HAVE_IO_URING */
+
+#endif /* LINUX */
+
+/* eof */
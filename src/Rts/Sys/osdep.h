@@ -55,6 +55,24 @@ void osdep_poll_startup_events( void );
      is only to be called before any Scheme procedures are run.
      */
 
+#if defined(UNIX)
+# define OSDEP_PREFORK 1
+#else
+# define OSDEP_PREFORK 0
+#endif
+
+#if OSDEP_PREFORK
+int osdep_prefork( int workers );
+  /* Forks `workers' worker processes, which share the memory of the
+     caller copy-on-write.  Returns the index of the worker, from 0, in
+     each worker, where the environment variable LARCENY_WORKER is also
+     set to that index.  Does not return in the parent, which waits for
+     the workers, passes SIGINT, SIGTERM, and SIGHUP on to them, and
+     exits with status 0 if all of them exited with status 0.  Must be
+     called before any other threads are created.
+     */
+#endif
+
 extern void osdep_poll_events( word *globals );
   /* Poll for events that need to be polled for on this operating system, and
      dispatch on them if necessary.  This function is only to be called when
@@ -82,8 +100,93 @@ void osdep_free_aligned( void *block, int bytes );
   /* Takes a pointer returned from osdep_alloc_aligned() as well as
      the size of the pointed-to block and returns the block to
      the free memory pool.
+
+     If OSDEP_FREE_ALIGNED_MERGES is nonzero, the block may also be
+     the union of several adjacent blocks returned from separate calls
+     to osdep_alloc_aligned().
+     */
+
+#if defined(UNIX) && !USE_GENERIC_ALLOCATOR
+# define OSDEP_FREE_ALIGNED_MERGES 1  /* munmap takes any range of pages */
+#else
+# define OSDEP_FREE_ALIGNED_MERGES 0
+#endif
+
+#if defined(LINUX) && !USE_GENERIC_ALLOCATOR
+# define OSDEP_HEAP_ARENA 1
+#else
+# define OSDEP_HEAP_ARENA 0
+#endif
+
+#if defined(UNIX) && !USE_GENERIC_ALLOCATOR
+# define OSDEP_PROTECT_ALIGNED 1
+#else
+# define OSDEP_PROTECT_ALIGNED 0
+#endif
+
+#define OSDEP_PROT_RW   0     /* read, write */
+#define OSDEP_PROT_RX   1     /* read, execute */
+#define OSDEP_PROT_RWX  2     /* read, write, execute */
+
+#if OSDEP_PROTECT_ALIGNED
+void osdep_use_wxorx( void );
+  /* Makes osdep_alloc_aligned() return blocks that are readable and
+     writable but not executable.  Blocks that will hold code must then
+     be given another protection with osdep_protect_aligned(), and are
+     made writable again when they are freed.  Must be called before the
+     first call to osdep_alloc_aligned().
+     */
+
+void osdep_protect_aligned( void *block, int bytes, int prot );
+  /* Sets the protection of the pages of a range that lies within blocks
+     returned from osdep_alloc_aligned().  prot is one of OSDEP_PROT_RW,
+     OSDEP_PROT_RX, and OSDEP_PROT_RWX.  Does nothing unless
+     osdep_use_wxorx() has been called, as the blocks are then already
+     readable, writable, and executable.
+     */
+#endif
+
+#if OSDEP_PROTECT_ALIGNED
+# define OSDEP_MAP_FILE 1
+#else
+# define OSDEP_MAP_FILE 0
+#endif
+
+#if OSDEP_MAP_FILE
+int osdep_map_file( void *block, int bytes, int fd, long long offset );
+  /* Replaces the pages of a range that lies within blocks returned from
+     osdep_alloc_aligned() by a private, copy-on-write mapping of `bytes'
+     bytes of the open file `fd', starting at `offset'.  The range and
+     the offset must be page-aligned.  Pages that are never written are
+     shared with the file cache and with other processes that map the
+     file.  Returns 1 on success; on failure the range is unchanged and 0
+     is returned.
+     */
+
+void osdep_unmap_file( void *block, int bytes );
+  /* Replaces a range mapped by osdep_map_file() by fresh pages that
+     do not belong to the file, as though it had never been mapped.
      */
 
+int osdep_open_mapped( const char *fn, long long *size );
+  /* Opens the named regular file for reading, for osdep_map_file(), and
+     stores its size, which may exceed 2GB, in *size.  Returns the
+     descriptor, or -1 on error.
+     */
+#endif
+
+#if OSDEP_HEAP_ARENA
+void osdep_use_heap_arena( int bytes, int numa_node, int numa_interleave );
+  /* Reserves a range of bytes of address space from which 
+     osdep_alloc_aligned() will take its blocks until the range is full.
+     The range is committed in 2MB chunks backed by huge pages where the
+     kernel allows it.  If numa_node is not negative then the memory is
+     bound to that node; otherwise, if numa_interleave is nonzero, it is
+     interleaved over all nodes.  Must be called before the first call
+     to osdep_alloc_aligned().
+     */
+#endif
+
 int osdep_fragmentation( void );
   /* Return the number of bytes of internal fragmentation in blocks
      managed the osdep allocator.  Internal fragmentation arises when
@@ -192,6 +295,44 @@ extern void osdep_lseekfile( word fd, word offset, word whence );
      FIXME: there is no way to distinguish between errors.
      */
 
+#if defined(LINUX)
+# define OSDEP_URING 1
+#else
+# define OSDEP_URING 0
+#endif
+
+#if OSDEP_URING
+/* Batched file I/O with io_uring (osdep-uring.c).  When the ring has
+   been set up, osdep_openfile() attaches the regular files it opens for
+   reading only or for writing only, and the other file functions pass
+   the attached descriptors to the functions below, which have the
+   semantics of read(), write(), lseek(), and the flushing half of
+   close().  Reads are done ahead in 64KB blocks, and writes behind:
+   each write is submitted before it returns, and waits only when
+   all the buffers of its file are in flight.  An error from a write
+   done behind is reported by the next write, seek, or close.
+   */
+
+bool osdep_uring_init( void );
+  /* Sets up the ring and its buffers.  Returns FALSE if the kernel does
+     not support io_uring, in which case nothing is ever attached.  Must
+     be called after osdep_prefork(), as a ring can't be shared.
+     */
+
+void osdep_uring_attach( int fd, bool writing );
+  /* Attaches fd if it is a regular file and a stream is free. */
+
+bool osdep_uring_handles( int fd );
+int osdep_uring_read( int fd, void *dest, int n );
+int osdep_uring_write( int fd, void *src, int n );
+long long osdep_uring_seek( int fd, long long offset, int whence );
+
+int osdep_uring_detach( int fd );
+  /* Completes the writes of fd and detaches it; fd is left open at
+     its logical position.  Returns 0, or -1 with errno set.
+     */
+#endif
+
 extern void osdep_mtime( word fn, word buf );
   /* 'fn' is a filename and 'buf' is a vector of 6 elements.  Obtain the
      modification time of the file and store it in the vector as fixnums:
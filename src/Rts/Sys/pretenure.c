@@ -0,0 +1,251 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- allocation-site profiling and pretenuring.
+ *
+ * See pretenure_t.h for the interface.
+ *
+ * The site table is open-addressed and keyed on the code vector and
+ * return offset.  A code vector that moves simply starts a new site;
+ * the table is cleared, samples and all, when it is three quarters
+ * full.
+ *
+ * The target area is grown only at the end of a collection, when
+ * every mutator is stopped.  Between collections a pretenured object
+ * that does not fit in the current chunk of the target is allocated
+ * in the nursery instead.
+ */
+
+#define GC_INTERNAL
+
+#include "larceny.h"
+#include "gc_t.h"
+#include "gclib.h"
+#include "memmgr.h"
+#include "old_heap_t.h"
+#include "semispace_t.h"
+#include "uremset_t.h"
+#include "pretenure_t.h"
+
+#define FORWARD_HDR      0xFFFFFFFE     /* As in cheney.h */
+
+#define SITE_TABLE_SIZE  4096           /* Entries; a power of 2 */
+#define SITE_LIMIT       (SITE_TABLE_SIZE/4*3)
+#define SAMPLE_LIMIT     1024           /* Samples per collection */
+#define SAMPLE_BYTES     (16*KILOBYTE)  /* Allocated between samples */
+#define MIN_SAMPLES      16             /* Samples before a decision */
+#define TARGET_ROOM      (GC_CHUNK_SIZE/4)  /* Kept free in the target */
+
+typedef struct site site_t;
+
+struct site {
+  word code;                    /* Code vector, or 0 if the entry is free */
+  word offset;                  /* Return offset in the code vector */
+  int  samples;                 /* Samples taken */
+  int  survivors;               /* Samples that survived */
+  bool pretenured;
+};
+
+struct pretenure {
+  gc_t       *gc;
+  old_heap_t *target;           /* Area the nursery promotes into */
+  int        percent;           /* Survival rate that pretenures a site */
+  site_t     *sites;            /* SITE_TABLE_SIZE entries */
+  int        site_count;        /* Entries in use */
+  int        sites_pretenured;  /* Entries with pretenured set */
+  int        countdown;         /* Bytes until the next sample */
+  site_t     *due;              /* Site of the next sample, or NULL */
+  struct {
+    word   *obj;
+    site_t *site;
+  } samples[ SAMPLE_LIMIT ];
+  int        sample_count;
+  word       **pending;         /* Pretenured since the last collection */
+  int        pending_count;
+  int        pending_max;
+  int        words_pretenured;  /* Since the last collection */
+};
+
+static void forget_sites( pretenure_t *pt )
+{
+  annoyingmsg( "Pretenuring: forgetting %d allocation sites.",
+               pt->site_count );
+  memset( pt->sites, 0, SITE_TABLE_SIZE*sizeof( site_t ) );
+  pt->site_count = 0;
+  pt->sites_pretenured = 0;
+  pt->sample_count = 0;
+  pt->due = 0;
+}
+
+/* Returns the site of the call to the allocation millicode, or NULL
+   if the caller is not a procedure. */
+static site_t *site_of( pretenure_t *pt, word *globals )
+{
+  word proc = globals[ G_REG0 ];
+  word code, offset;
+  unsigned h;
+
+  if (tagof( proc ) != PROC_TAG)
+    return 0;
+  code = procedure_ref( proc, IDX_PROC_CODE );
+  offset = globals[ G_RETADDR ];
+
+  h = (unsigned)((code >> 3) ^ (offset * 2654435761U));
+  while (1) {
+    site_t *s = &pt->sites[ h & (SITE_TABLE_SIZE-1) ];
+    if (s->code == code && s->offset == offset)
+      return s;
+    if (s->code == 0) {
+      if (pt->site_count >= SITE_LIMIT) {
+        forget_sites( pt );
+        return site_of( pt, globals );
+      }
+      s->code = code;
+      s->offset = offset;
+      pt->site_count++;
+      return s;
+    }
+    h++;
+  }
+}
+
+/* Returns the tag of the object at p. */
+static int object_tag( word *p )
+{
+  word w = *p;
+
+  if (!ishdr( w ))
+    return PAIR_TAG;
+  if (header( w ) == BV_HDR)
+    return BVEC_TAG;
+  if (header( w ) == VEC_HDR)
+    return VEC_TAG;
+  assert( header( w ) == header( PROC_HDR ) );
+  return PROC_TAG;
+}
+
+static word *allocate_old( pretenure_t *pt, int nbytes )
+{
+  semispace_t *ss = oh_current_space( pt->target );
+  ss_chunk_t *c = &ss->chunks[ ss->current ];
+  word *p;
+
+  if (c->top + nbytes/sizeof( word ) > c->lim)
+    return 0;
+  p = c->top;
+  c->top += nbytes/sizeof( word );
+
+  if (pt->pending_count == pt->pending_max) {
+    pt->pending_max *= 2;
+    pt->pending =
+      (word**)must_realloc( pt->pending, pt->pending_max*sizeof( word* ) );
+  }
+  pt->pending[ pt->pending_count++ ] = p;
+  pt->words_pretenured += nbytes/sizeof( word );
+  return p;
+}
+
+pretenure_t *create_pretenure( gc_t *gc, old_heap_t *target, int percent )
+{
+  pretenure_t *pt;
+
+  assert( target->current_space != 0 );
+
+  pt = (pretenure_t*)must_malloc( sizeof( pretenure_t ) );
+  pt->gc = gc;
+  pt->target = target;
+  pt->percent = percent;
+  pt->sites = (site_t*)must_malloc( SITE_TABLE_SIZE*sizeof( site_t ) );
+  memset( pt->sites, 0, SITE_TABLE_SIZE*sizeof( site_t ) );
+  pt->site_count = 0;
+  pt->sites_pretenured = 0;
+  pt->countdown = SAMPLE_BYTES;
+  pt->due = 0;
+  pt->sample_count = 0;
+  pt->pending_max = 1024;
+  pt->pending = (word**)must_malloc( pt->pending_max*sizeof( word* ) );
+  pt->pending_count = 0;
+  pt->words_pretenured = 0;
+  return pt;
+}
+
+word *pretenure_allocate( pretenure_t *pt, word *globals, int nbytes )
+{
+  site_t *s;
+
+  nbytes = roundup_balign( nbytes );
+  if (nbytes > GC_LARGE_OBJECT_LIMIT)
+    return 0;
+  s = site_of( pt, globals );
+  if (s == 0)
+    return 0;
+  if (s->pretenured)
+    return allocate_old( pt, nbytes );
+
+  pt->countdown -= nbytes;
+  if (pt->countdown <= 0) {
+    pt->countdown = SAMPLE_BYTES;
+    pt->due = s;
+  }
+  return 0;
+}
+
+void pretenure_sample( pretenure_t *pt, word *p )
+{
+  if (pt->due != 0 && pt->sample_count < SAMPLE_LIMIT) {
+    pt->samples[ pt->sample_count ].obj = p;
+    pt->samples[ pt->sample_count ].site = pt->due;
+    pt->sample_count++;
+  }
+  pt->due = 0;
+}
+
+void pretenure_before_collection( pretenure_t *pt )
+{
+  uremset_t *urs = pt->gc->the_remset;
+  int i;
+
+  for ( i = 0 ; i < pt->pending_count ; i++ ) {
+    word *p = pt->pending[i];
+    urs_add_elem( urs, tagptr( p, object_tag( p ) ) );
+  }
+  if (pt->pending_count > 0)
+    annoyingmsg( "Pretenuring: %d objects, %d words since last collection.",
+                 pt->pending_count, pt->words_pretenured );
+  pt->pending_count = 0;
+  pt->words_pretenured = 0;
+}
+
+void pretenure_after_collection( pretenure_t *pt )
+{
+  semispace_t *ss;
+  ss_chunk_t *c;
+  int i;
+
+  for ( i = 0 ; i < pt->sample_count ; i++ ) {
+    site_t *s = pt->samples[i].site;
+
+    s->samples++;
+    if (*pt->samples[i].obj == FORWARD_HDR)
+      s->survivors++;
+    if (!s->pretenured && s->samples >= MIN_SAMPLES &&
+        s->survivors*100 >= s->samples*pt->percent) {
+      s->pretenured = TRUE;
+      pt->sites_pretenured++;
+      annoyingmsg( "Pretenuring: site 0x%08x+%d, %d of %d samples survived.",
+                   s->code, s->offset, s->survivors, s->samples );
+    }
+  }
+  pt->sample_count = 0;
+  pt->due = 0;
+
+  if (pt->sites_pretenured > 0) {
+    ss = oh_current_space( pt->target );
+    c = &ss->chunks[ ss->current ];
+    if ((c->lim - c->top)*sizeof( word ) < TARGET_ROOM)
+      ss_expand( ss, GC_CHUNK_SIZE );
+  }
+}
+
+/* eof */
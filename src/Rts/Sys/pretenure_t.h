@@ -0,0 +1,64 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- allocation-site profiling and pretenuring.
+ *
+ * An allocation site is a call to the allocation millicode, identified
+ * by the code vector of the calling procedure and the return address
+ * within it.  While profiling is on, globals[ G_PRETENURE ] is nonzero
+ * and the optimized allocation millicode defers to mc_alloc(), which
+ * asks pretenure_allocate() where each object should go.
+ *
+ * Every so many bytes, an object allocated in the nursery is taken as
+ * a sample of its site.  After the next collection the sample is found
+ * to have survived if the collector left a forwarding header in it.
+ * A site whose samples survive at the requested rate is pretenured:
+ * its objects are then allocated in the area that the nursery promotes
+ * into, as though they had already survived one collection.
+ *
+ * Compiled code initializes a new object without the write barrier,
+ * so a pretenured object is recorded, and added to the remembered set
+ * at the start of the next collection.
+ *
+ * Decisions are not revisited; the site table is simply forgotten
+ * when it fills up.  Allocation that compiled code does in line, and
+ * allocation by mutators other than the main one, is not profiled.
+ */
+
+#ifndef INCLUDED_PRETENURE_T_H
+#define INCLUDED_PRETENURE_T_H
+
+#include "larceny-types.h"
+
+pretenure_t *create_pretenure( gc_t *gc, old_heap_t *target, int percent );
+  /* Creates the site table for a collector that pretenures into
+     target.  A site is pretenured once at least percent percent of its
+     samples have survived their first collection.
+     */
+
+word *pretenure_allocate( pretenure_t *pt, word *globals, int nbytes );
+  /* Returns an old object of nbytes bytes if the site that called the
+     allocation millicode is pretenured, or NULL if the object must be
+     allocated in the nursery.  In that case the caller must pass the
+     new object to pretenure_sample().
+     */
+
+void pretenure_sample( pretenure_t *pt, word *p );
+  /* Takes the nursery object p, just allocated after a NULL return
+     from pretenure_allocate(), as a sample if one is due.
+     */
+
+void pretenure_before_collection( pretenure_t *pt );
+  /* Adds the objects pretenured since the last collection to the
+     remembered set.
+     */
+
+void pretenure_after_collection( pretenure_t *pt );
+  /* requires: the nursery has been evacuated but not yet reused.
+     Counts the samples that survived and updates the decisions.
+     */
+
+#endif /* INCLUDED_PRETENURE_T_H */
+
+/* eof */
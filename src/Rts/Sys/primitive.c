@@ -15,6 +15,7 @@
 #include "signals.h"
 #include "gc_t.h"
 #include "gc.h"
+#include "gclib.h"
 #include "stats.h"
 
 extern void mem_icache_flush( void *lo, void *limit );
@@ -208,6 +209,34 @@ void primitive_allocate_nonmoving( word w_length, word w_tag )
     allocate_nonmoving( nativeint( w_length ), nativeint( w_tag ) );
 }
 
+/* The size of the file is returned as a number of pages and a
+   remainder, as it may not fit in a fixnum.
+   */
+void primitive_open_mapped( word w_fn, word w_size )
+{
+#if OSDEP_MAP_FILE
+  char *fn = string2asciiz( w_fn );
+  long long size;
+  int fd;
+
+  fd = (fn == 0 ? -1 : osdep_open_mapped( fn, &size ));
+  if (fd >= 0) {
+    vector_set( w_size, 0, fixnum( size / PAGESIZE ) );
+    vector_set( w_size, 1, fixnum( size % PAGESIZE ) );
+  }
+  globals[ G_RESULT ] = fixnum( fd );
+#else
+  globals[ G_RESULT ] = fixnum( -1 );
+#endif
+}
+
+void primitive_map_file( word w_fd, word w_page, word w_length )
+{
+  globals[ G_RESULT ] = allocate_mapped( nativeint( w_fd ),
+                                         nativeint( w_page ),
+                                         nativeint( w_length ) );
+}
+
 void primitive_object_to_address( word w_obj )
 {
   /* Invariant: the pointer _must_ point to nonrelocatable memory,
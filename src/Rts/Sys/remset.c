@@ -56,6 +56,26 @@
  * (an array of two-word structures would have been more natural) is
  * to allow the remembered-set forwarding scanner to scan more than one
  * object at a time, an optimization that is not currently implemented.
+ *
+ * Bucketed tables.
+ *
+ * After rs_use_bucketed_tables( TRUE ), sets are created with a different
+ * representation: an open-addressing hash table with no node pool.  The
+ * table is divided into 64-byte buckets, one cache line each, that hold
+ * the objects themselves.  An object hashes to a bucket and is stored in
+ * the first free slot of that bucket or, if it is full, of the next one
+ * (linear probing by bucket).  A lookup compares the whole bucket with
+ * the object at once and stops at the first bucket that has an empty
+ * slot, so most probes touch one cache line.  On x86, the comparison
+ * uses SSE2 if the processor has it, as determined by CPUID when the
+ * bucketed tables are turned on; the SSE2 kernel is compiled with a
+ * target attribute, so the rest of the system need not be.  Removed objects leave a tombstone, so that the probe
+ * sequences of other objects are not cut short.
+ *
+ * The table is rebuilt, twice as large if it is more than half live,
+ * when more than three quarters of its slots are used or tombstones.
+ * That counts as an overflow.  Scanning the set walks the table, which
+ * is a sequential pass over memory rather than a pass over the pool.
  */
 
 #define GC_INTERNAL
@@ -71,6 +91,16 @@
 #include "gc_t.h"
 #include "summary_t.h"
 
+#if (defined(__i386__) || defined(__x86_64__)) && defined(BITS_32) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || \
+                            (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+# define SSE2_BUCKETS 1
+# include <emmintrin.h>
+#else
+# define SSE2_BUCKETS 0
+#endif
+
 /* This is an artifact of the low-level implementation of the hash pool;
    see comments above. */
 
@@ -98,11 +128,24 @@ struct remset_data {
   int            numpools;	/* Number of pools */
   remset_stats_t stats;		/* Remset statistics */
   unsigned       mem_attribute;	/* Attr identifying which Rts part owns mem */
+
+  /* Bucketed tables only; the pool fields above are unused. */
+  bool           bucketed;
+  int            bkt_shift;	/* Hash shift: 32-log2(number of buckets) */
+  int            occupied;	/* Slots that are not EMPTY_SLOT */
+  bool           enumerating;	/* rs_enumerate() is walking the table */
+  word           *retired_bot;	/* Table replaced during rs_enumerate() */
+  word           *retired_lim;
 };
 
 #define DATA(rs)                ((remset_data_t*)(rs->data))
 #define hash_object( w, mask )  (((w) >> 4) & (mask))
 
+#define BUCKET_WORDS            ((int)(64/sizeof(word)))
+#define EMPTY_SLOT              0
+#define REMOVED_SLOT            1	/* Never a tagged pointer */
+#define hash_bucket( w, shift ) ((((w) >> 3) * 2654435761U) >> (shift))
+
 
 /* Internal */
 
@@ -113,9 +156,43 @@ static int identity = 0;
   /* Counter for assigning identity to remembered sets.
      */
 
+static bool use_bucketed_tables = FALSE;
+  /* Representation of the sets created from now on.
+     */
+
 static int    ilog2( unsigned n );
 static pool_t *allocate_pool_segment( unsigned entries, unsigned attr );
 static void   free_pool_segments( pool_t *first, unsigned entries );
+static void   bkt_init( remset_t *rs, int tbl_entries );
+static void   bkt_clear( remset_t *rs );
+static bool   bkt_add_elem( remset_t *rs, word w, bool check );
+static word   *bkt_find( remset_data_t *data, word w );
+static void   bkt_enumerate( remset_t *rs, 
+                             bool (*scanner)( word, void*, unsigned* ),
+                             void *data );
+static void   bkt_stats( remset_t *rs );
+static void   bkt_init_summary( remset_t *rs, summary_t *s );
+static void   bkt_describe_self( remset_t *rs );
+static unsigned bucket_match_c( word *b, word w );
+#if SSE2_BUCKETS
+static unsigned bucket_match_sse2( word *b, word w );
+#endif
+
+static unsigned (*bucket_match)( word *b, word w ) = bucket_match_c;
+  /* Bucket comparison kernel, chosen by rs_use_bucketed_tables().
+     */
+
+void rs_use_bucketed_tables( bool flag )
+{
+  use_bucketed_tables = flag;
+#if SSE2_BUCKETS
+  if (flag) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports( "sse2" ))
+      bucket_match = bucket_match_sse2;
+  }
+#endif
+}
 
 static remset_t *
 create_labelled_remset_with_owner_attrib
@@ -183,12 +260,23 @@ create_labelled_remset_with_owner_attrib
   if (pool_entries == 0) pool_entries = DEFAULT_REMSET_POOLSIZE;
   if (tbl_entries == 0) tbl_entries = DEFAULT_REMSET_TBLSIZE;
 
-  annoyingmsg( "Allocated remembered set\n  hash=%d pool=%d",
-	       tbl_entries, pool_entries );
-
   rs   = (remset_t*)must_malloc( sizeof( remset_t ) );
   data = (remset_data_t*)must_malloc( sizeof( remset_data_t ) );
 
+  if (use_bucketed_tables) {
+    annoyingmsg( "Allocated remembered set\n  bucketed=%d", tbl_entries );
+    memset( data, 0, sizeof( remset_data_t ) );
+    data->bucketed = TRUE;
+    data->self = stats_new_remembered_set( major_id, minor_id );
+    data->mem_attribute = owner_attrib;
+    rs->data = data;
+    bkt_init( rs, tbl_entries );
+    return rs;
+  }
+
+  annoyingmsg( "Allocated remembered set\n  hash=%d pool=%d",
+	       tbl_entries, pool_entries );
+
   while(1) {
     heapptr = gclib_alloc_rts( tbl_entries*sizeof(word), 
 			       owner_attrib );
@@ -209,6 +297,7 @@ create_labelled_remset_with_owner_attrib
 
   /* Misc */
   memset( &data->stats, 0, sizeof( data->stats ));
+  data->bucketed = FALSE;
   data->pool_entries = pool_entries;
   data->self = stats_new_remembered_set( major_id, minor_id );
   data->mem_attribute = owner_attrib;
@@ -230,6 +319,11 @@ static void rs_clear_opt( remset_t *rs, bool use_recycle_pool )
 
   supremely_annoyingmsg( "REMSET @0x%p: clear", (void*)rs );
 
+  if (data->bucketed) {
+    bkt_clear( rs );
+    return;
+  }
+
   /* Clear hash table */
   for ( p=data->tbl_bot, i=data->tbl_lim-data->tbl_bot ; i > 0 ; p++, i-- )
     *p = (word)(word*)0;
@@ -265,7 +359,8 @@ void rs_recycle( remset_t *rs )
 
 void rs_empty_recycling() 
 {
-  assert( recycled_pool_entries_per > 0 );
+  if (recycled_pool_entries_per <= 0)
+    return;                     /* Only bucketed sets were recycled */
   free_pool_segments( recycled_pool, recycled_pool_entries_per );
   recycled_pool = NULL;
   recycled_pool_entries_per = -1;
@@ -304,6 +399,15 @@ void rs_del_elem( remset_t *rs, word w )
   word mask, *tbl, *b, *pooltop, *poollim, tblsize, h;
   bool overflowed = FALSE;
   remset_data_t *data = DATA(rs);
+
+  if (data->bucketed) {
+    if ((b = bkt_find( data, w )) != 0) {
+      *b = REMOVED_SLOT;
+      rs->live -= 1;
+    }
+    return;
+  }
+
   pooltop = data->curr_pool->top;
   poollim = data->curr_pool->lim;
   tbl = data->tbl_bot;
@@ -329,6 +433,9 @@ bool rs_add_elem_new( remset_t *rs, word w )
 
   assert2(! rs_isremembered( rs, w ));
 
+  if (data->bucketed)
+    return bkt_add_elem( rs, w, FALSE );
+
   pooltop = data->curr_pool->top;
   poollim = data->curr_pool->lim;
   tbl = data->tbl_bot;
@@ -361,6 +468,10 @@ bool rs_add_elem( remset_t *rs, word w )
   word mask, *tbl, *b, *pooltop, *poollim, tblsize, h;
   bool overflowed = FALSE;
   remset_data_t *data = DATA(rs);
+
+  if (data->bucketed)
+    return bkt_add_elem( rs, w, TRUE );
+
   pooltop = data->curr_pool->top;
   poollim = data->curr_pool->lim;
   tbl = data->tbl_bot;
@@ -394,6 +505,7 @@ bool rs_add_elem( remset_t *rs, word w )
 bool rs_add_elems_distribute( remset_t **remset, word *bot, word *top ) 
 {
   word *p, *q, mask, *tbl, w, *b, *pooltop, *poollim, tblsize, h;
+  word last = 0;
   remset_t *rs;
   int gno;
   bool added_word; 
@@ -413,6 +525,11 @@ bool rs_add_elems_distribute( remset_t **remset, word *bot, word *top )
       /* fixnums in SSB log indicate which field was written to. */
       continue;
     }
+    if (w == last) {
+      /* Sorted batch: another field of the object just added. */
+      continue;
+    }
+    last = w;
     gno = gen_of(w);
     rs = remset[gno];
     overflowed |= rs_add_elem( rs, w );
@@ -424,6 +541,7 @@ bool rs_add_elems_distribute( remset_t **remset, word *bot, word *top )
 bool rs_add_elems_funnel( remset_t *rs, word *bot, word *top ) 
 {
   word *p, *q, mask, *tbl, w, *b, *pooltop, *poollim, tblsize, h;
+  word last = 0;
   int gno;
   bool added_word; 
   bool overflowed = FALSE;
@@ -442,6 +560,11 @@ bool rs_add_elems_funnel( remset_t *rs, word *bot, word *top )
       /* fixnums in SSB log indicate which field was written to. */
       continue;
     }
+    if (w == last) {
+      /* Sorted batch: another field of the object just added. */
+      continue;
+    }
+    last = w;
     overflowed |= rs_add_elem( rs, w );
   }
 
@@ -464,6 +587,11 @@ void rs_enumerate( remset_t *rs,
 
   supremely_annoyingmsg( "REMSET @0x%p: scan", (void*)rs );
 
+  if (DATA(rs)->bucketed) {
+    bkt_enumerate( rs, scanner, data );
+    return;
+  }
+
   ps = DATA(rs)->first_pool;
   while (1) {
     p = ps->bot;
@@ -510,6 +638,11 @@ void rs_stats( remset_t *rs )
 {
   remset_data_t *data = DATA(rs);
 
+  if (data->bucketed) {
+    bkt_stats( rs );
+    return;
+  }
+
   data->stats.allocated = 
     (data->tbl_lim - data->tbl_bot) +
     (data->pool_entries*data->numpools*WORDS_PER_POOL_ENTRY);
@@ -534,6 +667,9 @@ bool rs_isremembered( remset_t *rs, word w )
 
   assert( WORDS_PER_POOL_ENTRY == 2 );
 
+  if (data->bucketed)
+    return bkt_find( data, w ) != 0;
+
   /* Search hash table */
   tbl = data->tbl_bot;
   tblsize = data->tbl_lim - tbl;
@@ -591,6 +727,10 @@ void rs_init_summary( remset_t *rs, int max_words_per_step,
   pool_t *ps;
   word *p, *q;
   assert( max_words_per_step == -1 ); /* no support for incremental yet */
+  if (DATA(rs)->bucketed) {
+    bkt_init_summary( rs, s );
+    return;
+  }
   summary_init( s, rs->live, &rs_pool_next_chunk );
   ps = DATA(rs)->first_pool;
   p = NULL;
@@ -658,6 +798,332 @@ static int ilog2( unsigned n )
   return -1;
 }
 
+/* Bucketed tables */
+
+/* Return a mask with bit i set iff slot i of bucket b holds w. */
+
+static unsigned bucket_match_c( word *b, word w )
+{
+  unsigned i, m = 0;
+
+  for ( i = 0 ; i < BUCKET_WORDS ; i++ )
+    if (b[i] == w)
+      m |= 1U << i;
+  return m;
+}
+
+#if SSE2_BUCKETS
+__attribute__((target("sse2")))
+static unsigned bucket_match_sse2( word *b, word w )
+{
+  __m128i key = _mm_set1_epi32( (int)w );
+  __m128i *v = (__m128i*)b;
+  unsigned m0, m1, m2, m3;
+
+  m0 = _mm_movemask_ps( _mm_castsi128_ps(
+         _mm_cmpeq_epi32( _mm_load_si128( v ), key ) ) );
+  m1 = _mm_movemask_ps( _mm_castsi128_ps(
+         _mm_cmpeq_epi32( _mm_load_si128( v+1 ), key ) ) );
+  m2 = _mm_movemask_ps( _mm_castsi128_ps(
+         _mm_cmpeq_epi32( _mm_load_si128( v+2 ), key ) ) );
+  m3 = _mm_movemask_ps( _mm_castsi128_ps(
+         _mm_cmpeq_epi32( _mm_load_si128( v+3 ), key ) ) );
+  return m0 | (m1 << 4) | (m2 << 8) | (m3 << 12);
+}
+#endif /* SSE2_BUCKETS */
+
+/* Returns the index of the lowest set bit of m != 0. */
+static int first_slot( unsigned m )
+{
+#if defined(__GNUC__)
+  return __builtin_ctz( m );
+#else
+  int i = 0;
+  for ( ; (m & 1) == 0 ; m >>= 1 )
+    i++;
+  return i;
+#endif
+}
+
+static word *bkt_alloc_table( remset_data_t *data, int entries )
+{
+  word *tbl;
+
+  while (1) {
+    tbl = gclib_alloc_rts( entries*sizeof(word), data->mem_attribute );
+    if (tbl != 0) break;
+    memfail( MF_RTS, "Can't allocate table for remembered set." );
+  }
+  memset( tbl, 0, entries*sizeof(word) );
+  return tbl;
+}
+
+static void bkt_set_table( remset_data_t *data, word *tbl, int entries )
+{
+  int buckets;
+
+  data->tbl_bot = tbl;
+  data->tbl_lim = tbl + entries;
+  data->bkt_shift = 32;
+  for ( buckets = entries / BUCKET_WORDS ; buckets > 1 ; buckets >>= 1 )
+    data->bkt_shift--;
+  data->occupied = 0;
+}
+
+static void bkt_init( remset_t *rs, int tbl_entries )
+{
+  remset_data_t *data = DATA(rs);
+
+  /* At least two buckets, so that the hash shift is less than 32. */
+  tbl_entries = max( tbl_entries, 2*BUCKET_WORDS );
+  bkt_set_table( data, bkt_alloc_table( data, tbl_entries ), tbl_entries );
+  rs->live = 0;
+  rs->has_overflowed = FALSE;
+}
+
+static void bkt_clear( remset_t *rs )
+{
+  remset_data_t *data = DATA(rs);
+
+  memset( data->tbl_bot, 0, (data->tbl_lim - data->tbl_bot)*sizeof(word) );
+  data->occupied = 0;
+  rs->has_overflowed = FALSE;
+  rs->live = 0;
+  data->stats.cleared++;
+}
+
+/* Returns the slot that holds w, or 0. */
+static word *bkt_find( remset_data_t *data, word w )
+{
+  word *tbl = data->tbl_bot;
+  word mask = (data->tbl_lim - tbl) / BUCKET_WORDS - 1;
+  word i = hash_bucket( w, data->bkt_shift );
+  word *b;
+  unsigned m;
+
+  while (1) {
+    b = tbl + i*BUCKET_WORDS;
+    if ((m = bucket_match( b, w )) != 0)
+      return b + first_slot( m );
+    if (bucket_match( b, EMPTY_SLOT ) != 0)
+      return 0;
+    i = (i+1) & mask;
+  }
+}
+
+/* Copies the live entries of the current table into a new one: twice
+   as large if more than half of it is live, otherwise the same size,
+   which gets rid of the tombstones.  A table that rs_enumerate() is
+   walking is kept until it is done.  Returns TRUE if the table grew. */
+static bool bkt_rebuild( remset_t *rs )
+{
+  remset_data_t *data = DATA(rs);
+  word *old_bot = data->tbl_bot, *old_lim = data->tbl_lim;
+  int entries = old_lim - old_bot;
+  bool grow = (rs->live > entries/2);
+  word *p, *tbl, *b, mask, i;
+  unsigned m;
+
+  if (grow) {
+    entries *= 2;
+    annoyingmsg( "Remset @0x%p overflow, entries=%d", (void*)rs, rs->live );
+  }
+  tbl = bkt_alloc_table( data, entries );
+  bkt_set_table( data, tbl, entries );
+  mask = entries / BUCKET_WORDS - 1;
+
+  for ( p = old_bot ; p < old_lim ; p++ ) {
+    if (*p == EMPTY_SLOT || *p == REMOVED_SLOT)
+      continue;
+    i = hash_bucket( *p, data->bkt_shift );
+    while ((m = bucket_match( b = tbl + i*BUCKET_WORDS, EMPTY_SLOT )) == 0)
+      i = (i+1) & mask;
+    b[ first_slot( m ) ] = *p;
+    data->occupied++;
+  }
+
+  if (data->enumerating && data->retired_bot == 0) {
+    data->retired_bot = old_bot;
+    data->retired_lim = old_lim;
+  }
+  else
+    gclib_free( old_bot, (old_lim - old_bot)*sizeof(word) );
+
+  if (grow)
+    rs->has_overflowed = TRUE;
+  return grow;
+}
+
+static bool bkt_add_elem( remset_t *rs, word w, bool check )
+{
+  remset_data_t *data = DATA(rs);
+  word *tbl = data->tbl_bot;
+  int entries = data->tbl_lim - tbl;
+  word mask = entries / BUCKET_WORDS - 1;
+  word i = hash_bucket( w, data->bkt_shift );
+  word *b, *slot = 0;
+  unsigned m;
+
+  /* Reuse the first tombstone on the probe path, if any, but look on
+     to the first bucket with an empty slot to see whether w is there. */
+  while (1) {
+    b = tbl + i*BUCKET_WORDS;
+    if (check && bucket_match( b, w ) != 0)
+      return FALSE;
+    if (slot == 0 && (m = bucket_match( b, REMOVED_SLOT )) != 0) {
+      slot = b + first_slot( m );
+      if (!check) break;
+    }
+    if ((m = bucket_match( b, EMPTY_SLOT )) != 0) {
+      if (slot == 0) {
+        slot = b + first_slot( m );
+        data->occupied++;
+      }
+      break;
+    }
+    i = (i+1) & mask;
+  }
+
+  *slot = w;
+  data->stats.recorded += 1;
+  rs->live += 1;
+
+  if (data->occupied > entries/4*3)
+    return bkt_rebuild( rs );
+  else
+    return FALSE;
+}
+
+/* The scanner may add to the set, and if that rebuilds the table the
+   walk continues over the old one; an entry to be removed is then
+   looked up in the new table.  Entries added during the walk may or
+   may not be visited. */
+static void bkt_enumerate( remset_t *rs, 
+                           bool (*scanner)( word, void*, unsigned* ),
+                           void *data )
+{
+  remset_data_t *rsdata = DATA(rs);
+  word *p, *q, *lim, w;
+  unsigned word_count = 0;
+  unsigned removed_count = 0;
+  unsigned scanned = 0;
+
+  assert( !rsdata->enumerating );
+  rsdata->enumerating = TRUE;
+  rsdata->retired_bot = 0;
+
+  p = rsdata->tbl_bot;
+  lim = rsdata->tbl_lim;
+  for ( ; p < lim ; p++ ) {
+    w = *p;
+    if (w == EMPTY_SLOT || w == REMOVED_SLOT)
+      continue;
+    if (!scanner( w, data, &word_count )) {
+      if (rsdata->retired_bot == 0)
+        *p = REMOVED_SLOT;
+      else if ((q = bkt_find( rsdata, w )) != 0)
+        *q = REMOVED_SLOT;
+      removed_count++;
+    }
+    scanned++;
+  }
+
+  rsdata->enumerating = FALSE;
+  if (rsdata->retired_bot != 0) {
+    gclib_free( rsdata->retired_bot, 
+                (rsdata->retired_lim - rsdata->retired_bot)*sizeof(word) );
+    rsdata->retired_bot = rsdata->retired_lim = 0;
+  }
+
+  rsdata->stats.objs_scanned += scanned;
+  rsdata->stats.max_objs_scanned = 
+    max( rsdata->stats.max_objs_scanned, scanned );
+  rsdata->stats.words_scanned += word_count;
+  rsdata->stats.max_words_scanned =
+    max( rsdata->stats.max_words_scanned, word_count );
+  rsdata->stats.removed += removed_count;
+  rs->live -= removed_count;
+  rsdata->stats.scanned++;
+  supremely_annoyingmsg( "REMSET @0x%x: removed %d elements (total %d).", 
+			 (word)rs, removed_count, rsdata->stats.removed );
+}
+
+static void bkt_stats( remset_t *rs )
+{
+  remset_data_t *data = DATA(rs);
+
+  data->stats.allocated = data->tbl_lim - data->tbl_bot;
+  data->stats.used = data->occupied;
+  data->stats.live = rs->live;
+
+  stats_add_remset_stats( data->self, &data->stats );
+  memset( &data->stats, 0, sizeof( remset_stats_t ) );
+}
+
+/* Each chunk is a run of adjacent live slots. */
+static bool bkt_next_chunk( summary_t *this, word **start, word **lim, 
+                            bool *duplicate_entries ) 
+{
+  word *p = (word*) this->cursor1;
+  word *q = (word*) this->cursor2;
+
+  while (p < q && (*p == EMPTY_SLOT || *p == REMOVED_SLOT))
+    p++;
+  if (p == q) {
+    this->cursor1 = p;
+    return FALSE;
+  }
+  *start = p;
+  while (p < q && *p != EMPTY_SLOT && *p != REMOVED_SLOT)
+    p++;
+  *lim = p;
+  *duplicate_entries = FALSE;
+  this->cursor1 = p;
+  return TRUE;
+}
+
+static void bkt_init_summary( remset_t *rs, summary_t *s )
+{
+  summary_init( s, rs->live, &bkt_next_chunk );
+  s->cursor1 = DATA(rs)->tbl_bot;
+  s->cursor2 = DATA(rs)->tbl_lim;
+}
+
+/* Prints a histogram of the distance in buckets from each entry's
+   home bucket. */
+static void bkt_describe_self( remset_t *rs )
+{
+  remset_data_t *data = DATA(rs);
+  int entries = data->tbl_lim - data->tbl_bot;
+  int buckets = entries / BUCKET_WORDS;
+  int i, d, maxd = 0, sum = 0;
+  word w;
+
+#define DIST_LEN 64
+  int disthist[DIST_LEN];
+
+  for ( i = 0 ; i < DIST_LEN ; i++ )
+    disthist[i] = 0;
+  for ( i = 0 ; i < entries ; i++ ) {
+    w = data->tbl_bot[i];
+    if (w == EMPTY_SLOT || w == REMOVED_SLOT)
+      continue;
+    d = (i/BUCKET_WORDS - hash_bucket( w, data->bkt_shift ) + buckets)
+        % buckets;
+    sum += d;
+    maxd = max( maxd, d );
+    disthist[ min( d, DIST_LEN-1 ) ] += 1;
+  }
+  consolemsg( "TBL%d bucketed: %d buckets, %d live, %d tombstones", 
+              rs->identity, buckets, rs->live, data->occupied - rs->live );
+  consolemsg( "  distance mean: %d max: %d", sum/max( rs->live, 1 ), maxd );
+  for ( i = 0 ; i < DIST_LEN ; i++ ) {
+    if (disthist[i] != 0)
+      consolemsg( "  #%d : %d", i, disthist[i] );
+  }
+#undef DIST_LEN
+}
+
 /* FIXME: sum_sqrcount is declared and incremented but never used. */
 
 void rs_describe_self( remset_t *rs ) 
@@ -669,6 +1135,11 @@ void rs_describe_self( remset_t *rs )
 #define HIST_LEN 500
   int counthist[HIST_LEN];
 
+  if (data->bucketed) {
+    bkt_describe_self( rs );
+    return;
+  }
+
   tbl = data->tbl_bot;
   tblsize = data->tbl_lim - tbl;
   mask = tblsize-1;
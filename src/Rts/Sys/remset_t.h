@@ -29,8 +29,8 @@ struct remset {
        */
 
   bool has_overflowed;
-    /* TRUE if the remembered set node pool has overflowed since the
-       last time the set was cleared.
+    /* TRUE if the remembered set node pool has overflowed (or a
+       bucketed table has grown) since the last time the set was cleared.
        */
 
   void *data;			/* Implementation's data */
@@ -77,6 +77,13 @@ create_labelled_remset( int tbl_ent,
      are used to label the remset in the stats() module.
      */
 
+void rs_use_bucketed_tables( bool flag );
+  /* If flag is TRUE, then sets created from now on are open-addressing
+     hash tables in cache-line buckets instead of chained hash tables
+     with a node pool; see remset.c.  They have no pool, so pool_ent is
+     ignored, and they grow instead of overflowing the pool.
+     */
+
 void rs_clear( remset_t *remset );
   /* Clears the remembered set.
      */
@@ -101,14 +108,16 @@ bool rs_add_elem( remset_t *rs, word w );
 bool rs_add_elems_distribute( remset_t **remset, word *bot, word *top );
   /* Copies the elements in the buffer [bot,top) into remset[i],
      where i is the gno for each element.
-     Every element in the buffer is subject to a collision check.
+     Every element in the buffer is subject to a collision check,
+     except one equal to the element before it (as in a sorted batch).
 
      Returns TRUE if the remset overflowed during the addition.
      */
 
 bool rs_add_elems_funnel( remset_t *rs, word *bot, word *top );
   /* Copies the elements in the buffer [bot,top) into rs.
-     Every element in the buffer is subject to a collision check.
+     Every element in the buffer is subject to a collision check,
+     except one equal to the element before it (as in a sorted batch).
 
      Returns TRUE if the remset overflowed during the addition.
      */
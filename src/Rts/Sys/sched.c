@@ -0,0 +1,424 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- task scheduler.
+ *
+ * See sched_t.h for the interface.
+ *
+ * The scheduler is used by the Scheme thread only, and has neither
+ * threads nor locks of its own.  A sleep is a deadline on a heap kept
+ * in deadline order.  On Linux, a wait for a file descriptor is
+ * registered, one shot, with an epoll instance, so that thousands of
+ * descriptors can be waited for at once.  A wait that epoll does not
+ * take -- the descriptor already has a wait registered, or is a kind
+ * that epoll does not support -- and every wait on other systems goes
+ * on a list of waits that are polled directly.
+ *
+ * sched_next() waits in a single poll() on the epoll descriptor and
+ * the directly polled descriptors, for no longer than the timeout it
+ * was given and the time to the nearest deadline, and then completes
+ * the waits that are ready and the sleeps that are due.  Nothing is
+ * blocked on behalf of a task anywhere else.  Any wait for a
+ * descriptor that is ready at once completes in sched_submit() without
+ * being queued.
+ *
+ * The syscalls that the tasking library uses are at the end; they
+ * create the scheduler on first use.
+ */
+
+#include "larceny.h"
+#include "sched_t.h"
+
+#if defined(UNIX)
+# include <errno.h>
+# include <time.h>
+# include <poll.h>
+#endif
+
+#if defined(UNIX) && defined(__linux__)
+# define SCHED_EPOLL 1
+# include <sys/epoll.h>
+#else
+# define SCHED_EPOLL 0
+#endif
+
+#define SCHED_EVENTS     64         /* Events taken per epoll_wait() */
+
+typedef struct sched_job sched_job_t;
+
+struct sched_job {
+  int         task;
+  int         kind;
+  int         arg;
+  int         result;
+  long long   deadline;         /* A sleep's end, in milliseconds */
+  sched_job_t *next;            /* On the completed list */
+};
+
+struct sched {
+  int         outstanding;      /* Submitted, not yet returned */
+  sched_job_t *completed;       /* Completed list, oldest first */
+  sched_job_t *completed_last;
+  sched_job_t **sleeping;       /* Heap of sleeps, nearest deadline first */
+  int         nsleeping;
+  int         sleeping_size;
+  sched_job_t **polled;         /* Descriptor waits polled directly */
+  int         npolled;
+  int         polled_size;
+#if defined(UNIX)
+  struct pollfd *pollfds;       /* polled_size+1 entries */
+#endif
+#if SCHED_EPOLL
+  int         epfd;             /* The epoll instance, or -1 */
+  int         nepoll;           /* Waits registered with epfd */
+#endif
+};
+
+static void complete_job( sched_t *s, sched_job_t *j )
+{
+  j->next = 0;
+  if (s->completed == 0)
+    s->completed = j;
+  else
+    s->completed_last->next = j;
+  s->completed_last = j;
+}
+
+#if defined(UNIX)
+
+/* Returns the current time in milliseconds, from an arbitrary start. */
+
+static long long now_ms( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/* Returns the events for which fd is ready now, or 0. */
+
+static int ready_fd( int fd, short events )
+{
+  struct pollfd p;
+  int r;
+
+  p.fd = fd;
+  p.events = events;
+  do {
+    r = poll( &p, 1, 0 );
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    return -1;
+  return p.revents & (events|POLLHUP|POLLERR);
+}
+
+static short events_of( sched_job_t *j )
+{
+  return (j->kind == SCHED_JOB_INPUT ? POLLIN : POLLOUT);
+}
+
+/* Sleep heap operations. */
+
+static void sleep_insert( sched_t *s, sched_job_t *j )
+{
+  int i, parent;
+
+  if (s->nsleeping == s->sleeping_size) {
+    s->sleeping_size = max( 2*s->sleeping_size, 16 );
+    s->sleeping = (sched_job_t**)
+      must_realloc( s->sleeping, sizeof( sched_job_t* )*s->sleeping_size );
+  }
+  i = s->nsleeping++;
+  while (i > 0) {
+    parent = (i-1)/2;
+    if (s->sleeping[parent]->deadline <= j->deadline)
+      break;
+    s->sleeping[i] = s->sleeping[parent];
+    i = parent;
+  }
+  s->sleeping[i] = j;
+}
+
+static sched_job_t *sleep_remove_first( sched_t *s )
+{
+  sched_job_t *first = s->sleeping[0];
+  sched_job_t *last = s->sleeping[ --s->nsleeping ];
+  int i = 0, child;
+
+  while ((child = 2*i+1) < s->nsleeping) {
+    if (child+1 < s->nsleeping &&
+        s->sleeping[child+1]->deadline < s->sleeping[child]->deadline)
+      child++;
+    if (last->deadline <= s->sleeping[child]->deadline)
+      break;
+    s->sleeping[i] = s->sleeping[child];
+    i = child;
+  }
+  if (s->nsleeping > 0)
+    s->sleeping[i] = last;
+  return first;
+}
+
+static void poll_insert( sched_t *s, sched_job_t *j )
+{
+  if (s->npolled == s->polled_size) {
+    s->polled_size = max( 2*s->polled_size, 16 );
+    s->polled = (sched_job_t**)
+      must_realloc( s->polled, sizeof( sched_job_t* )*s->polled_size );
+    s->pollfds = (struct pollfd*)
+      must_realloc( s->pollfds, sizeof( struct pollfd )*(s->polled_size+1) );
+  }
+  s->polled[ s->npolled++ ] = j;
+}
+
+#if SCHED_EPOLL
+/* Returns TRUE if epoll took the job. */
+
+static bool epoll_submit( sched_t *s, sched_job_t *j )
+{
+  struct epoll_event ev;
+
+  if (s->epfd < 0)
+    return FALSE;
+  ev.events = EPOLLONESHOT | events_of( j );
+  ev.data.ptr = j;
+  if (epoll_ctl( s->epfd, EPOLL_CTL_ADD, j->arg, &ev ) != 0)
+    return FALSE;
+  s->nepoll++;
+  return TRUE;
+}
+
+/* Completes the waits that epoll reports as ready. */
+
+static void epoll_reap( sched_t *s )
+{
+  struct epoll_event events[ SCHED_EVENTS ];
+  int i, n;
+
+  do {
+    n = epoll_wait( s->epfd, events, SCHED_EVENTS, 0 );
+    for ( i=0 ; i < n ; i++ ) {
+      sched_job_t *j = (sched_job_t*)events[i].data.ptr;
+
+      /* Deregister, so that the task can wait for the descriptor
+         again as soon as it sees the completion. */
+      epoll_ctl( s->epfd, EPOLL_CTL_DEL, j->arg, 0 );
+      s->nepoll--;
+      /* The epoll event bits are the poll event bits on Linux. */
+      j->result = events[i].events & (POLLIN|POLLOUT|POLLHUP|POLLERR);
+      complete_job( s, j );
+    }
+  } while (n == SCHED_EVENTS);
+}
+#endif
+
+/* Waits up to timeout_ms milliseconds for a descriptor to become
+   ready, then completes the waits that are ready and the sleeps that
+   are due.  Returns FALSE if the wait was cut short by a signal. */
+
+static bool gather( sched_t *s, int timeout_ms )
+{
+  int i, k, n, r;
+
+  n = 0;
+#if SCHED_EPOLL
+  if (s->nepoll > 0) {
+    s->pollfds[n].fd = s->epfd;
+    s->pollfds[n].events = POLLIN;
+    n++;
+  }
+#endif
+  for ( i=0 ; i < s->npolled ; i++, n++ ) {
+    s->pollfds[n].fd = s->polled[i]->arg;
+    s->pollfds[n].events = events_of( s->polled[i] );
+  }
+  /* With no descriptors, this is a sleep. */
+  r = poll( s->pollfds, n, timeout_ms );
+
+  if (r > 0) {
+    n = 0;
+#if SCHED_EPOLL
+    if (s->nepoll > 0 && s->pollfds[n++].revents != 0)
+      epoll_reap( s );
+#endif
+    for ( i=0, k=0 ; i < s->npolled ; i++, n++ ) {
+      sched_job_t *j = s->polled[i];
+      int revents = s->pollfds[n].revents;
+
+      if (revents & POLLNVAL) {
+        j->result = -1;
+        complete_job( s, j );
+      }
+      else if (revents != 0) {
+        j->result = revents & (events_of( j )|POLLHUP|POLLERR);
+        complete_job( s, j );
+      }
+      else
+        s->polled[k++] = j;
+    }
+    s->npolled = k;
+  }
+
+  if (s->nsleeping > 0) {
+    long long now = now_ms();
+
+    while (s->nsleeping > 0 && s->sleeping[0]->deadline <= now) {
+      sched_job_t *j = sleep_remove_first( s );
+      j->result = 0;
+      complete_job( s, j );
+    }
+  }
+  return r >= 0 || errno != EINTR;
+}
+
+#endif /* UNIX */
+
+sched_t *create_sched( void )
+{
+  sched_t *s;
+
+  s = (sched_t*)must_malloc( sizeof( sched_t ) );
+  s->outstanding = 0;
+  s->completed = s->completed_last = 0;
+  s->sleeping = 0;
+  s->nsleeping = s->sleeping_size = 0;
+  s->polled = 0;
+  s->npolled = s->polled_size = 0;
+#if defined(UNIX)
+  s->pollfds = (struct pollfd*)must_malloc( sizeof( struct pollfd ) );
+#endif
+#if SCHED_EPOLL
+  s->nepoll = 0;
+  s->epfd = epoll_create1( EPOLL_CLOEXEC );
+  if (s->epfd < 0)
+    annoyingmsg( "Task scheduler: no epoll; descriptors will be polled." );
+#endif
+  return s;
+}
+
+bool sched_submit( sched_t *s, int task, int kind, int arg, int *result )
+{
+#if defined(UNIX)
+  sched_job_t *j;
+
+  if (kind == SCHED_JOB_INPUT || kind == SCHED_JOB_OUTPUT) {
+    *result = ready_fd( arg, kind == SCHED_JOB_INPUT ? POLLIN : POLLOUT );
+    if (*result != 0)
+      return FALSE;
+  }
+  else if (kind != SCHED_JOB_SLEEP || arg <= 0) {
+    *result = (kind == SCHED_JOB_SLEEP ? 0 : -1);
+    return FALSE;
+  }
+
+  j = (sched_job_t*)must_malloc( sizeof( sched_job_t ) );
+  j->task = task;
+  j->kind = kind;
+  j->arg = arg;
+  j->result = 0;
+  j->next = 0;
+  s->outstanding++;
+
+  if (kind == SCHED_JOB_SLEEP) {
+    j->deadline = now_ms() + arg;
+    sleep_insert( s, j );
+  }
+#if SCHED_EPOLL
+  else if (epoll_submit( s, j ))
+    ;
+#endif
+  else
+    poll_insert( s, j );
+  return TRUE;
+#else
+  /* Nothing to wait with: report input and output as ready, and let
+     the caller block in the operation itself as it always has. */
+  *result = (kind == SCHED_JOB_SLEEP ? 0 : 1);
+  return FALSE;
+#endif
+}
+
+int sched_next( sched_t *s, int timeout_ms, int *result )
+{
+  sched_job_t *j;
+  int task;
+
+  if (s->outstanding == 0)
+    return -1;
+
+#if defined(UNIX)
+  if (s->completed == 0)
+    gather( s, 0 );
+  if (s->completed == 0 && timeout_ms > 0) {
+    long long until = now_ms() + timeout_ms;
+    long long now, wait;
+
+    /* Return at once on a signal, so that Scheme code can handle it. */
+    do {
+      now = now_ms();
+      wait = until - now;
+      if (s->nsleeping > 0)
+        wait = min( wait, s->sleeping[0]->deadline - now );
+    } while (gather( s, (int)max( wait, 0 ) ) &&
+             s->completed == 0 && now_ms() < until);
+  }
+#endif
+
+  j = s->completed;
+  if (j == 0)
+    return -2;
+  s->completed = j->next;
+  s->outstanding--;
+  task = j->task;
+  *result = j->result;
+  free( j );
+  return task;
+}
+
+int sched_outstanding( sched_t *s )
+{
+  return s->outstanding;
+}
+
+/* Syscalls */
+
+static sched_t *the_sched = 0;
+static int last_result = 0;
+
+static sched_t *get_sched( void )
+{
+  if (the_sched == 0)
+    the_sched = create_sched();
+  return the_sched;
+}
+
+void primitive_sched_submit( word w_task, word w_kind, word w_arg )
+{
+  int result;
+
+  if (sched_submit( get_sched(), nativeint( w_task ), nativeint( w_kind ),
+                    nativeint( w_arg ), &result ))
+    globals[ G_RESULT ] = FALSE_CONST;
+  else
+    globals[ G_RESULT ] = fixnum( result );
+}
+
+void primitive_sched_next( word w_timeout )
+{
+  int task;
+
+  if (the_sched == 0)
+    task = -1;
+  else
+    task = sched_next( the_sched, nativeint( w_timeout ), &last_result );
+  globals[ G_RESULT ] = fixnum( task );
+}
+
+void primitive_sched_result( void )
+{
+  globals[ G_RESULT ] = fixnum( last_result );
+}
+
+/* eof */
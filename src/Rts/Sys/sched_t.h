@@ -0,0 +1,64 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- task scheduler.
+ *
+ * Scheme tasks (lib/Standard/tasking.sch) are switched by the tasking
+ * library with continuations, on the one thread that runs Scheme code.
+ * The scheduler lets a task wait for something that would otherwise
+ * block that thread: the task hands the wait to the scheduler as a
+ * job and blocks, and the task is made runnable again when the job
+ * completes.  A sleep is kept as a deadline, and a wait for a file
+ * descriptor is registered with epoll on Linux, or polled elsewhere,
+ * so no thread is blocked on behalf of a waiting task.  The Scheme
+ * thread goes on running the tasks that are not waiting, and waits
+ * for all of the jobs at once, in sched_next(), only when every task
+ * is waiting.
+ *
+ * Tasks are named by nonnegative fixnums chosen by the Scheme code,
+ * so the scheduler holds no pointers into the heap and a job never
+ * touches the heap.
+ *
+ * On systems other than Unix, a job completes at once without waiting.
+ */
+
+#ifndef INCLUDED_SCHED_T_H
+#define INCLUDED_SCHED_T_H
+
+#include "config.h"
+#include "larceny-types.h"
+
+/* Job kinds; see lib/Standard/tasking-native.sch. */
+#define SCHED_JOB_SLEEP      0      /* Wait arg milliseconds */
+#define SCHED_JOB_INPUT      1      /* Wait until file descriptor arg
+                                       is readable */
+#define SCHED_JOB_OUTPUT     2      /* Wait until file descriptor arg
+                                       is writable */
+
+sched_t *create_sched( void );
+  /* Creates a scheduler with no jobs.
+     */
+
+bool sched_submit( sched_t *s, int task, int kind, int arg, int *result );
+  /* Queues a job of the given kind on behalf of task and returns TRUE,
+     or stores the result in *result and returns FALSE if the job
+     need not wait: its descriptor is ready already, or there is
+     nothing to wait with.
+     */
+
+int sched_next( sched_t *s, int timeout_ms, int *result );
+  /* Returns the task of a completed job and stores the job's result
+     in *result, waiting up to timeout_ms milliseconds for a job to
+     complete.  Returns -1 if no job is outstanding, and -2 if none
+     completed in time or a signal arrived while waiting.
+     */
+
+int sched_outstanding( sched_t *s );
+  /* Returns the number of jobs submitted but not yet returned by
+     sched_next().
+     */
+
+#endif /* INCLUDED_SCHED_T_H */
+
+/* eof */
@@ -17,10 +17,19 @@ typedef struct seqbuf_data seqbuf_data_t;
 struct seqbuf_data {
   seqbuf_processor ep;
   void* sp_data;
+  bool batched;                      /* Sort and deduplicate batches */
 };
 
 #define DATA(ssb)               ((seqbuf_data_t*)(ssb->data))
 
+#define NO_OFFSET               ((word)1)   /* Not a fixnum */
+
+/* Scratch space for sort_batch(), which is never reentered because 
+ * SSBs are only processed by one thread at a time. 
+ */
+static word *scratch = 0;
+static int scratch_words = 0;
+
 seqbuf_t *
 create_seqbuf( int num_entries, /* Number of entries in SSB */
 	       word **bot_loc,  /* Location of pointer to start of SSB */
@@ -56,6 +65,7 @@ create_seqbuf( int num_entries, /* Number of entries in SSB */
 
   DATA(ssb)->ep = processor;
   DATA(ssb)->sp_data = sp_data;
+  DATA(ssb)->batched = FALSE;
 
   return ssb;
 }
@@ -79,12 +89,77 @@ void* seqbuf_set_sp_data( seqbuf_t *ssb, void *sp_data )
   return old_sp_data;
 }
 
+void seqbuf_set_batched( seqbuf_t *ssb, bool batched )
+{
+  DATA(ssb)->batched = batched;
+}
+
+static int cmp_entries( const void *a, const void *b )
+{
+  const word *x = (const word*)a;
+  const word *y = (const word*)b;
+
+  if (x[0] != y[0])
+    return (x[0] < y[0]) ? -1 : 1;
+  if (x[1] != y[1])
+    return (x[1] < y[1]) ? -1 : 1;
+  return 0;
+}
+
+/* Sorts and deduplicates the entries in [bot,top) in place, and 
+ * returns the new top.  Each entry is copied into the scratch space as
+ * an object/offset pair, with NO_OFFSET standing in for a missing 
+ * offset, so that the entries can be sorted as fixed-size records.
+ */
+static word *sort_batch( word *bot, word *top )
+{
+  word *p, *q, *e, *lim;
+
+  if (scratch_words < 2*(top-bot)) {
+    if (scratch != 0)
+      free( scratch );
+    scratch_words = 2*(top-bot);
+    scratch = (word*)must_malloc( scratch_words*sizeof(word) );
+  }
+
+  p = bot;
+  e = scratch;
+  while (p < top) {
+    if (is_fixnum( *p )) {
+      p++;
+      continue;
+    }
+    e[0] = *p++;
+    e[1] = (p < top && is_fixnum( *p )) ? *p++ : NO_OFFSET;
+    e += 2;
+  }
+  lim = e;
+
+  qsort( scratch, (lim-scratch)/2, 2*sizeof(word), cmp_entries );
+
+  q = bot;
+  for ( e = scratch ; e < lim ; e += 2 ) {
+    if (e > scratch && e[0] == e[-2] && e[1] == e[-1])
+      continue;
+    *q++ = e[0];
+    if (e[1] != NO_OFFSET)
+      *q++ = e[1];
+  }
+  return q;
+}
+
+static int process_entries( gc_t *gc, seqbuf_t *ssb, word *bot, word *top )
+{
+  if (DATA(ssb)->batched && bot != top)
+    top = sort_batch( bot, top );
+  return DATA(ssb)->ep( gc, bot, top, DATA(ssb)->sp_data );
+}
+
 int process_seqbuf( gc_t *gc, seqbuf_t *ssb ) 
 {
   int retval;
   
-  void *sp_data = DATA(ssb)->sp_data;
-  retval = DATA(ssb)->ep( gc, *ssb->bot, *ssb->top, sp_data );
+  retval = process_entries( gc, ssb, *ssb->bot, *ssb->top );
   *ssb->top = *ssb->bot;
   return retval;
 }
@@ -53,6 +53,17 @@ int process_seqbuf( gc_t *gc, seqbuf_t *ssb );
 /* Is the ssb clear? */
 bool seqbuf_clearp( seqbuf_t *ssb );
 
+/* Makes process_seqbuf() pass batches to the entry processor that are
+ * sorted and free of duplicates, as uremset_t's add_elems expects.
+ *
+ * An entry in the log is an object pointer, optionally followed by a
+ * fixnum giving the offset of the field that was written.  The batch
+ * is sorted on the object, then on the offset, and an entry equal to
+ * its predecessor is dropped.  Stray fixnums are dropped too.  The
+ * SATB buffer must not be batched; its entries are not in this format.
+ */
+void seqbuf_set_batched( seqbuf_t *ssb, bool batched );
+
 /* Switches in a new set of locations to link with the SSB log.
  */
 void seqbuf_swap_in_ssb( seqbuf_t *ssb, 
@@ -0,0 +1,502 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny -- parallel marking engine for the smircy marking machine.
+ *
+ * Entry point (from smircy.c):
+ *   smircy_par_progress
+ *
+ * This does the work of smircy_progress on the threads of gc->workers.
+ * It runs while the mutator is stopped or, on the mark thread, while
+ * the mutator is kept out of the collector (see mark_thread_t.h), so
+ * the page table does not change underneath the workers, and the only
+ * shared structures that are written are the mark bitmap, the mark
+ * stack of the context, the incoming-word counts of the regions, and
+ * the remembered set.
+ *
+ * Algorithm.
+ *
+ * Each worker owns a Chase-Lev work-stealing deque of mark items.  An
+ * item is either a marked object whose constituents have not been
+ * pushed (index -1), or a window of a large object starting at index,
+ * exactly like the entries of the object stack and the large object
+ * cursor stack of the serial machine.  A worker pushes and pops at the
+ * bottom of its own deque; idle workers steal from the top of other
+ * workers' deques.  Deques have a fixed size; when one is full, items
+ * spill to a shared overflow list under the pool lock.
+ *
+ * The context's own mark stack is the source of work: a worker whose
+ * deque is empty takes a batch of items from the overflow list or,
+ * failing that, from the mark stack (under the pool lock), and only
+ * then tries to steal.
+ *
+ * Objects are marked on push, as in the serial machine, but with an
+ * atomic read-modify-write of the bitmap word so that exactly one
+ * worker pushes each object.  Incoming-word counts are incremented
+ * atomically.  Remembered set insertions and the infamy checks that
+ * follow changes to the incoming-word counts are buffered and
+ * performed serially when the workers are done.
+ *
+ * The workers stop when the marking budget is used up or when every
+ * worker is idle.  Items that remain in deques or on the overflow list
+ * are then pushed back onto the context's mark stack, so that the
+ * per-region stack lists used by the collector remain intact between
+ * calls.
+ */
+
+#define GC_INTERNAL
+
+#include <string.h>
+#include "larceny.h"
+#include "gc_t.h"
+#include "gclib.h"
+#include "old_heap_t.h"
+#include "region_group_t.h"
+#include "semispace_t.h"
+#include "smircy.h"
+#include "static_heap_t.h"
+#include "uremset_t.h"
+#include "gc_workers_t.h"
+
+#include "smircy_internal.h"
+
+#define PAR_MIN_BUDGET   16384       /* Smaller budgets are run serially */
+#define DEQUE_SIZE       4096        /* Items per deque; a power of 2 */
+#define REFILL_BATCH     64          /* Items taken from the shared lists */
+#define FLUSH_COUNT      256         /* Marks between budget checks */
+#define REMEMBER_BATCH   256         /* Buffered remembered set insertions */
+
+typedef struct mark_item mark_item_t;
+typedef struct mark_deque mark_deque_t;
+typedef struct mark_worker mark_worker_t;
+typedef struct mark_env mark_env_t;
+
+struct mark_item {
+  word obj;
+  int  index;                   /* -1, or resumption index of a window */
+};
+
+struct mark_deque {
+  volatile int top;             /* Next item to steal; advanced by CAS */
+  volatile int bottom;          /* Next free slot; written by owner only */
+  mark_item_t *items;           /* DEQUE_SIZE items, indexed modulo size */
+};
+
+struct mark_worker {
+  mark_env_t *env;
+  mark_deque_t deque;
+  int  traced;                  /* Counts not yet added to env */
+  int  marked;
+  int  words_marked;
+  int  remember_len;
+  word remember[REMEMBER_BATCH];
+  word pad[8];                  /* Keep workers off each other's lines */
+};
+
+struct mark_env {
+  smircy_context_t *context;
+  gc_t *gc;
+  gc_workers_t *pool;
+  word *bitmap;
+  word *lowest;
+  word *highest;
+  int  static_gno;
+  char *touched;                /* touched[gno] if incoming count changed */
+
+  int  mark_max;                /* Budgets */
+  int  trace_max;
+  int  mark_words_max;
+  int  marked;                  /* Totals; atomic */
+  int  traced;
+  int  words_marked;
+  volatile int stop;            /* Nonzero when the budget is exhausted */
+  volatile int idle;            /* Number of idle workers; atomic */
+
+  /* The following, and the context's mark stack, are protected by
+     the pool lock. */
+  mark_item_t *overflow;
+  volatile int overflow_len;
+  int  overflow_cap;
+  word *remember;
+  int  remember_len;
+  int  remember_cap;
+  int  refills;
+
+  int  nworkers;
+  mark_worker_t *workers;
+};
+
+/* Chase-Lev deque operations.  Only the owner calls deque_push and
+   deque_pop; any worker may call deque_steal. */
+
+static bool deque_push( mark_deque_t *d, word obj, int index )
+{
+  int b = d->bottom;
+
+  if (b - d->top >= DEQUE_SIZE)
+    return FALSE;
+  d->items[ b & (DEQUE_SIZE-1) ].obj = obj;
+  d->items[ b & (DEQUE_SIZE-1) ].index = index;
+  gc_memory_barrier();
+  d->bottom = b+1;
+  return TRUE;
+}
+
+static bool deque_pop( mark_deque_t *d, mark_item_t *item )
+{
+  int b = d->bottom - 1;
+  int t;
+  bool ok;
+
+  d->bottom = b;
+  gc_memory_barrier();
+  t = d->top;
+  if (t > b) {
+    d->bottom = t;
+    return FALSE;
+  }
+  *item = d->items[ b & (DEQUE_SIZE-1) ];
+  if (t < b)
+    return TRUE;
+  /* Last item: race against thieves. */
+  ok = gc_atomic_cas( &d->top, t, t+1 );
+  d->bottom = t+1;
+  return ok;
+}
+
+static bool deque_steal( mark_deque_t *d, mark_item_t *item )
+{
+  int t = d->top;
+  int b;
+
+  gc_memory_barrier();
+  b = d->bottom;
+  if (t >= b)
+    return FALSE;
+  *item = d->items[ t & (DEQUE_SIZE-1) ];
+  return gc_atomic_cas( &d->top, t, t+1 );
+}
+
+static void push_item( mark_worker_t *w, word obj, int index )
+{
+  mark_env_t *env = w->env;
+
+  if (deque_push( &w->deque, obj, index ))
+    return;
+  gc_workers_lock( env->pool );
+  if (env->overflow_len == env->overflow_cap) {
+    env->overflow_cap = (env->overflow_cap == 0 ? 1024 : env->overflow_cap*2);
+    env->overflow = (mark_item_t*)
+      must_realloc( env->overflow, sizeof( mark_item_t )*env->overflow_cap );
+  }
+  env->overflow[ env->overflow_len ].obj = obj;
+  env->overflow[ env->overflow_len ].index = index;
+  env->overflow_len++;
+  gc_workers_unlock( env->pool );
+}
+
+/* Marks obj in the bitmap.  Returns TRUE iff obj was already marked. */
+
+static bool mark_object( mark_env_t *env, word obj )
+{
+  word bit_idx, word_idx, bit_in_word;
+
+  if (ptrof( obj ) < env->lowest || env->highest <= ptrof( obj ))
+    return TRUE;
+  bit_idx     = (obj - (word)env->lowest) >> BIT_IDX_SHIFT;
+  word_idx    = bit_idx >> BIT_IDX_TO_WORD_IDX;
+  bit_in_word = 1 << (bit_idx & BIT_IN_WORD_MASK);
+  if (env->bitmap[ word_idx ] & bit_in_word)
+    return TRUE;
+  return gc_atomic_set_bits( &env->bitmap[ word_idx ], bit_in_word );
+}
+
+static void flush_remember( mark_worker_t *w )
+{
+  mark_env_t *env = w->env;
+
+  if (w->remember_len == 0)
+    return;
+  gc_workers_lock( env->pool );
+  if (env->remember_len + w->remember_len > env->remember_cap) {
+    env->remember_cap =
+      max( env->remember_cap*2, env->remember_len + w->remember_len );
+    env->remember = (word*)
+      must_realloc( env->remember, sizeof( word )*env->remember_cap );
+  }
+  memcpy( env->remember + env->remember_len, w->remember,
+          sizeof( word )*w->remember_len );
+  env->remember_len += w->remember_len;
+  gc_workers_unlock( env->pool );
+  w->remember_len = 0;
+}
+
+/* The parallel counterpart of push() in smircy.c. */
+
+static void par_push( mark_worker_t *w, word obj, word src )
+{
+  mark_env_t *env = w->env;
+  int gno;
+
+  if (!isptr( obj ))
+    return;
+
+  gno = gen_of( obj );
+  if (isptr( src ) && gno != 0 && gno != env->static_gno) {
+    old_heap_t *heap = gc_heap_for_gno( env->gc, gno );
+
+    gc_atomic_add( &heap->incoming_words.marker, 1 );
+    env->touched[ gno ] = 1;
+
+    /* rebuild remset for advertised regions. */
+    assert2( gen_of( src ) != 0 );
+    if (gno != gen_of( src ) && heap->group == region_group_advertised) {
+      if (w->remember_len == REMEMBER_BATCH)
+        flush_remember( w );
+      w->remember[ w->remember_len++ ] = src;
+    }
+  }
+
+  if (mark_object( env, obj ))
+    return;
+
+  assert( gno != 0 ); /* we do not push objects in the nursery */
+  push_item( w, obj, -1 );
+}
+
+static int push_constituents( mark_worker_t *w, word obj )
+{
+  int i, n;
+
+  switch (tagof( obj )) {
+  case PAIR_TAG:
+    par_push( w, pair_cdr( obj ), obj );
+    par_push( w, pair_car( obj ), obj );
+    return 2;
+  case VEC_TAG:
+  case PROC_TAG:
+    n = bytes2words( sizefield( *ptrof( obj ) ));
+    if (n > WINDOW_SIZE_LIMIT)
+      push_item( w, obj, 0 );
+    else
+      for ( i=0 ; i < n ; i++ )
+        par_push( w, vector_ref( obj, i ), obj );
+    return n+1;
+  default:
+    return 0;
+  }
+}
+
+/* Like fill_from_los_stack() in smircy.c. */
+
+static void scan_window( mark_worker_t *w, word obj, int start )
+{
+  int i, objwords, lim;
+
+  objwords = bytes2words( sizefield( *ptrof( obj ) ));
+  lim = start + min( objwords-start, WINDOW_SIZE_LIMIT );
+  if (lim < objwords)
+    push_item( w, obj, lim );
+  for ( i=start ; i < lim ; i++ )
+    par_push( w, vector_ref( obj, i ), obj );
+}
+
+static void flush_counts( mark_worker_t *w )
+{
+  mark_env_t *env = w->env;
+  int marked, traced, words_marked;
+
+  marked = gc_atomic_add( &env->marked, w->marked ) + w->marked;
+  traced = gc_atomic_add( &env->traced, w->traced ) + w->traced;
+  words_marked =
+    gc_atomic_add( &env->words_marked, w->words_marked ) + w->words_marked;
+  w->marked = w->traced = w->words_marked = 0;
+
+  if (marked >= env->mark_max || traced >= env->trace_max
+      || words_marked >= env->mark_words_max)
+    env->stop = 1;
+}
+
+/* Takes a batch of items from the overflow list or the context's mark
+   stack, or steals an item from another worker.  The caller's deque is
+   empty, so the batch fits.  (Nothing may be pushed back onto the mark
+   stack here, since that may allocate and move the page table.) */
+
+static bool find_work( mark_worker_t *w, mark_item_t *item )
+{
+  mark_env_t *env = w->env;
+  mark_item_t it;
+  int i, n = 0;
+  bool ok;
+
+  gc_workers_lock( env->pool );
+  while (n < REFILL_BATCH && env->overflow_len > 0) {
+    it = env->overflow[ --env->overflow_len ];
+    if (n++ == 0)
+      *item = it;
+    else {
+      ok = deque_push( &w->deque, it.obj, it.index );
+      assert( ok );
+    }
+  }
+  if (n == 0) {
+    while (n < REFILL_BATCH
+           && smircy_pop_entry( env->context, &it.obj, &it.index )) {
+      if (n++ == 0)
+        *item = it;
+      else {
+        ok = deque_push( &w->deque, it.obj, it.index );
+        assert( ok );
+      }
+    }
+    if (n > 0)
+      env->refills++;
+  }
+  gc_workers_unlock( env->pool );
+  if (n > 0)
+    return TRUE;
+
+  for ( i=1 ; i < env->nworkers ; i++ ) {
+    mark_worker_t *victim = &env->workers[ (w - env->workers + i)
+                                           % env->nworkers ];
+    if (deque_steal( &victim->deque, item ))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* A hint; the caller must still go through find_work. */
+
+static bool work_visible( mark_env_t *env )
+{
+  int i;
+
+  if (env->overflow_len > 0 || !smircy_stack_empty_p( env->context ))
+    return TRUE;
+  for ( i=0 ; i < env->nworkers ; i++ )
+    if (env->workers[i].deque.bottom - env->workers[i].deque.top > 0)
+      return TRUE;
+  return FALSE;
+}
+
+static void par_mark_worker( int id, void *data )
+{
+  mark_env_t *env = (mark_env_t*)data;
+  mark_worker_t *w = &env->workers[id];
+  mark_item_t item;
+
+  while (!env->stop) {
+    if (deque_pop( &w->deque, &item ) || find_work( w, &item )) {
+      if (item.index < 0) {
+        w->traced++;
+        w->marked++;
+        w->words_marked += push_constituents( w, item.obj );
+        if (w->marked >= FLUSH_COUNT)
+          flush_counts( w );
+      }
+      else
+        scan_window( w, item.obj, item.index );
+      continue;
+    }
+
+    /* Out of work.  Terminate when every worker is idle. */
+    gc_atomic_add( &env->idle, 1 );
+    while (1) {
+      if (env->stop || env->idle == env->nworkers)
+        goto done;
+      if (work_visible( env )) {
+        gc_atomic_add( &env->idle, -1 );
+        break;
+      }
+    }
+  }
+ done:
+  flush_counts( w );
+  flush_remember( w );
+}
+
+bool smircy_par_progress( smircy_context_t *context,
+                          int mark_max, int trace_max, int mark_words_max,
+                          int misc_max,
+                          int *marked_recv, int *traced_recv,
+                          int *words_marked_recv, int *misc_recv )
+{
+  gc_t *gc = context->gc;
+  mark_env_t env;
+  int i;
+
+  if (gc->workers == 0 || gc_workers_count( gc->workers ) < 2)
+    return FALSE;
+  if (mark_max < PAR_MIN_BUDGET || trace_max < PAR_MIN_BUDGET
+      || mark_words_max < PAR_MIN_BUDGET || misc_max <= 0)
+    return FALSE;
+
+  memset( &env, 0, sizeof( mark_env_t ) );
+  env.context = context;
+  env.gc = gc;
+  env.pool = gc->workers;
+  env.bitmap = context->bitmap;
+  env.lowest = context->lowest_heap_address;
+  env.highest = context->highest_heap_address;
+  env.static_gno =
+    (gc->static_area && gc->static_area->data_area
+     ? gc->static_area->data_area->gen_no : -1);
+  env.touched = (char*)must_malloc( gc->gno_count );
+  memset( env.touched, 0, gc->gno_count );
+  env.mark_max = mark_max;
+  env.trace_max = trace_max;
+  env.mark_words_max = mark_words_max;
+  env.nworkers = gc_workers_count( gc->workers );
+  env.workers =
+    (mark_worker_t*)must_malloc( sizeof( mark_worker_t )*env.nworkers );
+  for ( i=0 ; i < env.nworkers ; i++ ) {
+    mark_worker_t *w = &env.workers[i];
+    w->env = &env;
+    w->deque.top = w->deque.bottom = 0;
+    w->deque.items =
+      (mark_item_t*)must_malloc( sizeof( mark_item_t )*DEQUE_SIZE );
+    w->traced = w->marked = w->words_marked = 0;
+    w->remember_len = 0;
+  }
+
+  gc_workers_run( env.pool, par_mark_worker, (void*)&env );
+
+  /* Return leftover work to the mark stack, then do the deferred
+     remembered set and infamy updates. */
+  for ( i=0 ; i < env.nworkers ; i++ ) {
+    mark_deque_t *d = &env.workers[i].deque;
+    int k;
+    for ( k=d->top ; k < d->bottom ; k++ )
+      smircy_push_entry( context, d->items[ k & (DEQUE_SIZE-1) ].obj,
+                         d->items[ k & (DEQUE_SIZE-1) ].index );
+    free( d->items );
+  }
+  for ( i=0 ; i < env.overflow_len ; i++ )
+    smircy_push_entry( context, env.overflow[i].obj, env.overflow[i].index );
+
+  for ( i=0 ; i < env.remember_len ; i++ )
+    urs_add_elem( gc->the_remset, env.remember[i] );
+  for ( i=1 ; i < gc->gno_count ; i++ ) {
+    if (env.touched[i]) {
+      old_heap_t *heap = gc_heap_for_gno( gc, i );
+      gc_check_rise_to_infamy( gc, heap, heap->incoming_words.marker );
+    }
+  }
+
+  context->total_traced += env.traced;
+  context->total_marked += env.marked;
+  context->total_words_marked += env.words_marked;
+  *marked_recv = env.marked;
+  *traced_recv = env.traced;
+  *words_marked_recv = env.words_marked;
+  *misc_recv = env.refills;
+
+  free( env.workers );
+  free( env.touched );
+  if (env.overflow) free( env.overflow );
+  if (env.remember) free( env.remember );
+  return TRUE;
+}
+
+/* eof */
@@ -108,6 +108,7 @@
 #include "smircy.h"
 #include "static_heap_t.h"
 #include "uremset_t.h"
+#include "bitmap.h"
 
 #include "smircy_internal.h"
 
@@ -364,21 +365,36 @@ static void free_los_stk_entries( large_object_cursor_t **entries, int n )
     gclib_free( entries, n );
   }
 }
-static obj_stackseg_t *alloc_obj_stackseg() {
+/* A concurrent context may be advanced while the mutator runs, so its
+ * stack segments come from malloc rather than from the page allocator,
+ * which is not thread-safe and may move the page table. */
+static obj_stackseg_t *alloc_obj_stackseg( smircy_context_t *context ) {
+  if (context->concurrent)
+    return must_malloc( sizeof( obj_stackseg_t ) );
   return my_gclib_alloc_rts( sizeof( obj_stackseg_t ), 
                              MB_SMIRCY_MARK, "alloc_obj_stackseg" );
 }
-static void free_obj_stackseg( obj_stackseg_t *obj ) 
+static void free_obj_stackseg( smircy_context_t *context, 
+                               obj_stackseg_t *obj ) 
 {
-  gclib_free( obj, sizeof( obj_stackseg_t ) );
-}
-static los_stackseg_t *alloc_los_stackseg() {
+  if (context->concurrent)
+    free( obj );
+  else
+    gclib_free( obj, sizeof( obj_stackseg_t ) );
+}
+static los_stackseg_t *alloc_los_stackseg( smircy_context_t *context ) {
+  if (context->concurrent)
+    return must_malloc( sizeof( los_stackseg_t ) );
   return my_gclib_alloc_rts( sizeof( los_stackseg_t ), 
                              MB_SMIRCY_MARK, "alloc_los_stackseg" );
 }
-static void free_los_stackseg( los_stackseg_t *los ) 
+static void free_los_stackseg( smircy_context_t *context, 
+                               los_stackseg_t *los ) 
 {
-  gclib_free( los, sizeof( los_stackseg_t ) );
+  if (context->concurrent)
+    free( los );
+  else
+    gclib_free( los, sizeof( los_stackseg_t ) );
 }
 static word* alloc_bitmap( int words_in_bitmap )
 {
@@ -671,7 +687,8 @@ static int allocate_bitmap_full_cov( smircy_context_t *context ) {
  * If *freed is non-null, the new segment may be drawn from *freed, in
  * which case freed is updated to point to its successor segment.
  */
-static obj_stackseg_t *push_obj_segment( obj_stackseg_t *obj, 
+static obj_stackseg_t *push_obj_segment( smircy_context_t *context,
+                                         obj_stackseg_t *obj, 
                                          obj_stackseg_t **freed,
                                          int gno_owner)
 {
@@ -682,7 +699,7 @@ static obj_stackseg_t *push_obj_segment( obj_stackseg_t *obj,
 #endif
 
   if (*freed == NULL) {
-    sp = alloc_obj_stackseg();
+    sp = alloc_obj_stackseg( context );
 
     dbmsg( "SMIRCY push_obj_segment( 0x%08x, [0x%08x] ) => 0x%08x [%d]", 
            obj, *freed, sp, gno_owner );
@@ -709,7 +726,8 @@ static obj_stackseg_t *push_obj_segment( obj_stackseg_t *obj,
  * (The client is obligated to eventually deallocate all elements of
  * freed, but there is no guarantee that the popped segment is
  * actually put on freed.) */
-static obj_stackseg_t *pop_obj_segment( obj_stackseg_t *obj, 
+static obj_stackseg_t *pop_obj_segment( smircy_context_t *context,
+                                        obj_stackseg_t *obj, 
                                         obj_stackseg_t **freed ) 
 {
   obj_stackseg_t *sp;
@@ -724,7 +742,7 @@ static obj_stackseg_t *pop_obj_segment( obj_stackseg_t *obj,
   obj->next = *freed;
   *freed = obj;
 #else
-  free_obj_stackseg( obj );
+  free_obj_stackseg( context, obj );
 #endif
   return sp;
 }
@@ -734,7 +752,8 @@ static obj_stackseg_t *pop_obj_segment( obj_stackseg_t *obj,
  * If *freed is non-null, the new segment may be drawn from *freed, in
  * which case freed is updated to point to its successor segment.
  */
-static los_stackseg_t *push_los_segment( los_stackseg_t *los,
+static los_stackseg_t *push_los_segment( smircy_context_t *context,
+                                         los_stackseg_t *los,
                                          los_stackseg_t **freed ) 
 {
   los_stackseg_t *sp;
@@ -744,7 +763,7 @@ static los_stackseg_t *push_los_segment( los_stackseg_t *los,
 #endif
 
   if (*freed == NULL) {
-    sp = alloc_los_stackseg();
+    sp = alloc_los_stackseg( context );
 
     dbmsg( "SMIRCY push_los_segment( 0x%08x, [0x%08x] ) => 0x%08x", 
            los, *freed, sp );
@@ -766,7 +785,8 @@ static los_stackseg_t *push_los_segment( los_stackseg_t *los,
 /* Pops los, returning its successor in the stack.  The popped segment
  * is either immediately deallocated or put on top of *freed.
  * (Analogous to pop_obj_segment above.) */
-static los_stackseg_t *pop_los_segment( los_stackseg_t *los,
+static los_stackseg_t *pop_los_segment( smircy_context_t *context,
+                                        los_stackseg_t *los,
                                         los_stackseg_t **freed ) 
 {
   los_stackseg_t *sp;
@@ -781,38 +801,62 @@ static los_stackseg_t *pop_los_segment( los_stackseg_t *los,
   los->next = *freed;
   *freed = los;
 #else
-  free_los_stackseg( los );
+  free_los_stackseg( context, los );
 #endif
   return sp;
 }
 
-static int free_obj_stacksegs( obj_stackseg_t *segs ) 
+static int free_obj_stacksegs( smircy_context_t *context, 
+                               obj_stackseg_t *segs ) 
 {
   int i = 0;
   if (segs != NULL) {
     /* (should be sufficiently shallow) */
-    i = 1 + free_obj_stacksegs( segs->next );
-    free_obj_stackseg( segs );
+    i = 1 + free_obj_stacksegs( context, segs->next );
+    free_obj_stackseg( context, segs );
   }
   return i;
 }
 
-static int free_los_stacksegs( los_stackseg_t *segs ) 
+static int free_los_stacksegs( smircy_context_t *context, 
+                               los_stackseg_t *segs ) 
 {
   int i = 0;
   if (segs != NULL) {
-    i = 1 + free_los_stacksegs( segs->next );
-    free_los_stackseg( segs );
+    i = 1 + free_los_stacksegs( context, segs->next );
+    free_los_stackseg( context, segs );
   }
   return i;
 }
 
 static bool mark_object( smircy_context_t *context, word obj );
 
-static void push( smircy_context_t *context, word obj, word src ) 
+/* Pushes obj, which is in region gno, onto the object stack. */
+static void push_entry( smircy_context_t *context, word obj, int gno )
 {
-  int gno;
   obj_stack_t *stack;
+
+  assert( gno != 0 ); /* we do not push objects in the nursery */
+  assert( gno >= 0 );  /* we should only encounter objects with valid gnos */
+  stack = &(context->stack.obj);
+  if (stack->stkp == stack->stklim) {
+    stack->seg = push_obj_segment( context, stack->seg, &context->freed_obj, gno );
+    stack->stkbot = stack->seg->data;
+    stack->stklim = stack->seg->data+OBJ_STACK_SIZE;
+    stack->stkp = stack->stkbot;
+  }
+
+  stack->stkp->val = obj;
+#if MAINTAIN_GNO_IN_OBJ_STACK
+  stack->stkp->gno = gno;
+#endif
+  stack->stkp->next_in_rgn = context->rgn_to_obj_entry[gno];
+  context->rgn_to_obj_entry[gno] = stack->stkp;
+  stack->stkp++;
+}
+
+static void push( smircy_context_t *context, word obj, word src ) 
+{
   bool already_marked;
 
   if (isptr(obj)) {
@@ -840,24 +884,7 @@ static void push( smircy_context_t *context, word obj, word src )
     if (already_marked) return;
 #endif
 
-    gno = gen_of(obj);
-    assert( gno != 0 ); /* we do not push objects in the nursery */
-    assert( gno >= 0 );  /* we should only encounter objects with valid gnos */
-    stack = &(context->stack.obj);
-    if (stack->stkp == stack->stklim) {
-      stack->seg = push_obj_segment( stack->seg, &context->freed_obj, gno );
-      stack->stkbot = stack->seg->data;
-      stack->stklim = stack->seg->data+OBJ_STACK_SIZE;
-      stack->stkp = stack->stkbot;
-    }
-
-    stack->stkp->val = obj;
-#if MAINTAIN_GNO_IN_OBJ_STACK
-    stack->stkp->gno = gno;
-#endif
-    stack->stkp->next_in_rgn = context->rgn_to_obj_entry[gno];
-    context->rgn_to_obj_entry[gno] = stack->stkp;
-    stack->stkp++;
+    push_entry( context, obj, gen_of(obj) );
   }
 }
 
@@ -869,7 +896,7 @@ static void los_push( smircy_context_t *context, word index, word obj )
   gno = gen_of(obj);
   stack = &(context->stack.los);
   if (stack->stkp == stack->stklim) {
-    stack->seg = push_los_segment( stack->seg, &context->freed_los );
+    stack->seg = push_los_segment( context, stack->seg, &context->freed_los );
     stack->stkbot = stack->seg->data;
     stack->stklim = stack->seg->data+LOS_STACK_SIZE;
     stack->stkp = stack->stkbot;
@@ -899,7 +926,8 @@ static bool fill_from_los_stack( smircy_context_t *context )
   } 
   assert( los_stack->stkp >= los_stack->stkbot );
   if (los_stack->stkp == los_stack->stkbot) {
-    los_stack->seg = pop_los_segment( los_stack->seg, &context->freed_los );
+    los_stack->seg = pop_los_segment( context, los_stack->seg, 
+                                      &context->freed_los );
     if (los_stack->seg == NULL) {
       los_stack->stkp = 0;
       los_stack->stkbot = 0;
@@ -932,6 +960,80 @@ static bool fill_from_los_stack( smircy_context_t *context )
   return TRUE;
 }
 
+bool smircy_pop_entry( smircy_context_t *context, 
+                       word *obj_recv, int *index_recv )
+{
+  obj_stack_t *obj_stack;
+  los_stack_t *los_stack;
+  word obj;
+
+  obj_stack = &context->stack.obj;
+  while (1) {
+    if (obj_stack->stkp == obj_stack->stkbot) { /* underflow */
+      if (obj_stack->seg == NULL)
+        break;
+      obj_stack->seg = pop_obj_segment( context, obj_stack->seg, 
+                                        &context->freed_obj );
+      if (obj_stack->seg == NULL) {
+        obj_stack->stkbot = 0x0;
+        obj_stack->stklim = 0x0;
+        obj_stack->stkp   = 0x0;
+        break;
+      }
+      obj_stack->stkbot = obj_stack->seg->data;
+      obj_stack->stklim = obj_stack->seg->data+OBJ_STACK_SIZE;
+      obj_stack->stkp   = obj_stack->stklim;
+      continue;
+    }
+    obj_stack->stkp--;
+    obj = obj_stack->stkp->val;
+    if (obj == 0x0) /* dead entry */
+      continue;
+    assert( context->rgn_to_obj_entry[ gen_of(obj) ] == obj_stack->stkp );
+    context->rgn_to_obj_entry[ gen_of(obj) ] = obj_stack->stkp->next_in_rgn;
+    *obj_recv = obj;
+    *index_recv = -1;
+    return TRUE;
+  }
+
+  los_stack = &context->stack.los;
+  while (1) {
+    if (los_stack->seg == NULL)
+      return FALSE;
+    if (los_stack->stkp == los_stack->stkbot) {
+      los_stack->seg = pop_los_segment( context, los_stack->seg, 
+                                      &context->freed_los );
+      if (los_stack->seg == NULL) {
+        los_stack->stkp = 0;
+        los_stack->stkbot = 0;
+        los_stack->stklim = 0;
+        return FALSE;
+      }
+      los_stack->stkbot = los_stack->seg->data;
+      los_stack->stklim = los_stack->seg->data+LOS_STACK_SIZE;
+      los_stack->stkp = los_stack->stklim;
+    }
+    los_stack->stkp--;
+    obj = los_stack->stkp->object;
+    if (obj == 0x0) /* dead entry */
+      continue;
+    assert2( context->rgn_to_los_entry[ gen_of( obj ) ] == los_stack->stkp );
+    context->rgn_to_los_entry[ gen_of( obj ) ] = los_stack->stkp->next_in_rgn;
+    *obj_recv = obj;
+    *index_recv = los_stack->stkp->index;
+    return TRUE;
+  }
+}
+
+void smircy_push_entry( smircy_context_t *context, word obj, int index )
+{
+  assert2( smircy_object_marked_p( context, obj ));
+  if (index < 0)
+    push_entry( context, obj, gen_of(obj) );
+  else
+    los_push( context, index, obj );
+}
+
 smircy_context_t *smircy_begin_opt( gc_t *gc, int num_rgns, 
                                     bool cover_full_address_range ) 
 {
@@ -947,7 +1049,7 @@ smircy_context_t *smircy_begin_opt( gc_t *gc, int num_rgns,
   } else {
     words_in_bitmap = allocate_bitmap( context );
   }
-  memset( context->bitmap, 0, words_in_bitmap*sizeof(word) );
+  bitmap_clear( context->bitmap, 0, words_in_bitmap*BITS_PER_WORD );
 
   context->stack.obj.seg = NULL;
   context->stack.obj.stkp = NULL;
@@ -971,6 +1073,7 @@ smircy_context_t *smircy_begin_opt( gc_t *gc, int num_rgns,
   context->total_words_marked = 0;
 
   context->stage = smircy_construction_stage;
+  context->concurrent = FALSE;
 
   /* all hasbeen regions can now be reclassified as polling */
   region_group_enq_all( region_group_hasbeen, region_group_advertised );
@@ -1164,6 +1267,13 @@ void smircy_progress( smircy_context_t *context,
 
   CHECK_REP( context );
 
+  if (smircy_par_progress( context, mark_max, trace_max, mark_words_max, 
+                           misc_max, marked_recv, traced_recv, 
+                           words_marked_recv, misc_recv )) {
+    CHECK_REP( context );
+    return;
+  }
+
   mark_budget = mark_max;
   trace_budget = trace_max;
   mark_words_budget = mark_words_max;
@@ -1186,7 +1296,7 @@ void smircy_progress( smircy_context_t *context,
             else
               break; /* done with stacks[rgn] for now */
           } else {
-            stack->obj.seg = pop_obj_segment( stack->obj.seg, 
+            stack->obj.seg = pop_obj_segment( context, stack->obj.seg, 
                                               &context->freed_obj );
             if (stack->obj.seg != NULL) {
               stack->obj.stkbot = stack->obj.seg->data;
@@ -1367,11 +1477,11 @@ void smircy_end( smircy_context_t *context )
   free_obj_stk_entries( context->rgn_to_obj_entry, context->num_rgns+1 );
   free_los_stk_entries( context->rgn_to_los_entry, context->num_rgns+1 );
 
-  n = free_obj_stacksegs( context->freed_obj );
+  n = free_obj_stacksegs( context, context->freed_obj );
   if (n > 1)
     consolemsg( "  Warning: deep mark stack: >%d elements.", n*OBJ_STACK_SIZE );
 
-  n = free_los_stacksegs( context->freed_los );
+  n = free_los_stacksegs( context, context->freed_los );
   if (n > 1)
     consolemsg( "  Warning: deep mark stack: >%d elements.", n*LOS_STACK_SIZE );
 
@@ -1514,7 +1624,7 @@ void smircy_jit_process_stack_for_rgn( smircy_context_t *context, int rgn )
         if (stack->obj.seg == NULL) {
           break; /* let code below snag entries from LOS */
         } else {
-          stack->obj.seg = pop_obj_segment( stack->obj.seg, 
+          stack->obj.seg = pop_obj_segment( context, stack->obj.seg, 
                                             &context->freed_obj );
           if (stack->obj.seg != NULL) {
             stack->obj.stkbot = stack->obj.seg->data;
@@ -1664,6 +1774,13 @@ void smircy_when_object_forwarded( smircy_context_t *context,
   }
 }
 
+void smircy_set_concurrent( smircy_context_t *context )
+{
+  assert( smircy_stack_empty_p( context ));
+  assert( context->freed_obj == NULL && context->freed_los == NULL );
+  context->concurrent = TRUE;
+}
+
 void smircy_set_object_visitor( smircy_context_t *context, 
                                 void* (*visitor)( word obj, 
                                                   word src, 
@@ -57,6 +57,11 @@ void smircy_jit_process_stack_for_rgn( smircy_context_t *context, int rgn );
 
 void smircy_end( smircy_context_t *context );
 
+void smircy_set_concurrent( smircy_context_t *context );
+  /* requires: nothing has been pushed yet.
+   * Prepares the context to be advanced by a thread other than the
+   * mutator; see mark_thread_t.h. */
+
 void smircy_set_object_visitor( smircy_context_t *context, 
                                 void* (*visitor)( word obj, 
                                                   word src, 
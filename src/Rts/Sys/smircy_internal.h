@@ -107,6 +107,28 @@ struct smircy_context {
   int                total_marked;
   int                total_words_marked;
   smircy_stage_t     stage;
+  bool               concurrent;  /* stack segments come from malloc */
 };
 
+bool smircy_pop_entry( smircy_context_t *context, 
+                       word *obj_recv, int *index_recv );
+  /* Pops the next live entry off the mark stack, maintaining the
+   * per-region entry lists.  An object entry yields index -1; a large
+   * object cursor yields its resumption index.  Returns FALSE if the
+   * stack is empty. */
+
+void smircy_push_entry( smircy_context_t *context, word obj, int index );
+  /* Pushes an entry of the kind returned by smircy_pop_entry.  obj
+   * must already be marked; no arcs are counted and no remembered
+   * sets are updated. */
+
+bool smircy_par_progress( smircy_context_t *context, 
+                          int mark_max, int trace_max, int mark_words_max,
+                          int misc_max,
+                          int *marked_recv, int *traced_recv, 
+                          int *words_marked_recv, int *misc_recv );
+  /* Like smircy_progress, but spread over the collector's worker
+   * threads (see smircy-par.c).  Returns FALSE, having done nothing,
+   * if parallel marking is not applicable. */
+
 #endif /* INCLUDED_SMIRCY_H */
@@ -74,6 +74,17 @@
  * slot for saved REG0 is zero, then the return address field contains
  * a raw machine pointer into code that cannot be relocated by garbage
  * collections.
+ *
+ * Restoring frames:
+ * Flushed frames are never changed by the mutator; a restore copies
+ * them, so a captured continuation may be reinstated any number of
+ * times.  By default an underflow restores one frame.  If a larger
+ * limit is set with stk_set_restore_limit(), consecutive underflows
+ * restore 1, 2, 4, ... frames up to that limit, and a flush or clear
+ * starts over at one.  Code that returns through many flushed frames
+ * then takes few underflows, while code that captures continuations
+ * between short returns does not copy up frames that the next capture
+ * would have to flush again.
  */
 
 #define GC_INTERNAL
@@ -86,9 +97,15 @@ static struct {
   int stacks_created;
   int frames_flushed;
   int words_flushed;
-} stack_state;                        /* FIXME: hang off GC or globals */
+  int restore_limit;                  /* Most frames restored at once */
+  int restore_batch;                  /* Frames for the next underflow */
+} stack_state = { 0, 0, 0, 1, 1 };    /* FIXME: hang off GC or globals */
 
 #define STACK_BASE_SIZE    16   /* bytes */
+#define RESTORE_BYTES      (2*MAX_STACK_FRAME)  /* Most bytes restored by
+                                                   one underflow, unless
+                                                   the first frame is
+                                                   larger */
 
 /* Allocates and initializes a stack underflow frame. */
 
@@ -122,6 +139,13 @@ int stk_create( word *globals )
 void stk_clear( word *globals )
 {
   globals[ G_STKP ] = globals[ G_STKBOT ];
+  stack_state.restore_batch = 1;
+}
+
+void stk_set_restore_limit( int frames )
+{
+  stack_state.restore_limit = max( frames, 1 );
+  stack_state.restore_batch = 1;
 }
 
 /* Flushes stack frames into the heap. */
@@ -188,45 +212,14 @@ void stk_flush( word *globals )
   globals[ G_STKBOT ] = globals[ G_STKP ];    /* FIXME: seems backwards */
 
   stack_state.frames_flushed += framecount;
+  stack_state.restore_batch = 1;
 }
 
-/* NOTE:  A copy of this code exists in Sparc/memory.s; if you change 
- * anything here, check that code as well.
- */
-int stk_restore_frame( word *globals )
+/* Converts the heap frame just copied to stktop into a stack frame. */
+
+static void convert_restored_frame( word *stktop )
 {
-  word *stktop, *hframe, *p;
   word retoffs, proc, codeaddr, codeptr, header;
-  unsigned size;
-
-  assert2(globals[ G_STKP ] == globals[ G_STKBOT ]);
-
-  hframe = ptrof( globals[ G_CONT ] );
-  size = roundup8( sizefield( *hframe ) + 4 );   /* bytes to copy */
-  stktop = (word*)globals[ G_STKP ];
-
-  stktop -= size / 4;
-  if (stktop < (word*)globals[ G_ETOP ]) {
-    supremely_annoyingmsg( "Failed to create stack." );
-    return 0;
-  }
-  globals[ G_STKP ] = (word)stktop;
-  globals[ G_STKUFLOW ] += 1;
-
-#if 0
-  annoyingmsg("Restore: %d", size);
-#endif
-
-  /* copy the frame onto the stack */
-  p = stktop;
-  while (size) {
-    *p++ = *hframe++;
-    *p++ = *hframe++;
-    size -= 8;
-  }
-
-  /* Follow continuation chain. */
-  globals[ G_CONT ] = *(stktop+STK_DYNLINK);
 
   header  = *(stktop+HC_HEADER);
   retoffs = *(stktop+HC_RETOFFSET);
@@ -247,7 +240,74 @@ int stk_restore_frame( word *globals )
   } else {
     *(stktop+STK_RETADDR) = retoffs;
   }
+}
+
+/* NOTE:  A copy of this code exists in Sparc/memory.s; if you change 
+ * anything here, check that code as well.  The SPARC code restores
+ * one frame at a time.
+ */
+int stk_restore_frame( word *globals )
+{
+  word *stktop, *hframe, *p;
+  word k;
+  unsigned size, total;
+  int frames, i;
+
+  assert2(globals[ G_STKP ] == globals[ G_STKBOT ]);
+
+  /* Choose the frames: the first always, the others while they are
+     heap frames and fit both the budget and the space below the stack */
+  k = globals[ G_CONT ];
+  hframe = ptrof( k );
+  total = roundup8( sizefield( *hframe ) + 4 );   /* bytes to copy */
+  frames = 1;
+  while (frames < stack_state.restore_batch) {
+    k = *(hframe+HC_DYNLINK);
+    if (tagof( k ) != VEC_TAG)
+      break;
+    hframe = ptrof( k );
+    size = roundup8( sizefield( *hframe ) + 4 );
+    if (total + size > RESTORE_BYTES ||
+        (word*)globals[ G_STKP ] - (total + size)/4
+          < (word*)globals[ G_ETOP ])
+      break;
+    total += size;
+    frames++;
+  }
+
+  stktop = (word*)globals[ G_STKP ];
+  stktop -= total / 4;
+  if (stktop < (word*)globals[ G_ETOP ]) {
+    supremely_annoyingmsg( "Failed to create stack." );
+    return 0;
+  }
+  globals[ G_STKP ] = (word)stktop;
+  globals[ G_STKUFLOW ] += frames;
+
+#if 0
+  annoyingmsg("Restore: %d frames, %d bytes", frames, total);
+#endif
+
+  /* copy the frames onto the stack, the top frame lowest */
+  p = stktop;
+  for ( i = 0 ; i < frames ; i++ ) {
+    word *frame = p;
+
+    hframe = ptrof( globals[ G_CONT ] );
+    size = roundup8( sizefield( *hframe ) + 4 );
+    while (size) {
+      *p++ = *hframe++;
+      *p++ = *hframe++;
+      size -= 8;
+    }
+
+    /* Follow continuation chain. */
+    globals[ G_CONT ] = *(frame+STK_DYNLINK);
+    convert_restored_frame( frame );
+  }
 
+  stack_state.restore_batch =
+    min( stack_state.restore_batch*2, stack_state.restore_limit );
   return 1;
 }
 
@@ -31,11 +31,17 @@ void stk_flush( word *globals );
      */
 
 int stk_restore_frame( word *globals );
-  /* Restore one stack frame from the heap into the stack cache.
-     The cache must be clean.
+  /* Restore stack frames from the heap into the stack cache: one, or
+     more if a restore limit has been set and the last restore was not
+     followed by a flush or clear.  The cache must be clean.
      Returns 1 if it succeeded, 0 if it didn't (frame didn't fit).
      */
 
+void stk_set_restore_limit( int frames );
+  /* Set the largest number of frames that one stk_restore_frame() may
+     restore.  The default is 1.
+     */
+
 int stk_size_for_top_stack_frame( word *globals );
   /* Compute the number of bytes required to accomodate a new stack as well
      as the top stack frame in the current stack.
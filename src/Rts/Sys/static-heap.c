@@ -46,29 +46,185 @@ static word *allocate( static_heap_t *heap, int nbytes )
   return p;
 }
 
+static void protect_area( semispace_t *ss, int prot )
+{
+  int i;
+
+  for ( i=0 ; i <= ss->current ; i++ )
+    if (ss->chunks[i].bytes > 0)
+      gclib_set_protection( ss->chunks[i].bot, ss->chunks[i].bytes, prot );
+}
+
+static int compare_words( const void *a, const void *b )
+{
+  word x = *(const word*)a, y = *(const word*)b;
+
+  return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+/* Sets limits[i] to the end of the run of code vectors that chunk i of
+   the text area starts with, or to the start of the chunk if it does
+   not start with one.  A code vector is a bytevector in the code slot
+   of a procedure in the data area; the run may include the padding
+   that keeps bytevectors aligned.  The splitting collector puts all of
+   those code vectors first in the text area, in chunks of their own,
+   and the strings and other bytevectors after them; a split heap image
+   keeps each chunk on pages of its own, so this works for a text area
+   that has been loaded from an image too.  Stopping at the first object
+   that is not a code vector keeps any chunk that holds strings or other
+   bytevectors writable, whatever order the objects are in.
+   */
+static void code_limits( static_heap_t *heap, word **limits )
+{
+  semispace_t *data = heap->data_area, *text = heap->text_area;
+  word *p, *top, w, *code, *end;
+  int i, j, n, size;
+
+  for ( j=0 ; j <= text->current ; j++ )
+    limits[j] = text->chunks[j].bot;
+  if (data == 0)
+    return;
+
+  /* The code vectors, in address order. */
+  n = 0;
+  size = 1024;
+  code = (word*)must_malloc( sizeof( word )*size );
+  for ( i=0 ; i <= data->current ; i++ ) {
+    p = data->chunks[i].bot;
+    top = data->chunks[i].top;
+    while (p < top) {
+      w = *p;
+      if (!ishdr( w )) {
+        p += 2;                 /* pair */
+        continue;
+      }
+      if (header( w ) == header( PROC_HDR ) &&
+          tagof( p[ PROC_HEADER_WORDS + IDX_PROC_CODE ] ) == BVEC_TAG) {
+        if (n == size) {
+          size *= 2;
+          code = (word*)must_realloc( code, sizeof( word )*size );
+        }
+        code[n++] = (word)ptrof( p[ PROC_HEADER_WORDS + IDX_PROC_CODE ] );
+      }
+      p += roundup8( sizefield( w ) + 4 ) / sizeof( word );
+    }
+  }
+  qsort( code, n, sizeof( word ), compare_words );
+
+  for ( j=0 ; j <= text->current ; j++ ) {
+    p = text->chunks[j].bot;
+    top = text->chunks[j].top;
+    end = p;
+    while (p < top) {
+      if (*p == 0) {
+        p += 2;                 /* padding */
+        continue;
+      }
+      w = (word)p;
+      if (bsearch( &w, code, n, sizeof( word ), compare_words ) == 0)
+        break;
+      p += roundup8( sizefield( *p ) + 4 ) / sizeof( word );
+      end = p;
+    }
+    limits[j] = end;
+  }
+  free( code );
+}
+
+/* Code is only in the text area if the heap has been split; otherwise
+   the data area holds code too and is left as it is.  Only the pages
+   of the code vectors are made executable; the strings and the other
+   bytevectors start on a page of their own and stay writable.
+   */
+static void protect( static_heap_t *heap )
+{
+  semispace_t *text = heap->text_area;
+  word **limits;
+  int i, code;
+
+  if (text == 0 || !command_line_options.wxorx)
+    return;
+  limits = (word**)must_malloc( sizeof( word* )*(text->current+1) );
+  code_limits( heap, limits );
+  for ( i=0 ; i <= text->current ; i++ ) {
+    if (text->chunks[i].bytes == 0)
+      continue;
+    code = roundup_page( (byte*)limits[i] - (byte*)text->chunks[i].bot );
+    if (code > 0)
+      gclib_set_protection( text->chunks[i].bot, code, GCLIB_PROT_TEXT );
+    if (code < text->chunks[i].bytes)
+      gclib_set_protection( (byte*)text->chunks[i].bot + code,
+                            text->chunks[i].bytes - code, GCLIB_PROT_DATA );
+  }
+  free( limits );
+  if (heap->data_area)
+    protect_area( heap->data_area, GCLIB_PROT_DATA );
+}
+
+/* Appends the chunks of a text subarea to *text, or frees the subarea
+   if it is empty.
+   */
+static void join_text_subarea( semispace_t **text, semispace_t *ss )
+{
+  ss_sync( ss );
+  if (ss->used == 0) {
+    ss_free( ss );
+    return;
+  }
+  ss_shrinkwrap( ss ); ss_sync( ss );
+  if (*text == 0)
+    *text = ss;
+  else {
+    ss_assimilate( *text, ss );
+    ss_sync( *text );
+  }
+}
+
+/* The text area is laid out as the code vectors, then the strings, then
+   the other bytevector-like objects, each in the order they are reached
+   from the roots (except that plain bytevectors that are not code come
+   last), so that the code that runs at startup is together and is not
+   interleaved with data.
+   */
 static void reorganize( static_heap_t *heap )
 {
   static_data_t *s_data = DATA(heap);
-  semispace_t *text, *data;
-  unsigned textsize, datasize;
-
-  /* HACK!  We create both semispaces large enough to receive all of
-     the data from the current static area.  When just doing a static
-     area reorg, each piece will have only one chunk.  We can then
-     use existing (May '97) heap dumping code to dump a split heap.
-     This is only a quick fix to level the field for the Boehm collector.
+  semispace_t *text, *data, *code, *strings, *other;
+  unsigned textsize, datasize, subareasize;
+
+  /* The old areas are the from-space of the splitting collection. */
+  if (heap->text_area) protect_area( heap->text_area, GCLIB_PROT_MIXED );
+  if (heap->data_area) protect_area( heap->data_area, GCLIB_PROT_MIXED );
+
+  /* HACK!  We create the code and data semispaces large enough to
+     receive all of the data from the current static area.  When just
+     doing a static area reorg, each piece will have only one chunk.
+     We can then use existing (May '97) heap dumping code to dump a split
+     heap.  This is only a quick fix to level the field for the Boehm
+     collector.  The strings and other bytevectors are fewer, and their
+     subareas grow as needed.
    */
   textsize = datasize = heap->data_area->allocated;
-  text = create_semispace( textsize, s_data->gen_no);
+  subareasize = max( textsize/8, GC_CHUNK_SIZE );
+  code = create_semispace( textsize, s_data->gen_no );
+  strings = create_semispace( subareasize, s_data->gen_no );
+  other = create_semispace( subareasize, s_data->gen_no );
   data = create_semispace( datasize, s_data->gen_no);
-  gclib_stopcopy_split_heap( heap->collector, data, text );
+  gclib_stopcopy_split_heap( heap->collector, data, code, strings, other );
   if (heap->text_area) ss_free( heap->text_area );
   if (heap->data_area) ss_free( heap->data_area );
   heap->text_area = heap->data_area = 0;
-  ss_shrinkwrap( text ); ss_sync( text );
+  ss_sync( code ); ss_sync( strings ); ss_sync( other );
+  annoyingmsg( "Static text: %d bytes of code, %d of strings, %d other.",
+               code->used, strings->used, other->used );
+  text = 0;
+  join_text_subarea( &text, code );
+  join_text_subarea( &text, strings );
+  join_text_subarea( &text, other );
   ss_shrinkwrap( data ); ss_sync( data );
-  if (text->used > 0) heap->text_area = text; else ss_free( text );
+  if (text) heap->text_area = text;
   if (data->used > 0) heap->data_area = data; else ss_free( data );
+  protect( heap );
 }
 
 static void stats( static_heap_t *heap )
@@ -155,6 +311,7 @@ static_heap_t *create_static_area( int gen_no, gc_t *gc )
   heap->load_prepare = 0;
   heap->load_data = 0;
   heap->is_address_mapped = is_address_mapped;
+  heap->protect = protect;
 
   data->self = stats_new_generation( gen_no, 0 );
   data->gen_no = gen_no;
@@ -162,27 +319,4 @@ static_heap_t *create_static_area( int gen_no, gc_t *gc )
   return heap;
 }
 
-#if defined(SUNOS4)
-
-/* Debug code: write-protect the text area. */
-
-#include <sys/mman.h>
-extern int mprotect( caddr_t addr, int len, int prot );
-
-void protect_static( static_heap_t *heap )
-{
-  semispace_t *ss = heap->text_area;
-  int i;
-
-  if (ss == 0) return;
-  for ( i=0 ; i <= ss->current ; i++ ) {
-    if (mprotect( (void*)(ss->chunks[i].bot),
-		  ss->chunks[i].bytes,
-		  PROT_READ | PROT_EXEC ) == -1)
-      consolemsg( "mprotect failed." );
-  }
-}
-
-#endif  /* defined(SUNOS4) */
-
 /* eof */
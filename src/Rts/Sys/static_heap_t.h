@@ -95,6 +95,14 @@ struct static_heap {
   bool (*is_address_mapped)( static_heap_t *heap, word *addr, bool noisy );
     /* Returns true iff 'addr' is an object in 'heap'
      */
+
+  void (*protect)( static_heap_t *heap );
+    /* A method that makes the code vectors at the start of the text
+       area, if there is one, executable but not writable, and the rest
+       of the text area and the data area writable but not executable,
+       if the system keeps writable data and code apart (-wxorx).
+       Called when the areas have been loaded or reorganized.
+       */
 };
 
 /* Operations */
@@ -107,6 +115,7 @@ struct static_heap {
 #define sh_text_load_area( h, n )     ((h)->text_load_area( (h),(n) ))
 #define sh_get_data_areas( h, d, t )  ((h)->get_data_areas( (h),(d),(t) ))
 #define sh_is_address_mapped( h,a,n ) ((h)->is_address_mapped( (h), (a), (n) ))
+#define sh_protect( h )               ((h)->protect( (h) ))
 
 #endif
 
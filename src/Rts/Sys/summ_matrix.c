@@ -182,6 +182,7 @@ struct summ_matrix_data {
   double p;           /* wave-off threshold (S)                              */
   int entries_per_objs_pool_segment;
   int entries_per_locs_pool_segment;
+  bool concurrent;    /* pool segments come from malloc                      */
 
   summ_row_t **rows;
   summ_col_t **cols;
@@ -315,16 +316,38 @@ static int calc_coverage( summ_matrix_t *summ, int region_count )
   return coverage;
 }
 
-static objs_pool_t *alloc_objpool_segment( unsigned entries_per_pool_segment )
+/* Summaries that are constructed concurrently with the mutator take
+ * their pool segments from malloc, because the page allocator is not
+ * thread-safe and may move the page table. */
+static void *alloc_pool_entries( summ_matrix_t *summ, int bytes )
 {
-  objs_pool_t *p;
-  word *heapptr;
-  p = (objs_pool_t*) must_malloc( sizeof(objs_pool_t) );
+  void *heapptr;
+  if (DATA(summ)->concurrent)
+    return must_malloc( bytes );
   while (1) {
-    heapptr = gclib_alloc_rts( entries_per_pool_segment*sizeof(word), MB_SUMMARY_SETS );
+    heapptr = gclib_alloc_rts( bytes, MB_SUMMARY_SETS );
     if (heapptr != 0) break;
     memfail( MF_RTS, "Can't allocate summary matrix pool.");
   }
+  return heapptr;
+}
+
+static void free_pool_entries( summ_matrix_t *summ, void *entries, int bytes )
+{
+  if (DATA(summ)->concurrent)
+    free( entries );
+  else
+    gclib_free( entries, bytes );
+}
+
+static objs_pool_t *alloc_objpool_segment( summ_matrix_t *summ,
+                                           unsigned entries_per_pool_segment )
+{
+  objs_pool_t *p;
+  word *heapptr;
+  p = (objs_pool_t*) must_malloc( sizeof(objs_pool_t) );
+  heapptr = (word*)
+    alloc_pool_entries( summ, entries_per_pool_segment*sizeof(word) );
 
   p->bot = p->top = heapptr;
   p->lim = heapptr + entries_per_pool_segment;
@@ -333,16 +356,14 @@ static objs_pool_t *alloc_objpool_segment( unsigned entries_per_pool_segment )
   return p;
 }
 
-static locs_pool_t *alloc_locpool_segment( unsigned entries_per_pool_segment )
+static locs_pool_t *alloc_locpool_segment( summ_matrix_t *summ,
+                                           unsigned entries_per_pool_segment )
 {
   locs_pool_t *p;
   loc_t *heapptr;
   p = (locs_pool_t*) must_malloc( sizeof(locs_pool_t) );
-  while (1) {
-    heapptr = gclib_alloc_rts( entries_per_pool_segment*sizeof(loc_t), MB_SUMMARY_SETS );
-    if (heapptr != 0) break;
-    memfail( MF_RTS, "Can't allocate summary matrix pool.");
-  }
+  heapptr = (loc_t*)
+    alloc_pool_entries( summ, entries_per_pool_segment*sizeof(loc_t) );
 
   p->bot = p->top = heapptr;
   p->lim = heapptr + entries_per_pool_segment;
@@ -387,7 +408,8 @@ static void free_cell( summ_matrix_t *summ,
 
     p = e->objects;
     while (p != NULL) {
-      gclib_free( p->bot, entries_per_objs_pool_segment*sizeof(word) );
+      free_pool_entries( summ, p->bot, 
+                         entries_per_objs_pool_segment*sizeof(word) );
       n = p->next; /* save across free(p) call */
       free(p);
       p = n;
@@ -400,7 +422,8 @@ static void free_cell( summ_matrix_t *summ,
 
     p = e->locations;
     while (p != NULL) {
-      gclib_free( p->bot, entries_per_locs_pool_segment*sizeof(loc_t) );
+      free_pool_entries( summ, p->bot, 
+                         entries_per_locs_pool_segment*sizeof(loc_t) );
       n = p->next; /* save across free(p) call */
       free(p);
       p = n;
@@ -890,6 +913,7 @@ create_summ_matrix( gc_t *gc, int first_gno, int initial_num_rgns,
   data->p = p;
   data->entries_per_objs_pool_segment = DEFAULT_OBJS_POOL_SIZE;
   data->entries_per_locs_pool_segment = DEFAULT_LOCS_POOL_SIZE;
+  data->concurrent = FALSE;
   data->num_cols = num_cols;
   data->num_rows = num_rows;
 
@@ -1448,13 +1472,27 @@ EXPORT void sm_add_entry_concurrent( summ_matrix_t *summ,
 }
 
 
-EXPORT void sm_construction_concurrent( summ_matrix_t *summ,
-                                 int grain_scan_words,
-                                 int grain_scan_objects )
+EXPORT void sm_set_concurrent( summ_matrix_t *summ )
+{
+  DATA(summ)->concurrent = TRUE;
+}
+
+EXPORT bool sm_construction_concurrent( summ_matrix_t *summ,
+                                        int rgn_next,
+                                        int ne_rgn_count,
+                                        bool *completed_cycle_recv )
 {
   check_rep_3( summ );
-  assert(FALSE);
+
+  *completed_cycle_recv = FALSE;
+  if (DATA(summ)->summarizing.waiting || DATA(summ)->summarizing.complete)
+    return FALSE;
+
+  sm_build_summaries_partial_n( summ, rgn_next, ne_rgn_count, 1 );
+  *completed_cycle_recv = DATA(summ)->summarizing.complete;
+
   check_rep_3( summ );
+  return TRUE;
 }
 
 
@@ -1781,7 +1819,7 @@ static objs_pool_t *pool_enq_obj( summ_matrix_t *summ, objs_pool_t *objects, wor
 
   entries = DATA(summ)->entries_per_objs_pool_segment;
   if ( (objects == NULL) || (objects->top == objects->lim) ) {
-    objs_pool_t *p = alloc_objpool_segment( entries );
+    objs_pool_t *p = alloc_objpool_segment( summ, entries );
     p->next = objects;
     objects = p;
   }
@@ -1805,7 +1843,7 @@ static locs_pool_t *pool_enq_loc( summ_matrix_t *summ,
 
   entries = DATA(summ)->entries_per_locs_pool_segment;
   if ( (locations == NULL) || (locations->top == locations->lim) ) {
-    locs_pool_t *p = alloc_locpool_segment( entries );
+    locs_pool_t *p = alloc_locpool_segment( summ, entries );
     p->next   = locations;
     locations = p;
   }
@@ -147,9 +147,20 @@ void sm_add_entry_concurrent( summ_matrix_t *summ,
                               word source_obj,
                               int target_gno );
 
-void sm_construction_concurrent( summ_matrix_t *summ,
-                                 int grain_scan_words,
-                                 int grain_scan_objects );
+void sm_set_concurrent( summ_matrix_t *summ );
+  /* requires: no entries have been added to summ yet.
+   * Makes summ safe to construct with sm_construction_concurrent. */
+
+bool sm_construction_concurrent( summ_matrix_t *summ,
+                                 int rgn_next, int ne_rgn_count,
+                                 bool *completed_cycle_recv );
+  /* Scans the remembered set of one region into the summaries under
+   * construction, without regard to schedule.  Returns FALSE, having
+   * done nothing, unless a summarization wave is in progress.  Sets
+   * *completed_cycle_recv as sm_construction_progress would return.
+   *
+   * Must not run at the same time as the collector, which leaves the
+   * starting and retiring of waves to sm_construction_progress. */
 
 void sm_interrupt_construction( summ_matrix_t *summ );
 
@@ -0,0 +1,143 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- background thread for summarization.
+ *
+ * See summ_thread_t.h for the interface.
+ *
+ * The pause protocol is the one used by the mark thread: the thread
+ * holds its lock while it runs a slice, and the mutator pauses it by
+ * raising pause_requested and taking the lock.  When there is a mark
+ * thread, a slice also holds the mark thread's lock, always taken
+ * after our own; the mutator pauses the two threads in the same order.
+ */
+
+#define GC_INTERNAL
+
+#include "larceny.h"
+#include "gc_workers_t.h"
+#include "mark_thread_t.h"
+#include "summ_thread_t.h"
+
+#if defined(HAVE_PTHREADS)
+# include <pthread.h>
+#endif
+
+struct summ_thread {
+  gc_t *gc;
+  bool (*slice)( gc_t *gc );
+  mark_thread_t *mark_thread;   /* 0 if marking is not concurrent */
+  int depth;                    /* Pause nesting depth; mutator only */
+#if defined(HAVE_PTHREADS)
+  pthread_t thread;
+  pthread_mutex_t lock;         /* Held by whoever may touch the summaries */
+  pthread_cond_t cond;
+  volatile int pause_requested;
+  volatile int stop_requested;
+  bool idle;                    /* Last slice found no work */
+#endif
+};
+
+#if defined(HAVE_PTHREADS)
+static void *summ_thread_main( void *p )
+{
+  summ_thread_t *st = (summ_thread_t*)p;
+  bool progress;
+
+  pthread_mutex_lock( &st->lock );
+  while (!st->stop_requested) {
+    while (!st->stop_requested && (st->pause_requested || st->idle))
+      pthread_cond_wait( &st->cond, &st->lock );
+    if (st->stop_requested)
+      break;
+    if (st->mark_thread != NULL)
+      mark_thread_lock( st->mark_thread );
+    progress = st->slice( st->gc );
+    if (st->mark_thread != NULL)
+      mark_thread_unlock( st->mark_thread );
+    st->idle = !progress;
+  }
+  pthread_mutex_unlock( &st->lock );
+  return 0;
+}
+#endif
+
+summ_thread_t *create_summ_thread( gc_t *gc,
+                                   bool (*slice)( gc_t *gc ),
+                                   mark_thread_t *mark_thread )
+{
+#if defined(HAVE_PTHREADS)
+  summ_thread_t *st;
+
+  st = (summ_thread_t*)must_malloc( sizeof( summ_thread_t ) );
+  st->gc = gc;
+  st->slice = slice;
+  st->mark_thread = mark_thread;
+  st->depth = 0;
+  st->pause_requested = 0;
+  st->stop_requested = 0;
+  st->idle = TRUE;
+  pthread_mutex_init( &st->lock, 0 );
+  pthread_cond_init( &st->cond, 0 );
+  if (pthread_create( &st->thread, 0, summ_thread_main, st ) != 0) {
+    consolemsg( "Could not create the summarization thread; "
+                "summarizing incrementally." );
+    pthread_cond_destroy( &st->cond );
+    pthread_mutex_destroy( &st->lock );
+    free( st );
+    return 0;
+  }
+  annoyingmsg( "Created summarization thread." );
+  return st;
+#else
+  consolemsg( "Concurrent summarization is not supported in this "
+              "configuration; summarizing incrementally." );
+  return 0;
+#endif
+}
+
+void summ_thread_pause( summ_thread_t *st )
+{
+  if (st->depth++ > 0)
+    return;
+#if defined(HAVE_PTHREADS)
+  st->pause_requested = 1;
+  gc_memory_barrier();
+  pthread_mutex_lock( &st->lock );
+#endif
+}
+
+void summ_thread_resume( summ_thread_t *st )
+{
+  assert( st->depth > 0 );
+  if (--st->depth > 0)
+    return;
+#if defined(HAVE_PTHREADS)
+  /* The collector may have started a new wave; look for work again. */
+  st->idle = FALSE;
+  st->pause_requested = 0;
+  pthread_cond_broadcast( &st->cond );
+  pthread_mutex_unlock( &st->lock );
+#endif
+}
+
+void summ_thread_stop( summ_thread_t *st )
+{
+#if defined(HAVE_PTHREADS)
+  if (st->depth == 0) {
+    st->pause_requested = 1;
+    gc_memory_barrier();
+    pthread_mutex_lock( &st->lock );
+  }
+  st->stop_requested = 1;
+  pthread_cond_broadcast( &st->cond );
+  pthread_mutex_unlock( &st->lock );
+  pthread_join( st->thread, 0 );
+  pthread_cond_destroy( &st->cond );
+  pthread_mutex_destroy( &st->lock );
+#endif
+  free( st );
+}
+
+/* eof */
@@ -0,0 +1,58 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- background thread for summarization.
+ *
+ * With -concurrent-summarize, the regional collector scans remembered
+ * sets into the summary matrix on a dedicated thread instead of in
+ * slices of the collector's pauses and timer interrupts.  Collections
+ * then find the summaries they need already constructed.
+ *
+ * The summarization thread and the mutator share the heap, the
+ * remembered set, the region groups, and the summary matrix.  As with
+ * the mark thread (see mark_thread_t.h), the mutator pauses the
+ * summarization thread around every entry into the collector that can
+ * touch them.  Each slice scans the remembered set of one region.
+ *
+ * The thread only advances a summarization wave that is in progress.
+ * Starting a new wave and retiring a completed one are left to the
+ * collector, which does them at collection boundaries as before.
+ *
+ * If there is also a mark thread, the two threads never run slices at
+ * the same time, because marking updates the remembered set that
+ * summarization scans.
+ */
+
+#ifndef INCLUDED_SUMM_THREAD_T_H
+#define INCLUDED_SUMM_THREAD_T_H
+
+#include "config.h"
+#include "larceny-types.h"
+
+summ_thread_t *create_summ_thread( gc_t *gc,
+                                   bool (*slice)( gc_t *gc ),
+                                   mark_thread_t *mark_thread );
+  /* Creates and starts the summarization thread for gc.  The thread
+     calls slice repeatedly while it is not paused; slice returns FALSE
+     if there was no work to do, and the thread then waits until it is
+     next resumed.  mark_thread may be 0.  Returns 0 if threads are not
+     supported.
+     */
+
+void summ_thread_pause( summ_thread_t *st );
+void summ_thread_resume( summ_thread_t *st );
+  /* Called by the mutator only.  Pauses nest; while the summarization
+     thread is paused it does not touch the heap or the summary matrix.
+     The summarization thread must be paused before the mark thread.
+     */
+
+void summ_thread_stop( summ_thread_t *st );
+  /* Called by the mutator only, paused or not, and before the mark
+     thread is stopped.  Waits for the current slice to finish, then
+     stops and joins the summarization thread and frees st.
+     */
+
+#endif /* INCLUDED_SUMM_THREAD_T_H */
+
+/* eof */
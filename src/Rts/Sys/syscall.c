@@ -72,6 +72,11 @@ static struct {
 		      { (fptr)osdep_listdir_open, 1, 0 },
 		      { (fptr)osdep_listdir, 1, 0 },
 		      { (fptr)osdep_listdir_close, 1, 0 },
+		      { (fptr)primitive_sched_submit, 3, 0 },
+		      { (fptr)primitive_sched_next, 1, 0 },
+		      { (fptr)primitive_sched_result, 0, 0 },
+		      { (fptr)primitive_open_mapped, 2, 0 },
+	/* 60 */      { (fptr)primitive_map_file, 3, 0 },
 		    };
 
 void larceny_syscall( int nargs, int nproc, word *args )
@@ -0,0 +1,259 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ * Larceny run-time system -- remembered set fed by a card table.
+ *
+ * When card marking is selected (see barrier.h) the write barrier
+ * does not log into the SSBs but marks the card that holds the header
+ * of the object stored into.  This wrapper holds a backing remembered
+ * set and, when uremset_cards_scan() is called at the start of a
+ * collection, adds to the minor part of that set every object of an
+ * old generation whose header is on a marked card, just as the SSB
+ * entries would have been added.  Everything else is delegated.
+ *
+ * The scan visits the object-aligned ranges of each old generation as
+ * given by gc_enumerate_hdr_address_ranges().  There is no crossing
+ * map, so a range that has a marked card is walked from its start up
+ * to its last marked card; a range is a chunk of a semispace or a
+ * single large object, so that bounds the walk.  Ranges start on page
+ * boundaries and therefore do not share cards, and the cards of a
+ * range are cleared once it has been walked.  Cards of the nursery
+ * are never cleared and never looked at.
+ */
+
+#define GC_INTERNAL
+
+#include "larceny.h"
+#include "gc_t.h"
+#include "barrier.h"
+#include "uremset_t.h"
+#include "uremset_cards_t.h"
+
+#define BATCH_WORDS  256        /* Objects added per call to add_elems */
+
+typedef struct uremset_cards_data uremset_cards_data_t;
+
+struct uremset_cards_data {
+  uremset_t *backing_urs;
+  word batch[ BATCH_WORDS ];    /* Objects found by the scan */
+  int batch_count;
+  bool overflowed;              /* Backing set overflowed during scan */
+  int cards_marked;             /* Marked cards seen by the scan */
+  int objects_added;            /* Objects added by the scan */
+};
+
+#define DATA(urs) ((uremset_cards_data_t*)(urs->data))
+
+static void flush_batch( uremset_cards_data_t *data )
+{
+  if (data->batch_count > 0) {
+    if (urs_add_elems( data->backing_urs,
+                       data->batch, data->batch+data->batch_count ))
+      data->overflowed = TRUE;
+    data->batch_count = 0;
+  }
+}
+
+/* Returns the number of words occupied by the object at p, and its tag. */
+static int object_words( word *p, int *tag )
+{
+  word w = *p;
+
+  if (!ishdr( w )) {
+    *tag = PAIR_TAG;
+    return 2;
+  }
+  if (header( w ) == BV_HDR)
+    *tag = BVEC_TAG;
+  else if (header( w ) == VEC_HDR)
+    *tag = VEC_TAG;
+  else {
+    assert( header( w ) == header( PROC_HDR ) );
+    *tag = PROC_TAG;
+  }
+  return roundup_balign( sizeof(word) + roundup4( sizefield( w ) ) )
+           / sizeof(word);
+}
+
+static void scan_range( word *s, word *l, void *d )
+{
+  uremset_cards_data_t *data = (uremset_cards_data_t*)d;
+  byte *first, *last, *card;
+  word *p, *lim;
+  int words, tag;
+
+  first = wb_card_of( s );
+  last = wb_card_of( l-1 );
+  while (last >= first && *last == CARD_CLEAN)
+    last--;
+  if (last < first)
+    return;
+
+  lim = min( l, (word*)((((word)s >> CARD_SHIFT) + (last - first) + 1)
+                        << CARD_SHIFT) );
+  for ( p = s ; p < lim ; p += words ) {
+    words = object_words( p, &tag );
+    card = first + (((word)p >> CARD_SHIFT) - ((word)s >> CARD_SHIFT));
+    if (*card != CARD_CLEAN) {
+      data->batch[ data->batch_count++ ] = tagptr( p, tag );
+      data->objects_added++;
+      if (data->batch_count == BATCH_WORDS)
+        flush_batch( data );
+    }
+  }
+
+  for ( card = first ; card <= last ; card++ ) {
+    if (*card != CARD_CLEAN) {
+      data->cards_marked++;
+      *card = CARD_CLEAN;
+    }
+  }
+}
+
+bool uremset_cards_scan( uremset_t *urs )
+{
+  uremset_cards_data_t *data = DATA(urs);
+  int gno;
+
+  data->overflowed = FALSE;
+  data->cards_marked = 0;
+  data->objects_added = 0;
+  for ( gno = 1 ; gno < urs->collector->gno_count ; gno++ )
+    gc_enumerate_hdr_address_ranges( urs->collector, gno, scan_range, data );
+  flush_batch( data );
+  supremely_annoyingmsg( "Card scan: %d marked cards, %d objects.",
+                         data->cards_marked, data->objects_added );
+  return data->overflowed;
+}
+
+static void expand_remset_gnos( uremset_t *urs, int fresh_gno )
+{
+  urs_expand_remset_gnos( DATA(urs)->backing_urs, fresh_gno );
+}
+static void clear( uremset_t *urs, int gno )
+{
+  urs_clear( DATA(urs)->backing_urs, gno );
+}
+static void assimilate_and_clear( uremset_t *urs, int g1, int g2 )
+{
+  urs_assimilate_and_clear( DATA(urs)->backing_urs, g1, g2 );
+}
+static bool add_elem_new( uremset_t *urs, word w )
+{
+  return urs_add_elem_new( DATA(urs)->backing_urs, w );
+}
+static bool add_elem( uremset_t *urs, word w )
+{
+  return urs_add_elem( DATA(urs)->backing_urs, w );
+}
+static bool add_elems( uremset_t *urs, word *bot, word *top )
+{
+  return urs_add_elems( DATA(urs)->backing_urs, bot, top );
+}
+static void enumerate_gno( uremset_t *urs, bool incl_tag, int gno,
+                           bool (*scanner)(word loc, void *data),
+                           void *data )
+{
+  urs_enumerate_gno( DATA(urs)->backing_urs, incl_tag, gno, scanner, data );
+}
+static void enumerate_allbutgno( uremset_t *urs, bool incl_tag, int gno,
+                                 bool (*scanner)(word loc, void *data),
+                                 void *data )
+{
+  urs_enumerate_allbutgno( DATA(urs)->backing_urs, incl_tag, gno,
+                           scanner, data );
+}
+static void enumerate_older( uremset_t *urs, bool incl_tag, int gno,
+                             bool (*scanner)(word loc, void *data),
+                             void *data )
+{
+  DATA(urs)->backing_urs->enumerate_older( DATA(urs)->backing_urs,
+                                           incl_tag, gno, scanner, data );
+}
+static void clear_minor( uremset_t *urs )
+{
+  urs_clear_minor( DATA(urs)->backing_urs );
+}
+static void copy_minor_to_major( uremset_t *urs )
+{
+  urs_copy_minor_to_major( DATA(urs)->backing_urs );
+}
+static void enumerate_minor_complement( uremset_t *urs, bool incl_tag,
+                                        gset_t gset,
+                                        bool (*scanner)(word loc, void *data),
+                                        void *data )
+{
+  urs_enumerate_minor_complement( DATA(urs)->backing_urs, incl_tag, gset,
+                                  scanner, data );
+}
+static void enumerate_complement( uremset_t *urs, bool incl_tag,
+                                  gset_t gset,
+                                  bool (*scanner)(word loc, void *data),
+                                  void *data )
+{
+  urs_enumerate_complement( DATA(urs)->backing_urs, incl_tag, gset,
+                            scanner, data );
+}
+static void enumerate( uremset_t *urs, bool incl_tag,
+                       bool (*scanner)(word loc, void *data),
+                       void *data )
+{
+  urs_enumerate( DATA(urs)->backing_urs, incl_tag, scanner, data );
+}
+static bool is_remembered( uremset_t *urs, word w )
+{
+  return urs_isremembered( DATA(urs)->backing_urs, w );
+}
+static int live_count( uremset_t *urs, int gno )
+{
+  return urs_live_count( DATA(urs)->backing_urs, gno );
+}
+static void init_summary( uremset_t *urs, int gno, int max_words_per_step,
+                          /* out parameter */ summary_t *s )
+{
+  urs_init_summary( DATA(urs)->backing_urs, gno, max_words_per_step, s );
+}
+static void checkpoint_stats( uremset_t *urs, int gno )
+{
+  urs_checkpoint_stats( DATA(urs)->backing_urs, gno );
+}
+
+uremset_t *alloc_uremset_cards( uremset_t *backing_urs )
+{
+  uremset_cards_data_t *data;
+
+  data = (uremset_cards_data_t*)must_malloc( sizeof( uremset_cards_data_t ) );
+
+  data->backing_urs = backing_urs;
+  data->batch_count = 0;
+  data->overflowed = FALSE;
+  data->cards_marked = 0;
+  data->objects_added = 0;
+
+  wb_use_cards();
+
+  return create_uremset_t( backing_urs->collector,
+                           "cards",
+                           (void*)data,
+                           expand_remset_gnos,
+                           clear,
+                           assimilate_and_clear,
+                           add_elem_new,
+                           add_elem,
+                           add_elems,
+                           enumerate_gno,
+                           enumerate_allbutgno,
+                           enumerate_older,
+                           clear_minor,
+                           copy_minor_to_major,
+                           enumerate_minor_complement,
+                           enumerate_complement,
+                           enumerate,
+                           is_remembered,
+                           live_count,
+                           init_summary,
+                           checkpoint_stats );
+}
+
+/* eof */
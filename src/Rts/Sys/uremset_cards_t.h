@@ -0,0 +1,20 @@
+/* Copyright 2026 Larceny Project.              -*- indent-tabs-mode: nil -*-
+ *
+ * $Id$
+ *
+ */
+
+#ifndef INCLUDED_UREMSET_CARDS_T_H
+#define INCLUDED_UREMSET_CARDS_T_H
+
+uremset_t *alloc_uremset_cards( uremset_t *backing_urs );
+  /* Wraps backing_urs and selects the card-marking write barrier.
+     */
+
+bool uremset_cards_scan( uremset_t *urs );
+  /* Adds the objects on marked cards to the minor part of the backing
+     set and clears the cards.  Returns TRUE if the backing set
+     overflowed.
+     */
+
+#endif /* INCLUDED_UREMSET_CARDS_T_H */
@@ -86,6 +86,7 @@ static bool       add_elem( uremset_t *urs, word w )
 static bool          add_elems( uremset_t *urs, word *bot, word *top )
 {
   word *p, *q, w;
+  word last = 0;
   bool already_present;
   p = bot;
   q = top;
@@ -94,7 +95,10 @@ static bool          add_elems( uremset_t *urs, word *bot, word *top )
     w = *q;
     if ( is_fixnum(w) ) { 
       /* skip fixnums in SSB log */ 
+    } else if ( w == last ) {
+      /* skip further fields of the object just added (sorted batch) */
     } else {
+      last = w;
 #if 0
       consolemsg("uremset_extbmp add_elems add w=0x%08x", w );
 #endif
@@ -116,10 +120,7 @@ static bool copy_over_to( word loc, void *data )
 
 static void copy_minor_to_major( uremset_t *urs ) 
 {
-  extbmp_enumerate( DATA(urs)->minor_remset, 
-                    FALSE, 
-                    copy_over_to, 
-                    DATA(urs)->remset );
+  extbmp_union( DATA(urs)->remset, DATA(urs)->minor_remset );
 }
 
 struct wrap_scan_propogating_deletes_to_minor_data {
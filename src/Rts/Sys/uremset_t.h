@@ -41,6 +41,13 @@ struct uremset {
   bool         (*add_elem_new)( uremset_t *urs, word w );
   bool             (*add_elem)( uremset_t *urs, word w );
   bool            (*add_elems)( uremset_t *urs, word *bot, word *top );
+    /* Adds the objects logged in the SSB batch [bot,top), skipping the
+     * fixnum field offsets that may follow them.  The collector passes
+     * batches sorted by address and free of duplicate entries (see
+     * seqbuf_set_batched), so the entries for one object are adjacent
+     * and only the first of them needs a lookup.  Implementations must
+     * still accept unsorted batches.
+     */
 
   void        (*enumerate_gno)( uremset_t *urs, bool incl_tag, int gno, 
                                 bool (*scanner)(word loc, void *data), 